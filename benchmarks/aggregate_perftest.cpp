@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+#include "accumulator/simd_aggregate.hpp"
+#include "topk_queue.hpp"
+#include "util/do_not_optimize_away.hpp"
+#include "util/util.hpp"
+
+using namespace pisa;
+
+// The aggregation of `Simple_Accumulator` before `aggregate_scores`.
+void scalar_aggregate(std::vector<float> const &scores, topk_queue &topk)
+{
+    for (uint64_t docid = 0; docid < scores.size(); ++docid) {
+        if (topk.would_enter(scores[docid])) {
+            topk.insert(scores[docid], docid);
+        }
+    }
+}
+
+// Returns the mean time of `runs` runs of `aggregate` into a top-k of size `k`, in
+// microseconds.
+template <typename Aggregate>
+double run_aggregate(Aggregate aggregate, uint64_t k, size_t runs)
+{
+    topk_queue topk(k);
+    auto tick = get_time_usecs();
+    for (size_t run = 0; run < runs; ++run) {
+        topk.clear();
+        aggregate(topk);
+        topk.finalize();
+        do_not_optimize_away(topk.topk().size());
+    }
+    return (get_time_usecs() - tick) / runs;
+}
+
+int main(int argc, const char **argv)
+{
+    if (argc > 3) {
+        std::cerr << "Usage: " << argv[0] << " [documents] [runs]" << std::endl;
+        return 1;
+    }
+    size_t documents = argc >= 2 ? std::stoull(argv[1]) : 50'000'000;
+    size_t runs = argc == 3 ? std::stoull(argv[2]) : 5;
+#if defined(__AVX512F__)
+    spdlog::info("Comparing lanes with AVX-512");
+#elif defined(__AVX2__)
+    spdlog::info("Comparing lanes with AVX2");
+#else
+    spdlog::info("Comparing lanes without SIMD instructions");
+#endif
+
+    // A dense accumulator after a TAAT traversal: most documents match no term and keep a
+    // zero score.
+    std::mt19937 rng(1729);
+    std::gamma_distribution<float> distribution(2.0F, 2.0F);
+    for (double density : {0.001, 0.01, 0.1, 1.0}) {
+        std::vector<float> scores(documents, 0.0F);
+        std::bernoulli_distribution matches(density);
+        for (auto &score : scores) {
+            if (matches(rng)) {
+                score = distribution(rng);
+            }
+        }
+        for (uint64_t k : {10, 1000}) {
+            double scalar_time =
+                run_aggregate([&](auto &topk) { scalar_aggregate(scores, topk); }, k, runs);
+            double simd_time = run_aggregate(
+                [&](auto &topk) { aggregate_scores(scores.data(), scores.size(), topk); },
+                k,
+                runs);
+            spdlog::info("{:.1f}% non-zero scores, k = {}: {:.2f} ms scalar, {:.2f} ms with "
+                         "aggregate_scores ({:.2f}x)",
+                         density * 100,
+                         k,
+                         scalar_time / 1000,
+                         simd_time / 1000,
+                         scalar_time / simd_time);
+            std::cout << fmt::format(
+                "{}\t{}\t{:.2f}\t{:.2f}\n", density, k, scalar_time / 1000, simd_time / 1000);
+        }
+    }
+}
@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+#include "block_posting_list.hpp"
+#include "codec/simdbp.hpp"
+#include "util/do_not_optimize_away.hpp"
+#include "util/simd_search.hpp"
+#include "util/util.hpp"
+
+using namespace pisa;
+
+// The search over block maxima that `next_geq` used before `find_geq`.
+std::size_t linear_find_geq(uint32_t const *values, std::size_t begin, uint32_t target)
+{
+    while (values[begin] < target) {
+        ++begin;
+    }
+    return begin;
+}
+
+int main(int argc, const char **argv)
+{
+    if (argc > 2) {
+        std::cerr << "Usage: " << argv[0] << " [postings]" << std::endl;
+        return 1;
+    }
+    uint64_t n = argc == 2 ? std::stoull(argv[1]) : 1U << 24U;
+
+    // A list as long as the ones of stopword-like terms, with more than 64K blocks by default.
+    std::vector<uint64_t> docs(n);
+    std::vector<uint64_t> freqs(n, 1);
+    std::mt19937 rng(1729);
+    uint64_t docid = 0;
+    for (auto &doc : docs) {
+        doc = docid;
+        docid += 1 + rng() % 3;
+    }
+    uint64_t universe = docid;
+    using posting_list_type = block_posting_list<simdbp_block>;
+    std::vector<uint8_t> data;
+    posting_list_type::write(data, n, docs.begin(), freqs.begin());
+    posting_list_type::document_enumerator reader(data.data(), universe);
+    spdlog::info("{} postings in {} blocks", n, reader.num_blocks());
+
+    std::vector<uint32_t> block_maxs;
+    for (uint64_t block = 0; block < reader.num_blocks(); ++block) {
+        block_maxs.push_back(docs[std::min((block + 1) * simdbp_block::block_size, n) - 1]);
+    }
+
+    for (uint64_t skip = 1; skip <= 16384; skip <<= 1) {
+        // Fewer calls for long skips, which the scan makes slow.
+        uint64_t calls_per_skip = std::max<uint64_t>(1000, (uint64_t(1) << 24U) / skip);
+        // Skips of `skip` blocks over the block maxima, starting over at the end.
+        std::vector<std::pair<std::size_t, uint32_t>> searches;
+        for (std::size_t begin = 0; searches.size() < calls_per_skip;) {
+            auto pos = begin + skip;
+            if (pos >= block_maxs.size()) {
+                begin = 0;
+                continue;
+            }
+            searches.emplace_back(begin, block_maxs[pos]);
+            begin = pos;
+        }
+
+        auto tick = get_time_usecs();
+        for (auto const &[begin, target] : searches) {
+            do_not_optimize_away(linear_find_geq(block_maxs.data(), begin, target));
+        }
+        double linear = get_time_usecs() - tick;
+        tick = get_time_usecs();
+        for (auto const &[begin, target] : searches) {
+            do_not_optimize_away(find_geq(block_maxs.data(), begin, block_maxs.size(), target));
+        }
+        double galloping = get_time_usecs() - tick;
+        spdlog::info("Searched block maxima {} times with skip={} blocks: {:.1f} ns per call "
+                     "scanning, {:.1f} ns galloping",
+                     searches.size(),
+                     skip,
+                     linear / searches.size() * 1000,
+                     galloping / searches.size() * 1000);
+
+        // The same skips through `next_geq`, which also decodes the block it lands on.
+        std::vector<uint64_t> skip_values;
+        for (uint64_t pos = 0; skip_values.size() < calls_per_skip / 10;) {
+            pos += skip * simdbp_block::block_size;
+            if (pos >= n) {
+                pos = 0;
+                skip_values.push_back(0);
+                continue;
+            }
+            skip_values.push_back(docs[pos]);
+        }
+        tick = get_time_usecs();
+        for (auto value : skip_values) {
+            if (value == 0) {
+                reader.reset();
+                continue;
+            }
+            reader.next_geq(value);
+            do_not_optimize_away(reader.docid());
+        }
+        double elapsed = get_time_usecs() - tick;
+        spdlog::info("Performed {} next_geq() with skip={} blocks: {:.1f} ns per call",
+                     skip_values.size(),
+                     skip,
+                     elapsed / skip_values.size() * 1000);
+    }
+}
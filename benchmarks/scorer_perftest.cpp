@@ -0,0 +1,186 @@
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+#include "mio/mmap.hpp"
+#include "spdlog/spdlog.h"
+
+#include "accumulator/simple_accumulator.hpp"
+#include "cursor/block_max_scored_cursor.hpp"
+#include "cursor/max_scored_cursor.hpp"
+#include "cursor/scored_cursor.hpp"
+#include "index_types.hpp"
+#include "io.hpp"
+#include "mappable/mapper.hpp"
+#include "query/queries.hpp"
+#include "scorer/scorer.hpp"
+#include "util/do_not_optimize_away.hpp"
+#include "util/util.hpp"
+#include "wand_data_raw.hpp"
+
+using namespace pisa;
+
+std::vector<std::string> const operators = {"ranked_or",
+                                            "ranked_or_taat",
+                                            "ranked_and",
+                                            "wand",
+                                            "maxscore",
+                                            "block_max_wand",
+                                            "block_max_maxscore",
+                                            "block_max_ranked_and"};
+
+// Runs all queries with operator `op` and returns the best of `runs` times, in microseconds.
+template <typename Index, typename Wand, typename Scorer>
+double run_operator(std::string const &op,
+                    Index const &index,
+                    Wand const &wdata,
+                    Scorer const &scorer,
+                    std::vector<Query> const &queries,
+                    uint64_t k,
+                    size_t runs)
+{
+    topk_queue topk(k);
+    Simple_Accumulator accumulator(index.num_docs());
+    // The operator is chosen before timing, so that `run_query` is all that runs per query.
+    auto time_queries = [&](auto run_query) {
+        double best = std::numeric_limits<double>::max();
+        for (size_t run = 0; run < runs; ++run) {
+            auto tick = get_time_usecs();
+            for (auto const &query : queries) {
+                run_query(query);
+                topk.finalize();
+                do_not_optimize_away(topk.topk().size());
+                topk.clear();
+            }
+            best = std::min(best, get_time_usecs() - tick);
+        }
+        return best;
+    };
+
+    if (op == "ranked_or") {
+        return time_queries([&](Query const &query) {
+            ranked_or_query q(topk);
+            q(make_scored_cursors(index, scorer, query), index.num_docs());
+        });
+    } else if (op == "ranked_or_taat") {
+        return time_queries([&](Query const &query) {
+            ranked_or_taat_query q(topk);
+            q(make_scored_cursors(index, scorer, query), index.num_docs(), accumulator);
+        });
+    } else if (op == "ranked_and") {
+        return time_queries([&](Query const &query) {
+            ranked_and_query q(topk);
+            q(make_scored_cursors(index, scorer, query), index.num_docs());
+        });
+    } else if (op == "wand") {
+        return time_queries([&](Query const &query) {
+            wand_query q(topk);
+            q(make_max_scored_cursors(index, wdata, scorer, query), index.num_docs());
+        });
+    } else if (op == "maxscore") {
+        return time_queries([&](Query const &query) {
+            maxscore_query q(topk);
+            q(make_max_scored_cursors(index, wdata, scorer, query), index.num_docs());
+        });
+    } else if (op == "block_max_wand") {
+        return time_queries([&](Query const &query) {
+            block_max_wand_query q(topk);
+            q(make_block_max_scored_cursors(index, wdata, scorer, query), index.num_docs());
+        });
+    } else if (op == "block_max_maxscore") {
+        return time_queries([&](Query const &query) {
+            block_max_maxscore_query q(topk);
+            q(make_block_max_scored_cursors(index, wdata, scorer, query), index.num_docs());
+        });
+    } else if (op == "block_max_ranked_and") {
+        return time_queries([&](Query const &query) {
+            block_max_ranked_and_query q(topk);
+            q(make_block_max_scored_cursors(index, wdata, scorer, query), index.num_docs());
+        });
+    }
+    throw std::invalid_argument(fmt::format("Unknown operator {}", op));
+}
+
+template <typename IndexType>
+void perftest(const char *index_filename,
+              const char *wand_data_filename,
+              std::string const &type,
+              std::string const &scorer_name,
+              std::vector<Query> const &queries)
+{
+    spdlog::info("Loading index from {}", index_filename);
+    IndexType index;
+    mio::mmap_source m(index_filename);
+    mapper::map(index, m, mapper::map_flags::warmup);
+
+    wand_data<wand_data_raw> wdata;
+    mio::mmap_source md(wand_data_filename);
+    mapper::map(wdata, md, mapper::map_flags::warmup);
+
+    // Postings of the query terms: the postings scored by exhaustive operators, and an upper
+    // bound for the others.
+    size_t postings = 0;
+    for (auto const &query : queries) {
+        for (auto const &term : query_term_weights(query)) {
+            postings += index[term.first].size();
+        }
+    }
+
+    uint64_t k = configuration::get().k;
+    size_t runs = 3;
+    auto runtime_scorer = scorer::from_name(scorer_name, wdata);
+    scorer::with_static_scorer(scorer_name, wdata, [&](auto const &static_scorer) {
+        for (auto const &op : operators) {
+            double runtime =
+                run_operator(op, index, wdata, *runtime_scorer, queries, k, runs);
+            double compiled = run_operator(op, index, wdata, static_scorer, queries, k, runs);
+            spdlog::info("{}: {:.2f} ns per posting with the runtime scorer, {:.2f} with the "
+                         "static scorer ({:.2f}x)",
+                         op,
+                         runtime / postings * 1000,
+                         compiled / postings * 1000,
+                         runtime / compiled);
+            std::cout << fmt::format("{}\t{}\t{}\t{:.2f}\t{:.2f}\n",
+                                     type,
+                                     scorer_name,
+                                     op,
+                                     runtime / postings * 1000,
+                                     compiled / postings * 1000);
+        }
+    });
+}
+
+int main(int argc, const char **argv)
+{
+    if (argc != 5) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <index type> <index filename> <wand data filename> <scorer> < queries"
+                  << std::endl;
+        return 1;
+    }
+
+    std::string type = argv[1];
+    const char *index_filename = argv[2];
+    const char *wand_data_filename = argv[3];
+    std::string scorer_name = argv[4];
+
+    std::vector<Query> queries;
+    io::for_each_line(std::cin, [&](std::string const &line) {
+        queries.push_back(parse_query_ids(line));
+    });
+    spdlog::info("Read {} queries", queries.size());
+
+    if (false) {
+#define LOOP_BODY(R, DATA, T)                                                           \
+    }                                                                                   \
+    else if (type == BOOST_PP_STRINGIZE(T)) {                                           \
+        perftest<BOOST_PP_CAT(T, _index)>(                                              \
+            index_filename, wand_data_filename, type, scorer_name, queries);            \
+        /**/
+
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_INDEX_TYPES);
+#undef LOOP_BODY
+    } else {
+        spdlog::error("Unknown type {}", type);
+    }
+}
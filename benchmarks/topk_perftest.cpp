@@ -0,0 +1,68 @@
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+#include "buffered_topk_queue.hpp"
+#include "topk_queue.hpp"
+#include "util/do_not_optimize_away.hpp"
+#include "util/util.hpp"
+
+using namespace pisa;
+
+// Inserts the first `n` scores into `topk` and returns the mean time of `runs` runs, in
+// microseconds.
+template <typename Topk>
+double run_topk(Topk &topk, std::vector<float> const &scores, size_t n, size_t runs)
+{
+    auto tick = get_time_usecs();
+    for (size_t run = 0; run < runs; ++run) {
+        topk.clear();
+        for (size_t docid = 0; docid < n; ++docid) {
+            topk.insert(scores[docid], docid);
+        }
+        topk.finalize();
+        do_not_optimize_away(topk.topk().size());
+    }
+    return (get_time_usecs() - tick) / runs;
+}
+
+int main(int argc, const char **argv)
+{
+    if (argc > 2) {
+        std::cerr << "Usage: " << argv[0] << " [candidates]" << std::endl;
+        return 1;
+    }
+    size_t candidates = argc == 2 ? std::stoull(argv[1]) : 10'000'000;
+
+    // Scores in docid order, as inserted by an exhaustive traversal or an accumulator scan.
+    std::vector<float> scores(candidates);
+    std::mt19937 rng(1729);
+    std::gamma_distribution<float> distribution(2.0F, 2.0F);
+    std::generate(scores.begin(), scores.end(), [&] { return distribution(rng); });
+
+    // Few candidates per result, as when fusing variation lists of depth k, make the heap
+    // work on most insertions; many leave it mostly comparing against the threshold.
+    for (uint64_t k : {10, 100, 1000, 10000}) {
+        for (size_t per_result : {10, 1000}) {
+            auto n = std::min(k * per_result, candidates);
+            auto runs = std::max<size_t>(3, candidates / n);
+            topk_queue heap(k);
+            buffered_topk_queue buffered(k);
+            double heap_time = run_topk(heap, scores, n, runs);
+            double buffered_time = run_topk(buffered, scores, n, runs);
+            spdlog::info("k = {}, {} candidates: {:.2f} ns per candidate with the heap, {:.2f} "
+                         "buffered ({:.2f}x)",
+                         k,
+                         n,
+                         heap_time / n * 1000,
+                         buffered_time / n * 1000,
+                         heap_time / buffered_time);
+            std::cout << fmt::format(
+                "{}\t{}\t{:.2f}\t{:.2f}\n", k, n, heap_time / n * 1000, buffered_time / n * 1000);
+        }
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace pisa {
+
+/// Accumulates fused scores of the few documents retrieved by the variations of a multi-query.
+///
+/// Unlike `Simple_Accumulator`, which is dense over the whole collection, this is an open
+/// addressing table sized to the number of accumulated entries (at most k times the number of
+/// variations). Slots are stamped with the epoch in which they were written, so `reset()` does
+/// not need to touch the table, and memory is only reallocated when a topic needs more slots
+/// than any previous one.
+class fusion_accumulator {
+   public:
+    /// Starts a new topic that will accumulate at most `entries` documents; must be called
+    /// before the first `accumulate()`.
+    void reset(std::size_t entries)
+    {
+        std::size_t capacity = 16;
+        while (capacity < 2 * entries) {
+            capacity *= 2;
+        }
+        if (capacity > m_slots.size()) {
+            m_slots.assign(capacity, slot{});
+            m_shift = 64;
+            for (auto size = capacity; size > 1; size /= 2) {
+                --m_shift;
+            }
+            m_epoch = 0;
+        }
+        if (++m_epoch == 0) {
+            for (auto &s : m_slots) {
+                s.epoch = 0;
+            }
+            m_epoch = 1;
+        }
+        m_used.clear();
+    }
+
+    void accumulate(uint64_t docid, float score)
+    {
+        auto mask = m_slots.size() - 1;
+        auto pos = (docid * 0x9E3779B97F4A7C15ULL) >> m_shift;
+        while (m_slots[pos].epoch == m_epoch && m_slots[pos].docid != docid) {
+            pos = (pos + 1) & mask;
+        }
+        auto &s = m_slots[pos];
+        if (s.epoch != m_epoch) {
+            s = slot{docid, 0.0F, 0, m_epoch};
+            m_used.push_back(pos);
+        }
+        s.score += score;
+        s.matches += 1;
+    }
+
+    /// Inserts every accumulated document into `topk`. With `multiply_by_matches`, scores are
+    /// multiplied by the number of times the document was accumulated (CombMNZ).
+    template <typename Topk>
+    void aggregate(Topk &topk, bool multiply_by_matches = false) const
+    {
+        for (auto pos : m_used) {
+            auto const &s = m_slots[pos];
+            topk.insert(multiply_by_matches ? s.score * s.matches : s.score, s.docid);
+        }
+    }
+
+    [[nodiscard]] auto size() const -> std::size_t { return m_used.size(); }
+
+   private:
+    struct slot {
+        uint64_t docid = 0;
+        float score = 0.0F;
+        uint32_t matches = 0;
+        uint32_t epoch = 0;
+    };
+
+    std::vector<slot> m_slots;
+    std::vector<uint32_t> m_used;
+    uint32_t m_epoch = 0;
+    uint32_t m_shift = 64;
+};
+
+} // namespace pisa
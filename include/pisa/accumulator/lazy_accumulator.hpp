@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <cstddef>
 
+#include "accumulator/simd_aggregate.hpp"
 #include "topk_queue.hpp"
 
 namespace pisa {
@@ -72,13 +73,17 @@ struct Lazy_Accumulator {
     void aggregate(topk_queue &topk) {
         uint64_t docid = 0u;
         for (auto const &block : m_accumulators) {
-            int pos = 0;
-            for (auto const &score : block.accumulators) {
-                if (block.counter(pos++) == m_counter && topk.would_enter(score)) {
-                    topk.insert(score, docid);
+            // Stale accumulators only make the mask larger, so lanes are filtered with SIMD
+            // before their counters are checked.
+            auto lanes = lanes_above(
+                block.accumulators.data(), counters_in_descriptor, topk.threshold());
+            for (; lanes != 0; lanes &= lanes - 1) {
+                auto pos = __builtin_ctzll(lanes);
+                if (block.counter(pos) == m_counter) {
+                    topk.insert(block.accumulators[pos], docid + pos);
                 }
-                ++docid;
             }
+            docid += counters_in_descriptor;
         };
         m_counter = (m_counter + 1) % cycle;
     }
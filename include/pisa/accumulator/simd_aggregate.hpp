@@ -0,0 +1,86 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+#include "topk_queue.hpp"
+
+namespace pisa {
+
+/// Returns a mask whose bit `i` is set if `scores[i] > threshold`, for `n <= 64` scores.
+inline uint64_t lanes_above(float const *scores, size_t n, float threshold)
+{
+    uint64_t mask = 0;
+    size_t i = 0;
+#if defined(__AVX512F__)
+    auto const t512 = _mm512_set1_ps(threshold);
+    for (; i + 16 <= n; i += 16) {
+        auto above = _mm512_cmp_ps_mask(_mm512_loadu_ps(scores + i), t512, _CMP_GT_OQ);
+        mask |= uint64_t(above) << i;
+    }
+#endif
+#if defined(__AVX2__)
+    auto const t256 = _mm256_set1_ps(threshold);
+    for (; i + 8 <= n; i += 8) {
+        auto above = _mm256_cmp_ps(_mm256_loadu_ps(scores + i), t256, _CMP_GT_OQ);
+        mask |= uint64_t(_mm256_movemask_ps(above)) << i;
+    }
+#endif
+    for (; i < n; ++i) {
+        mask |= uint64_t(scores[i] > threshold) << i;
+    }
+    return mask;
+}
+
+/// Whether any of `n` scores is above `threshold`, compared once to their vectorized maximum.
+inline bool any_above(float const *scores, size_t n, float threshold)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    if (n >= 8) {
+        auto max = _mm256_loadu_ps(scores);
+        for (i = 8; i + 8 <= n; i += 8) {
+            max = _mm256_max_ps(max, _mm256_loadu_ps(scores + i));
+        }
+        if (_mm256_movemask_ps(_mm256_cmp_ps(max, _mm256_set1_ps(threshold), _CMP_GT_OQ)) != 0) {
+            return true;
+        }
+    }
+#endif
+    float max = threshold;
+    for (; i < n; ++i) {
+        max = std::max(max, scores[i]);
+    }
+    return max > threshold;
+}
+
+/// Inserts the dense scores `scores[0, n)` into `topk`, with `first_docid + i` as docids.
+///
+/// Scores are scanned in chunks of 64: a chunk whose maximum cannot enter `topk` is skipped,
+/// and otherwise only the lanes above the threshold at the start of the chunk are inserted.
+inline void aggregate_scores(float const *scores,
+                             size_t n,
+                             topk_queue &topk,
+                             uint64_t first_docid = 0)
+{
+    constexpr size_t chunk_size = 64;
+    for (size_t begin = 0; begin < n; begin += chunk_size) {
+        auto size = std::min(chunk_size, n - begin);
+        auto chunk = scores + begin;
+        auto threshold = topk.threshold();
+        if (not any_above(chunk, size, threshold)) {
+            continue;
+        }
+        for (auto lanes = lanes_above(chunk, size, threshold); lanes != 0; lanes &= lanes - 1) {
+            auto lane = __builtin_ctzll(lanes);
+            topk.insert(chunk[lane], first_docid + begin + lane);
+        }
+    }
+}
+
+} // namespace pisa
@@ -3,6 +3,7 @@
 #include <cstddef>
 #include <algorithm>
 
+#include "accumulator/simd_aggregate.hpp"
 #include "topk_queue.hpp"
 
 namespace pisa {
@@ -11,13 +12,7 @@ struct Simple_Accumulator : public std::vector<float> {
     Simple_Accumulator(std::ptrdiff_t size) : std::vector<float>(size) {}
     void init() { std::fill(begin(), end(), 0.0); }
     void accumulate(uint32_t doc, float score) { operator[](doc) += score; }
-    void aggregate(topk_queue &topk) {
-        uint64_t docid = 0u;
-        std::for_each(begin(), end(), [&](auto score) { 
-            if(topk.would_enter(score)) { topk.insert(score, docid); } 
-            docid += 1;
-        });
-    }
+    void aggregate(topk_queue &topk) { aggregate_scores(data(), size(), topk); }
 };
 
 }
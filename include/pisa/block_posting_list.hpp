@@ -1,8 +1,11 @@
 #pragma once
 
+#include <array>
+
 #include "codec/block_codecs.hpp"
 #include "util/util.hpp"
 #include "util/block_profiler.hpp"
+#include "util/simd_search.hpp"
 
 namespace pisa {
 
@@ -82,6 +85,7 @@ namespace pisa {
 
         class document_enumerator {
         public:
+            static constexpr uint64_t block_size = BlockCodec::block_size;
 
             document_enumerator(uint8_t const* data, uint64_t universe,
                                 size_t term_id = 0)
@@ -97,8 +101,6 @@ namespace pisa {
                     // std::cout << "OPEN\t" << m_term_id << "\t" << m_blocks << "\n";
                     m_block_profile = block_profiler::open_list(term_id, m_blocks);
                 }
-                m_docs_buf.resize(BlockCodec::block_size);
-                m_freqs_buf.resize(BlockCodec::block_size);
                 reset();
             }
 
@@ -125,16 +127,15 @@ namespace pisa {
             {
                 assert(lower_bound >= m_cur_docid || position() == 0);
                 if (PISA_UNLIKELY(lower_bound > m_cur_block_max)) {
-                    // binary search seems to perform worse here
                     if (lower_bound > block_max(m_blocks - 1)) {
                         m_cur_docid = m_universe;
                         return;
                     }
 
-                    uint64_t block = m_cur_block + 1;
-                    while (block_max(block) < lower_bound) {
-                        ++block;
-                    }
+                    // a plain binary search performs worse than a linear scan on the usual
+                    // short skips: gallop instead, which scans them as fast
+                    uint64_t block = find_geq(
+                        (uint32_t const*)m_block_maxs, m_cur_block + 1, m_blocks, lower_bound);
 
                     decode_docs_block(block);
                 }
@@ -185,6 +186,75 @@ namespace pisa {
                 return m_blocks;
             }
 
+            // index of the current block and position of the current posting in it
+            uint64_t block_index() const
+            {
+                return m_cur_block;
+            }
+
+            uint64_t position_in_block() const
+            {
+                return m_pos_in_block;
+            }
+
+            // writes the docids and frequencies of the whole current block, so that it can be
+            // scored at once, and returns the block size
+            uint64_t decode_block(uint32_t* docs, uint32_t* freqs)
+            {
+                if (!m_freqs_decoded) {
+                    decode_freqs_block();
+                }
+                uint32_t docid = m_docs_buf[0];
+                docs[0] = docid;
+                freqs[0] = m_freqs_buf[0] + 1;
+                for (uint32_t i = 1; i < m_cur_block_size; ++i) {
+                    docid += m_docs_buf[i] + 1;
+                    docs[i] = docid;
+                    freqs[i] = m_freqs_buf[i] + 1;
+                }
+                return m_cur_block_size;
+            }
+
+            // moves to the first posting of the next block, or to the end of the list
+            void next_block()
+            {
+                if (m_cur_block + 1 == m_blocks) {
+                    m_pos_in_block = m_cur_block_size - 1;
+                    m_cur_docid = m_universe;
+                    return;
+                }
+                decode_docs_block(m_cur_block + 1);
+            }
+
+            // prefetches the maxima and the encoded data of the `blocks` blocks following the
+            // current one without waiting for them, so that other work, such as another query,
+            // can run while they are loaded
+            void prefetch_blocks(uint32_t blocks) const
+            {
+                static const uint64_t cache_line = 64;
+                uint32_t begin = m_cur_block + 1;
+                uint32_t end = std::min(m_blocks, begin + blocks);
+                if (begin >= end) {
+                    return;
+                }
+                intrinsics::prefetch(m_block_maxs + 4 * begin);
+                // blocks are stored one after the other, but the end of the last one is not
+                // recorded: the blocks before it are prefetched whole, but only its first line
+                auto const* endpoints = (uint32_t const*)m_block_endpoints;
+                uint32_t whole_end = end < m_blocks ? end : end - 1;
+                uint8_t const* data = m_blocks_data + endpoints[begin - 1];
+                uint8_t const* data_end = m_blocks_data + endpoints[whole_end - 1];
+                for (uint8_t const* line = data; line < data_end; line += cache_line) {
+                    intrinsics::prefetch(line);
+                }
+                if (data_end > data) {
+                    intrinsics::prefetch(data_end - 1);
+                }
+                if (whole_end < end) {
+                    intrinsics::prefetch(data_end);
+                }
+            }
+
             uint64_t stats_freqs_size() const
             {
                 // XXX rewrite in terms of get_blocks()
@@ -347,8 +417,9 @@ namespace pisa {
             uint8_t const* m_freqs_block_data;
             bool m_freqs_decoded;
 
-            std::vector<uint32_t> m_docs_buf;
-            std::vector<uint32_t> m_freqs_buf;
+            // Inline, so that opening a list does not allocate; aligned like heap buffers.
+            alignas(16) std::array<uint32_t, BlockCodec::block_size> m_docs_buf;
+            alignas(16) std::array<uint32_t, BlockCodec::block_size> m_freqs_buf;
 
             block_profiler::counter_type* m_block_profile;
         };
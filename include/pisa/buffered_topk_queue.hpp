@@ -0,0 +1,143 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "topk_queue.hpp"
+#include "util/likely.hpp"
+
+namespace pisa {
+
+/// Top-k collector with the interface of `topk_queue`, for large k.
+///
+/// Candidates above the threshold are appended to a buffer of scores and 32-bit docids, laid
+/// out as two arrays, instead of being pushed onto a heap. Once the buffer holds `k +
+/// buffer_size` candidates, the k-th score is selected with `std::nth_element` and becomes the
+/// threshold, and the candidates that do not beat it are dropped in a branch-free pass. The
+/// threshold thus rises in batches and may lag behind the one of `topk_queue`, which is safe
+/// for the query operators but prunes less between two selections.
+///
+/// Ties at the k-th score keep the candidates inserted first, and `topk()` is only valid after
+/// `finalize()`.
+class buffered_topk_queue {
+   public:
+    using entry_type = topk_queue::entry_type;
+
+    static constexpr uint64_t min_buffer_size = 16;
+
+    /// Selects the top `k` once `buffer_size` more candidates are buffered; by default `k`, but
+    /// at least `min_buffer_size`.
+    explicit buffered_topk_queue(uint64_t k, uint64_t buffer_size = 0)
+        : m_buffer_size(buffer_size)
+    {
+        reset(k);
+    }
+
+    bool insert(float score) { return insert(score, 0); }
+
+    bool insert(float score, uint64_t docid)
+    {
+        if (PISA_UNLIKELY(score <= m_threshold)) {
+            return false;
+        }
+        m_scores[m_size] = score;
+        m_docids[m_size] = static_cast<uint32_t>(docid);
+        m_size += 1;
+        if (PISA_UNLIKELY(m_size == m_scores.size())) {
+            select();
+        }
+        return true;
+    }
+
+    [[nodiscard]] bool would_enter(float score) const { return score > m_threshold; }
+
+    /// Keeps the top k, sorted by decreasing score, as `topk()`.
+    void finalize()
+    {
+        if (m_size > m_k) {
+            select();
+        }
+        m_q.clear();
+        for (std::size_t pos = 0; pos < m_size; ++pos) {
+            if (m_scores[pos] > 0) {
+                m_q.emplace_back(m_scores[pos], m_docids[pos]);
+            }
+        }
+        std::sort(m_q.begin(), m_q.end(), [](entry_type const &lhs, entry_type const &rhs) {
+            return lhs.first > rhs.first || (lhs.first == rhs.first && lhs.second < rhs.second);
+        });
+    }
+
+    [[nodiscard]] std::vector<entry_type> const &topk() const noexcept { return m_q; }
+
+    void set_threshold(Threshold t) noexcept { m_threshold = t; }
+
+    [[nodiscard]] Threshold threshold() const noexcept { return m_threshold; }
+
+    [[nodiscard]] bool full() const noexcept { return m_size >= m_k; }
+
+    void clear() noexcept
+    {
+        m_size = 0;
+        m_q.clear();
+        m_threshold = 0;
+    }
+
+    /// Empties the queue for a query keeping the top `k`, reusing its storage.
+    void reset(uint64_t k)
+    {
+        clear();
+        m_k = k;
+        auto capacity = m_k + (m_buffer_size > 0 ? m_buffer_size : std::max(m_k, min_buffer_size));
+        m_scores.resize(capacity);
+        m_docids.resize(capacity);
+        m_selection.resize(capacity);
+    }
+
+    [[nodiscard]] uint64_t size() const noexcept { return m_k; }
+
+   private:
+    /// Raises the threshold to the k-th score and keeps only the top k.
+    void select()
+    {
+        if (m_k == 0) {
+            m_size = 0;
+            return;
+        }
+        std::copy(m_scores.begin(), std::next(m_scores.begin(), m_size), m_selection.begin());
+        auto kth = std::next(m_selection.begin(), m_k - 1);
+        std::nth_element(
+            m_selection.begin(), kth, std::next(m_selection.begin(), m_size), std::greater<>());
+        float threshold = *kth;
+        std::size_t above = 0;
+        for (std::size_t pos = 0; pos < m_size; ++pos) {
+            above += static_cast<std::size_t>(m_scores[pos] > threshold);
+        }
+        auto ties = m_k - above;
+        std::size_t kept = 0;
+        for (std::size_t pos = 0; pos < m_size; ++pos) {
+            float score = m_scores[pos];
+            bool tie = score == threshold && ties > 0;
+            ties -= static_cast<std::size_t>(tie);
+            m_scores[kept] = score;
+            m_docids[kept] = m_docids[pos];
+            kept += static_cast<std::size_t>(score > threshold || tie);
+        }
+        m_size = kept;
+        m_threshold = std::max(m_threshold, threshold);
+    }
+
+    float m_threshold = 0;
+    uint64_t m_k = 0;
+    uint64_t m_buffer_size;
+    std::size_t m_size = 0;
+    std::vector<float> m_scores;
+    std::vector<uint32_t> m_docids;
+    std::vector<float> m_selection;
+    std::vector<entry_type> m_q;
+};
+
+} // namespace pisa
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "topk_queue.hpp"
+
+namespace pisa {
+
+/// Top-k filled by several threads processing disjoint sets of documents of one query, e.g.,
+/// the docid ranges of `parallel_range_query`.
+///
+/// Every thread inserts into its own `local_queue`, which has the interface of `topk_queue` so
+/// that query operators can run on it. The queues share a threshold: since documents are
+/// disjoint, the k-th score of any full local queue is a lower bound on the k-th score of the
+/// query, and is published with a compare-and-swap that only ever raises it. `would_enter` of
+/// a local queue checks the shared threshold on every call, so that a thread prunes with the
+/// bound found by the others as soon as it is published. Once a thread is done, `finalize()`
+/// of its local queue merges its results, and `finalize()` keeps the top k of all of them.
+class concurrent_topk_queue {
+   public:
+    using entry_type = topk_queue::entry_type;
+
+    static_assert(std::atomic<Threshold>::is_always_lock_free);
+
+    explicit concurrent_topk_queue(uint64_t k, Threshold threshold = 0)
+        : m_threshold(threshold), m_topk(k)
+    {}
+
+    /// The top-k of one thread.
+    class local_queue {
+       public:
+        explicit local_queue(concurrent_topk_queue &shared)
+            : m_shared(shared), m_topk(shared.size())
+        {}
+
+        bool insert(float score) { return insert(score, 0); }
+
+        bool insert(float score, uint64_t docid)
+        {
+            if (!would_enter(score)) {
+                return false;
+            }
+            m_topk.insert(score, docid);
+            if (m_topk.full()) {
+                m_shared.publish(m_topk.threshold());
+            }
+            return true;
+        }
+
+        [[nodiscard]] bool would_enter(float score) const
+        {
+            return m_topk.would_enter(score) && score > m_shared.threshold();
+        }
+
+        /// Merges the results into the shared queue; the thread must not insert afterwards.
+        void finalize() { m_shared.merge(m_topk.topk()); }
+
+        [[nodiscard]] std::vector<entry_type> const &topk() const noexcept { return m_topk.topk(); }
+
+        void set_threshold(Threshold t) { m_shared.publish(t); }
+
+        [[nodiscard]] Threshold threshold() const
+        {
+            return std::max(m_topk.threshold(), m_shared.threshold());
+        }
+
+        [[nodiscard]] bool full() const noexcept { return m_topk.full(); }
+
+        void clear() noexcept { m_topk.clear(); }
+
+        [[nodiscard]] uint64_t size() const noexcept { return m_topk.size(); }
+
+       private:
+        concurrent_topk_queue &m_shared;
+        topk_queue m_topk;
+    };
+
+    /// Raises the shared threshold to `threshold`, if higher.
+    void publish(Threshold threshold)
+    {
+        auto current = m_threshold.load(std::memory_order_relaxed);
+        while (threshold > current
+               && !m_threshold.compare_exchange_weak(
+                   current, threshold, std::memory_order_relaxed)) {
+        }
+    }
+
+    [[nodiscard]] Threshold threshold() const
+    {
+        return m_threshold.load(std::memory_order_relaxed);
+    }
+
+    /// Adds the results of a thread; safe to call concurrently.
+    void merge(std::vector<entry_type> const &entries)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto const &[score, docid] : entries) {
+            m_topk.insert(score, docid);
+        }
+    }
+
+    /// Keeps the top k of the merged results, sorted by decreasing score, as `topk()`. Must be
+    /// called once all threads are done.
+    void finalize() { m_topk.finalize(); }
+
+    [[nodiscard]] std::vector<entry_type> const &topk() const noexcept { return m_topk.topk(); }
+
+    [[nodiscard]] uint64_t size() const noexcept { return m_topk.size(); }
+
+   private:
+    std::atomic<Threshold> m_threshold;
+    std::mutex m_mutex;
+    topk_queue m_topk;
+};
+
+} // namespace pisa
@@ -36,6 +36,7 @@ namespace pisa {
 
 
         bool heuristic_greedy;
+        bool pin_threads;
 
     private:
         configuration()
@@ -50,6 +51,7 @@ namespace pisa {
             fillvar("PISA_THRESHOLD_WAND_LIST", threshold_wand_list, 0);
             fillvar("PISA_THREADS", worker_threads, std::thread::hardware_concurrency());
             fillvar("PISA_HEURISTIC_GREEDY", heuristic_greedy, false);
+            fillvar("PISA_PIN_THREADS", pin_threads, false);
             fillvar("PISA_FIXED_COST_WAND_PARTITION", fixed_cost_wand_partition, 12.0);
             fillvar("PISA_EPS1_WAND", eps1_wand, 0.01);
             fillvar("PISA_EPS2_WAND", eps2_wand, 0.4);
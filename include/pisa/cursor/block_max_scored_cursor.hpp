@@ -3,11 +3,12 @@
 #include "scorer/index_scorer.hpp"
 #include "wand_data.hpp"
 #include "query/queries.hpp"
+#include "query/query_context.hpp"
 #include <vector>
 
 namespace pisa {
 
-template <typename Index, typename WandType>
+template <typename Index, typename WandType, typename TermScorer = term_scorer_t>
 struct block_max_scored_cursor {
     using enum_type = typename Index::document_enumerator;
     using wdata_enum = typename WandType::wand_data_enumerator;
@@ -15,7 +16,7 @@ struct block_max_scored_cursor {
     enum_type docs_enum;
     wdata_enum w;
     float q_weight;
-    term_scorer_t scorer;
+    TermScorer scorer;
     float max_weight;
 };
 
@@ -25,24 +26,49 @@ template <typename Index, typename WandType, typename Scorer>
                                                  Scorer const &scorer,
                                                  Query query)
 {
-    auto terms = query.terms;
-    auto query_term_freqs = query_freqs(terms);
+    auto weighted_terms = query_term_weights(query);
+    using cursor_type =
+        block_max_scored_cursor<Index, WandType, decltype(scorer.term_scorer(0))>;
 
-    std::vector<block_max_scored_cursor<Index, WandType>> cursors;
-    cursors.reserve(query_term_freqs.size());
+    std::vector<cursor_type> cursors;
+    cursors.reserve(weighted_terms.size());
     std::transform(
-        query_term_freqs.begin(),
-        query_term_freqs.end(),
+        weighted_terms.begin(),
+        weighted_terms.end(),
         std::back_inserter(cursors),
         [&](auto &&term) {
             auto list = index[term.first];
             auto w_enum = wdata.getenum(term.first);
             float q_weight = term.second;
             auto max_weight = q_weight * wdata.max_term_weight(term.first);
-            return block_max_scored_cursor<Index, WandType>{
+            return cursor_type{
                 std::move(list), w_enum, q_weight, scorer.term_scorer(term.first), max_weight};
         });
     return cursors;
 }
 
+/// Like `make_block_max_scored_cursors`, with the cursors stored in `context`. They are valid
+/// until cursors of the same type are requested from it again.
+template <typename Index, typename WandType, typename Scorer>
+[[nodiscard]] auto make_block_max_scored_cursors(query_context &context,
+                                                 Index const &index,
+                                                 WandType const &wdata,
+                                                 Scorer const &scorer,
+                                                 Query const &query) -> auto &
+{
+    using cursor_type =
+        block_max_scored_cursor<Index, WandType, decltype(scorer.term_scorer(0))>;
+    auto &weighted_terms = context.buffer<std::pair<term_id_type, float>>();
+    query_term_weights(query, weighted_terms);
+    auto &cursors = context.buffer<cursor_type>();
+    for (auto const &[term, q_weight] : weighted_terms) {
+        cursors.push_back(cursor_type{index[term],
+                                      wdata.getenum(term),
+                                      q_weight,
+                                      scorer.term_scorer(term),
+                                      q_weight * wdata.max_term_weight(term)});
+    }
+    return cursors;
+}
+
 } // namespace pisa
\ No newline at end of file
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <array>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "cursor/posting_score.hpp"
+#include "query/queries.hpp"
+#include "scorer/block_scorer.hpp"
+#include "wand_data.hpp"
+
+namespace pisa {
+
+template <typename Index, typename = void>
+struct block_scorable : std::false_type {};
+
+/// Indexes whose enumerators expose their decoded blocks, such as `block_freq_index`.
+template <typename Index>
+struct block_scorable<Index, std::void_t<decltype(&Index::document_enumerator::decode_block)>>
+    : std::true_type {};
+
+/// Cursor over a block-compressed posting list that scores each block it enters at once, with
+/// a `block_term_scorer`. It can be used wherever a `max_scored_cursor` is; the operators
+/// that go through `posting_score` then read scores from the block instead of scoring each
+/// posting.
+template <typename Index>
+struct block_scored_cursor {
+    using enum_type = typename Index::document_enumerator;
+    static constexpr size_t block_size = enum_type::block_size;
+
+    block_scored_cursor(enum_type docs_enum,
+                        float q_weight,
+                        block_term_scorer scorer,
+                        float max_weight)
+        : docs_enum(std::move(docs_enum)),
+          q_weight(q_weight),
+          scorer(scorer),
+          max_weight(max_weight)
+    {}
+
+    enum_type docs_enum;
+    float q_weight;
+    block_term_scorer scorer;
+    float max_weight;
+
+    /// Scores of the postings of the current block, indexed by position in the block.
+    float const *block_scores()
+    {
+        if (docs_enum.block_index() != m_scored_block) {
+            m_block_length = docs_enum.decode_block(m_docs.data(), m_freqs.data());
+            scorer(m_docs.data(), m_freqs.data(), m_block_length, m_scores.data());
+            m_scored_block = docs_enum.block_index();
+        }
+        return m_scores.data();
+    }
+
+    /// Docids and number of postings of the current block, valid after `block_scores()`.
+    uint32_t const *block_docs() const { return m_docs.data(); }
+    uint64_t block_length() const { return m_block_length; }
+
+   private:
+    uint64_t m_scored_block = std::numeric_limits<uint64_t>::max();
+    uint64_t m_block_length = 0;
+    std::array<uint32_t, block_size> m_docs{};
+    std::array<uint32_t, block_size> m_freqs{};
+    std::array<float, block_size> m_scores{};
+};
+
+template <typename Index, typename WandType>
+[[nodiscard]] auto make_block_scored_cursors(Index const &index,
+                                             WandType const &wdata,
+                                             std::string const &scorer_name,
+                                             Query query)
+{
+    auto weighted_terms = query_term_weights(query);
+
+    std::vector<block_scored_cursor<Index>> cursors;
+    cursors.reserve(weighted_terms.size());
+    for (auto const &[term, q_weight] : weighted_terms) {
+        cursors.emplace_back(index[term],
+                             q_weight,
+                             block_term_scorer::from_name(scorer_name, wdata, term),
+                             q_weight * wdata.max_term_weight(term));
+    }
+    return cursors;
+}
+
+/// Calls `fn` with block-scored cursors if `block_scoring` is set and `Index` supports them,
+/// and with the cursors returned by `make_cursors` otherwise.
+template <typename Index, typename WandType, typename MakeCursors, typename Fn>
+void with_block_scored_cursors(bool block_scoring,
+                               Index const &index,
+                               WandType const &wdata,
+                               std::string const &scorer_name,
+                               Query const &query,
+                               MakeCursors make_cursors,
+                               Fn fn)
+{
+    if constexpr (block_scorable<Index>::value) {
+        if (block_scoring) {
+            fn(make_block_scored_cursors(index, wdata, scorer_name, query));
+            return;
+        }
+    }
+    fn(make_cursors());
+}
+
+} // namespace pisa
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <type_traits>
+
+#include "util/compiler_attribute.hpp"
+
+namespace pisa {
+
+template <typename Cursor, typename = void>
+struct scores_blocks : std::false_type {};
+
+/// Cursors that score a whole block of postings at a time, such as `block_scored_cursor`.
+template <typename Cursor>
+struct scores_blocks<Cursor, std::void_t<decltype(std::declval<Cursor &>().block_scores())>>
+    : std::true_type {};
+
+/// Score of the current posting of a cursor, without the query term weight.
+template <typename Cursor>
+PISA_ALWAYSINLINE float posting_score(Cursor &cursor)
+{
+    if constexpr (scores_blocks<Cursor>::value) {
+        return cursor.block_scores()[cursor.docs_enum.position_in_block()];
+    } else {
+        return cursor.scorer(cursor.docs_enum.docid(), cursor.docs_enum.freq());
+    }
+}
+
+} // namespace pisa
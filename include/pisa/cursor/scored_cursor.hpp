@@ -3,36 +3,57 @@
 #include "scorer/index_scorer.hpp"
 #include "wand_data.hpp"
 #include "query/queries.hpp"
+#include "query/query_context.hpp"
 #include <vector>
 
 namespace pisa {
 
-template <typename Index>
+/// `TermScorer` is `term_scorer_t` for scorers created at run time, or the concrete term
+/// scorer type of a `static_scorer`.
+template <typename Index, typename TermScorer = term_scorer_t>
 struct scored_cursor {
     using enum_type = typename Index::document_enumerator;
     enum_type docs_enum;
     float q_weight;
-    term_scorer_t scorer;
+    TermScorer scorer;
 };
 
 template <typename Index, typename Scorer>
 [[nodiscard]] auto make_scored_cursors(Index const &index, Scorer const &scorer, Query query)
 {
-    auto terms = query.terms;
-    auto query_term_freqs = query_freqs(terms);
+    auto weighted_terms = query_term_weights(query);
+    using cursor_type = scored_cursor<Index, decltype(scorer.term_scorer(0))>;
 
-    std::vector<scored_cursor<Index>> cursors;
-    cursors.reserve(query_term_freqs.size());
+    std::vector<cursor_type> cursors;
+    cursors.reserve(weighted_terms.size());
     std::transform(
-        query_term_freqs.begin(),
-        query_term_freqs.end(),
+        weighted_terms.begin(),
+        weighted_terms.end(),
         std::back_inserter(cursors),
         [&](auto &&term) {
             auto list = index[term.first];
             float q_weight = term.second;
-            return scored_cursor<Index>{std::move(list), q_weight, scorer.term_scorer(term.first)};
+            return cursor_type{std::move(list), q_weight, scorer.term_scorer(term.first)};
         });
     return cursors;
 }
 
+/// Like `make_scored_cursors`, with the cursors stored in `context`. They are valid until
+/// cursors of the same type are requested from it again.
+template <typename Index, typename Scorer>
+[[nodiscard]] auto make_scored_cursors(query_context &context,
+                                       Index const &index,
+                                       Scorer const &scorer,
+                                       Query const &query) -> auto &
+{
+    using cursor_type = scored_cursor<Index, decltype(scorer.term_scorer(0))>;
+    auto &weighted_terms = context.buffer<std::pair<term_id_type, float>>();
+    query_term_weights(query, weighted_terms);
+    auto &cursors = context.buffer<cursor_type>();
+    for (auto const &[term, q_weight] : weighted_terms) {
+        cursors.push_back(cursor_type{index[term], q_weight, scorer.term_scorer(term)});
+    }
+    return cursors;
+}
+
 } // namespace pisa
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mappable/mappable_vector.hpp"
+
+namespace pisa {
+
+/// Inverted index for score-at-a-time processing.
+///
+/// Scores are quantized to integer impacts in `[1, impact_levels]` by rounding up
+/// `score / max_score * impact_levels`, so that `impact * quantization_scale()` never
+/// underestimates a score that does not exceed `max_score`. Postings with a non-positive
+/// score are dropped. The postings of a term are grouped into segments of equal impact,
+/// stored by decreasing impact, and the docids of a segment are stored uncompressed in
+/// increasing order.
+class impact_ordered_index {
+   public:
+    /// Impacts are computed in single precision, which represents every integer up to this
+    /// number of levels exactly.
+    static constexpr uint32_t max_impact_levels = 1U << 24U;
+
+    class builder {
+       public:
+        /// Throws `std::invalid_argument` unless `impact_levels` is in
+        /// `[1, max_impact_levels]`.
+        builder(uint64_t num_docs, float max_score, uint32_t impact_levels = 255)
+            : m_num_docs(num_docs),
+              m_levels(impact_levels),
+              m_scale(max_score > 0 ? max_score / impact_levels : 1.0F)
+        {
+            if (impact_levels == 0 || impact_levels > max_impact_levels) {
+                throw std::invalid_argument("Invalid number of impact levels: "
+                                            + std::to_string(impact_levels));
+            }
+            m_term_offsets.push_back(0);
+            m_segment_offsets.push_back(0);
+        }
+
+        /// Adds the postings of the next term; `score(doc, freq)` computes their scores.
+        template <typename DocsIterator, typename FreqsIterator, typename Scorer>
+        void add_posting_list(uint64_t n, DocsIterator docs, FreqsIterator freqs, Scorer &&score)
+        {
+            m_postings.clear();
+            for (uint64_t i = 0; i < n; ++i, ++docs, ++freqs) {
+                if (auto impact = quantize(score(*docs, *freqs)); impact > 0) {
+                    m_postings.emplace_back(impact, *docs);
+                }
+            }
+            // Docids are increasing, so a stable sort keeps them sorted within segments.
+            std::stable_sort(
+                m_postings.begin(), m_postings.end(), [](auto const &lhs, auto const &rhs) {
+                    return lhs.first > rhs.first;
+                });
+            for (size_t i = 0; i < m_postings.size(); ++i) {
+                if (i == 0 || m_postings[i].first != m_postings[i - 1].first) {
+                    if (i > 0) {
+                        m_segment_offsets.push_back(m_docids.size());
+                    }
+                    m_impacts.push_back(m_postings[i].first);
+                }
+                m_docids.push_back(m_postings[i].second);
+            }
+            if (not m_postings.empty()) {
+                m_segment_offsets.push_back(m_docids.size());
+            }
+            m_term_offsets.push_back(m_impacts.size());
+        }
+
+        void build(impact_ordered_index &index)
+        {
+            index.m_num_docs = m_num_docs;
+            index.m_scale = m_scale;
+            index.m_term_offsets.steal(m_term_offsets);
+            index.m_impacts.steal(m_impacts);
+            index.m_segment_offsets.steal(m_segment_offsets);
+            index.m_docids.steal(m_docids);
+        }
+
+       private:
+        [[nodiscard]] auto quantize(float score) const -> uint32_t
+        {
+            if (not(score > 0.0F)) {
+                return 0;
+            }
+            // clamped before the conversion, which is undefined for scores above the range
+            auto impact = std::min(std::ceil(score / m_scale), static_cast<float>(m_levels));
+            return std::max<uint32_t>(static_cast<uint32_t>(impact), 1);
+        }
+
+        uint64_t m_num_docs;
+        uint32_t m_levels;
+        float m_scale;
+        std::vector<std::pair<uint32_t, uint32_t>> m_postings;
+        std::vector<uint64_t> m_term_offsets;
+        std::vector<uint32_t> m_impacts;
+        std::vector<uint64_t> m_segment_offsets;
+        std::vector<uint32_t> m_docids;
+    };
+
+    /// Postings of a term sharing the same impact.
+    struct segment {
+        uint32_t impact;
+        uint32_t const *begin;
+        uint32_t const *end;
+
+        [[nodiscard]] auto size() const -> uint64_t { return end - begin; }
+    };
+
+    impact_ordered_index() = default;
+
+    /// Number of terms.
+    [[nodiscard]] auto size() const -> uint64_t
+    {
+        return m_term_offsets.size() > 0 ? m_term_offsets.size() - 1 : 0;
+    }
+
+    [[nodiscard]] auto num_docs() const -> uint64_t { return m_num_docs; }
+
+    /// Score represented by one unit of impact.
+    [[nodiscard]] auto quantization_scale() const -> float { return m_scale; }
+
+    [[nodiscard]] auto num_segments(uint64_t term) const -> uint64_t
+    {
+        return m_term_offsets[term + 1] - m_term_offsets[term];
+    }
+
+    /// Returns the `i`-th segment of `term`; segments are in decreasing order of impact.
+    [[nodiscard]] auto get_segment(uint64_t term, uint64_t i) const -> segment
+    {
+        auto s = m_term_offsets[term] + i;
+        return {m_impacts[s],
+                m_docids.data() + m_segment_offsets[s],
+                m_docids.data() + m_segment_offsets[s + 1]};
+    }
+
+    void warmup(uint64_t term) const
+    {
+        if (num_segments(term) == 0) {
+            return;
+        }
+        auto first = get_segment(term, 0).begin;
+        auto last = get_segment(term, num_segments(term) - 1).end;
+        volatile uint32_t tmp;
+        for (auto it = first; it < last; it += 64 / sizeof(uint32_t)) {
+            tmp = *it;
+        }
+        (void)tmp;
+    }
+
+    template <typename Visitor>
+    void map(Visitor &visit)
+    {
+        visit(m_num_docs, "m_num_docs")(m_scale, "m_scale")(m_term_offsets, "m_term_offsets")(
+            m_impacts, "m_impacts")(m_segment_offsets, "m_segment_offsets")(m_docids,
+                                                                            "m_docids");
+    }
+
+   private:
+    uint64_t m_num_docs = 0;
+    float m_scale = 1.0F;
+    mapper::mappable_vector<uint64_t> m_term_offsets;
+    mapper::mappable_vector<uint32_t> m_impacts;
+    mapper::mappable_vector<uint64_t> m_segment_offsets;
+    mapper::mappable_vector<uint32_t> m_docids;
+};
+
+} // namespace pisa
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+namespace pisa {
+
+/// Maps scores in `[0, max_score]` linearly to integer impacts in `[1, 2^bits - 1]`.
+///
+/// Scores must not be negative, see `scorer::has_non_negative_scores`: the lowest impact
+/// stands for all scores up to zero. The mapping is monotonic, so quantizing every posting and
+/// every upper bound with the same quantizer keeps the upper bounds valid. Impacts are never
+/// zero: the frequency stream of an index cannot store zeros, so postings with a zero score get
+/// the lowest impact.
+class linear_quantizer {
+   public:
+    linear_quantizer(float max_score, uint32_t bits) : m_max_score(max_score)
+    {
+        if (bits < 2 || bits > 16) {
+            // Float accumulators add impacts exactly as long as sums fit in their 24-bit
+            // significand, which leaves room for queries of up to 256 terms.
+            throw std::invalid_argument("Quantization bits must be between 2 and 16");
+        }
+        m_max_impact = (uint32_t(1) << bits) - 1;
+        m_scale = max_score > 0 ? static_cast<float>(m_max_impact - 1) / max_score : 0.0F;
+    }
+
+    [[nodiscard]] auto operator()(float score) const -> uint32_t
+    {
+        auto clamped = std::clamp(score, 0.0F, m_max_score);
+        return 1 + static_cast<uint32_t>(std::lround(clamped * m_scale));
+    }
+
+    [[nodiscard]] auto max_impact() const -> uint32_t { return m_max_impact; }
+    [[nodiscard]] auto max_score() const -> float { return m_max_score; }
+
+   private:
+    float m_max_score;
+    float m_scale;
+    uint32_t m_max_impact;
+};
+
+} // namespace pisa
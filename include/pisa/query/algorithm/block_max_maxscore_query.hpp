@@ -2,14 +2,16 @@
 
 #include <vector>
 #include "query/queries.hpp"
+#include "query/query_context.hpp"
 #include "topk_queue.hpp"
 
 namespace pisa {
 
-struct block_max_maxscore_query {
+template <typename Topk = topk_queue>
+struct basic_block_max_maxscore_query {
 
-    block_max_maxscore_query(topk_queue &topk)
-        : m_topk(topk) {}
+    basic_block_max_maxscore_query(Topk &topk, query_context *context = nullptr)
+        : m_topk(topk), m_context(context) {}
 
     template<typename CursorRange>
     void operator()(CursorRange &&cursors, uint64_t max_docid) {
@@ -17,7 +19,8 @@ struct block_max_maxscore_query {
         if (cursors.empty())
             return;
 
-        std::vector<Cursor *> ordered_cursors;
+        std::vector<Cursor *> local_cursors;
+        auto &ordered_cursors = scratch_buffer(m_context, local_cursors);
         ordered_cursors.reserve(cursors.size());
         for (auto &en : cursors) {
             ordered_cursors.push_back(&en);
@@ -29,13 +32,23 @@ struct block_max_maxscore_query {
                 return lhs->max_weight < rhs->max_weight;
             });
 
-        std::vector<float> upper_bounds(ordered_cursors.size());
+        std::vector<float> local_bounds;
+        auto &upper_bounds = scratch_buffer(m_context, local_bounds);
+        upper_bounds.resize(ordered_cursors.size());
         upper_bounds[0] = ordered_cursors[0]->max_weight;
         for (size_t i = 1; i < ordered_cursors.size(); ++i) {
             upper_bounds[i] = upper_bounds[i - 1] + ordered_cursors[i]->max_weight;
         }
 
         int      non_essential_lists = 0;
+        auto update_non_essential_lists = [&]() {
+            while (non_essential_lists < ordered_cursors.size() &&
+                   !m_topk.would_enter(upper_bounds[non_essential_lists])) {
+                non_essential_lists += 1;
+            }
+        };
+        // a primed threshold may already make some lists non-essential
+        update_non_essential_lists();
         uint64_t cur_doc =
             std::min_element(cursors.begin(),
                              cursors.end(),
@@ -45,6 +58,7 @@ struct block_max_maxscore_query {
                 ->docs_enum.docid();
 
         while (non_essential_lists < ordered_cursors.size() && cur_doc < max_docid) {
+            m_documents_scored += 1;
             float    score    = 0;
             uint64_t next_doc = max_docid;
             for (size_t i = non_essential_lists; i < ordered_cursors.size(); ++i) {
@@ -88,11 +102,7 @@ struct block_max_maxscore_query {
                 score += block_upper_bound;
             }
             if (m_topk.insert(score, cur_doc)) {
-                // update non-essential lists
-                while (non_essential_lists < ordered_cursors.size() &&
-                       !m_topk.would_enter(upper_bounds[non_essential_lists])) {
-                    non_essential_lists += 1;
-                }
+                update_non_essential_lists();
             }
             cur_doc = next_doc;
         }
@@ -104,7 +114,8 @@ struct block_max_maxscore_query {
         if (cursors.empty())
             return;
 
-        std::vector<Cursor *> ordered_cursors;
+        std::vector<Cursor *> local_cursors;
+        auto &ordered_cursors = scratch_buffer(m_context, local_cursors);
         ordered_cursors.reserve(cursors.size());
         for (auto &en : cursors) {
             ordered_cursors.push_back(&en);
@@ -116,13 +127,23 @@ struct block_max_maxscore_query {
                 return lhs->max_weight < rhs->max_weight;
             });
 
-        std::vector<float> upper_bounds(ordered_cursors.size());
+        std::vector<float> local_bounds;
+        auto &upper_bounds = scratch_buffer(m_context, local_bounds);
+        upper_bounds.resize(ordered_cursors.size());
         upper_bounds[0] = ordered_cursors[0]->max_weight;
         for (size_t i = 1; i < ordered_cursors.size(); ++i) {
             upper_bounds[i] = upper_bounds[i - 1] + ordered_cursors[i]->max_weight;
         }
 
         int      non_essential_lists = 0;
+        auto update_non_essential_lists = [&]() {
+            while (non_essential_lists < ordered_cursors.size() &&
+                   !m_topk.would_enter(upper_bounds[non_essential_lists])) {
+                non_essential_lists += 1;
+            }
+        };
+        // a primed threshold may already make some lists non-essential
+        update_non_essential_lists();
         uint64_t cur_doc =
             std::min_element(cursors.begin(),
                              cursors.end(),
@@ -132,6 +153,7 @@ struct block_max_maxscore_query {
                 ->docs_enum.docid();
 
         while (non_essential_lists < ordered_cursors.size() && cur_doc < max_docid) {
+            m_documents_scored += 1;
             float    score    = 0;
             uint64_t next_doc = max_docid;
             for (size_t i = non_essential_lists; i < ordered_cursors.size(); ++i) {
@@ -175,11 +197,7 @@ struct block_max_maxscore_query {
                 score += block_upper_bound;
             }
             if (m_topk.insert(score, cur_doc)) {
-                // update non-essential lists
-                while (non_essential_lists < ordered_cursors.size() &&
-                       !m_topk.would_enter(upper_bounds[non_essential_lists])) {
-                    non_essential_lists += 1;
-                }
+                update_non_essential_lists();
             }
             cur_doc = next_doc;
         }
@@ -188,7 +206,15 @@ struct block_max_maxscore_query {
 
     std::vector<std::pair<float, uint64_t>> const &topk() const { return m_topk.topk(); }
 
+    /// Number of documents whose essential postings were scored since construction.
+    [[nodiscard]] auto documents_scored() const -> uint64_t { return m_documents_scored; }
+
    private:
-    topk_queue      &m_topk;
+    Topk            &m_topk;
+    query_context   *m_context;
+    uint64_t        m_documents_scored = 0;
 };
+
+using block_max_maxscore_query = basic_block_max_maxscore_query<>;
+
 } // namespace pisa
@@ -2,13 +2,15 @@
 
 #include <vector>
 #include "query/queries.hpp"
+#include "query/query_context.hpp"
 #include "topk_queue.hpp"
 namespace pisa {
 
-struct block_max_wand_query {
+template <typename Topk = topk_queue>
+struct basic_block_max_wand_query {
 
-    block_max_wand_query(topk_queue &topk)
-        : m_topk(topk) {}
+    basic_block_max_wand_query(Topk &topk, query_context *context = nullptr)
+        : m_topk(topk), m_context(context) {}
 
     template<typename CursorRange>
     void operator()(CursorRange &&cursors, uint64_t max_docid) {
@@ -16,7 +18,8 @@ struct block_max_wand_query {
         if (cursors.empty())
             return;
 
-        std::vector<Cursor *> ordered_cursors;
+        std::vector<Cursor *> local_cursors;
+        auto &ordered_cursors = scratch_buffer(m_context, local_cursors);
         ordered_cursors.reserve(cursors.size());
         for (auto &en : cursors) {
             ordered_cursors.push_back(&en);
@@ -76,6 +79,7 @@ struct block_max_wand_query {
 
                 // check if pivot is a possible match
                 if (pivot_id == ordered_cursors[0]->docs_enum.docid()) {
+                    m_documents_scored += 1;
                     float score    = 0;
                     for (Cursor *en : ordered_cursors) {
                         if (en->docs_enum.docid() != pivot_id) {
@@ -168,7 +172,8 @@ struct block_max_wand_query {
         if (cursors.empty())
             return;
 
-        std::vector<Cursor *> ordered_cursors;
+        std::vector<Cursor *> local_cursors;
+        auto &ordered_cursors = scratch_buffer(m_context, local_cursors);
         ordered_cursors.reserve(cursors.size());
         for (auto &en : cursors) {
             ordered_cursors.push_back(&en);
@@ -228,6 +233,7 @@ struct block_max_wand_query {
 
                 // check if pivot is a possible match
                 if (pivot_id == ordered_cursors[0]->docs_enum.docid()) {
+                    m_documents_scored += 1;
                     float score    = 0;
                     for (Cursor *en : ordered_cursors) {
                         if (en->docs_enum.docid() != pivot_id) {
@@ -320,10 +326,17 @@ struct block_max_wand_query {
 
     void clear_topk() { m_topk.clear(); }
 
-    topk_queue const &get_topk() const { return m_topk; }
+    Topk const &get_topk() const { return m_topk; }
+
+    /// Number of pivots whose postings were scored since construction.
+    [[nodiscard]] auto documents_scored() const -> uint64_t { return m_documents_scored; }
 
    private:
-    topk_queue      &m_topk;
+    Topk            &m_topk;
+    query_context   *m_context;
+    uint64_t        m_documents_scored = 0;
 };
 
+using block_max_wand_query = basic_block_max_wand_query<>;
+
 } // namespace pisa
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "query/algorithm/block_max_ranked_and_query.hpp"
+#include "scorer/scorer.hpp"
+#include "topk_queue.hpp"
+
+namespace pisa {
+
+/// Multi-query operator that seeds a disjunctive `QueryAlg` with a threshold from a conjunction.
+///
+/// The core of a fused query is made of the terms shared by the most variations, i.e., those
+/// with the largest summed `q_weight`: at most `max_core_terms` of them, each weighing at least
+/// `core_fraction` of the heaviest. A `block_max_ranked_and_query::multi_query` over the core
+/// fills a separate queue with the core scores of the documents containing all core terms.
+/// With non-negative term scores, these are lower bounds of their fused scores, so if the queue
+/// fills up, its threshold is at most the k-th fused score and `QueryAlg::multi_query` starts
+/// from it without losing any result. The threshold is lowered by the relative
+/// `threshold_slack`, since the disjunctive pass may sum the same scores in another order.
+/// It `supports` only scorers without negative term scores: with QLD, a document could score
+/// more on the core terms than on all of them, and results would be lost.
+template <typename QueryAlg>
+class conjunctive_first_query {
+   public:
+    static constexpr float threshold_slack = 1e-5F;
+
+    [[nodiscard]] static auto supports(std::string const &scorer_name) -> bool
+    {
+        return scorer::has_non_negative_scores(scorer_name);
+    }
+
+    explicit conjunctive_first_query(topk_queue &topk,
+                                     size_t max_core_terms = 3,
+                                     float core_fraction = 0.5F)
+        : m_topk(topk),
+          m_max_core_terms(max_core_terms),
+          m_core_fraction(core_fraction),
+          m_query_alg(topk)
+    {}
+
+    /// `seed_cursors` are block-max scored cursors over the same terms as `cursors`; the former
+    /// are consumed by the conjunctive pass, the latter by `QueryAlg`.
+    template <typename SeedCursorRange, typename CursorRange>
+    void multi_query(SeedCursorRange &&seed_cursors, CursorRange &&cursors, uint64_t max_docid)
+    {
+        using Cursor = typename std::decay_t<SeedCursorRange>::value_type;
+        m_seed_threshold = 0;
+        if (seed_cursors.empty()) {
+            return;
+        }
+
+        std::vector<Cursor *> by_weight;
+        by_weight.reserve(seed_cursors.size());
+        for (auto &cursor : seed_cursors) {
+            by_weight.push_back(&cursor);
+        }
+        std::sort(by_weight.begin(), by_weight.end(), [](Cursor *lhs, Cursor *rhs) {
+            return lhs->q_weight > rhs->q_weight;
+        });
+        std::vector<Cursor> core;
+        for (auto *cursor : by_weight) {
+            if (core.size() == m_max_core_terms
+                || cursor->q_weight < m_core_fraction * by_weight.front()->q_weight) {
+                break;
+            }
+            core.push_back(std::move(*cursor));
+        }
+
+        topk_queue seed(m_topk.size());
+        seed.set_threshold(m_topk.threshold());
+        block_max_ranked_and_query core_q(seed);
+        core_q.multi_query(core, max_docid);
+        if (seed.full() && seed.threshold() > 0) {
+            m_seed_threshold = seed.threshold() * (1.0F - threshold_slack);
+            if (m_seed_threshold > m_topk.threshold()) {
+                m_topk.set_threshold(m_seed_threshold);
+            }
+        }
+
+        m_query_alg.multi_query(cursors, max_docid);
+    }
+
+    std::vector<std::pair<float, uint64_t>> const &topk() const { return m_topk.topk(); }
+
+    /// Threshold found by the conjunctive pass of the last query, or 0 if it found fewer than
+    /// k documents.
+    [[nodiscard]] auto seed_threshold() const -> float { return m_seed_threshold; }
+
+    /// Documents scored by the disjunctive passes, for a `QueryAlg` that counts them.
+    [[nodiscard]] auto documents_scored() const -> uint64_t
+    {
+        return m_query_alg.documents_scored();
+    }
+
+   private:
+    topk_queue &m_topk;
+    size_t m_max_core_terms;
+    float m_core_fraction;
+    QueryAlg m_query_alg;
+    float m_seed_threshold = 0;
+};
+
+} // namespace pisa
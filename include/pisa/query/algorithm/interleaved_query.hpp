@@ -0,0 +1,101 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+#include "query/algorithm/shared_threshold_query.hpp"
+#include "query/fused_threshold.hpp"
+#include "query/query_context.hpp"
+#include "topk_queue.hpp"
+
+namespace pisa {
+
+/// Processes several independent queries, such as the variations of a multi-query, on one
+/// thread, interleaved in ranges of `range_size` documents, to hide the memory latency of
+/// indexes that do not fit in the cache.
+///
+/// Every query keeps its cursors and its top-k queue between ranges, as with `range_query`, so
+/// that it can be resumed where it stopped. Once a query has processed a range, the next
+/// blocks of its cursors (and of their block-max data) are prefetched, if the enumerators
+/// support it, and the other queries process the range while they are loaded.
+///
+/// Each range of a query is processed by `shared_threshold_query::process_range`: with a
+/// `fused_threshold`, query `i` is variation `i`, and thresholds are exchanged before and after
+/// each range. Term scores are weighted by `q_weight`, as in `QueryAlg::multi_query`. The
+/// queries run one after the other, so they share `context` for the scratch space of the
+/// operators.
+template <typename QueryAlg>
+struct interleaved_query {
+
+    static constexpr std::size_t default_range_size = 1U << 12U;
+
+    /// Number of blocks prefetched ahead of every cursor.
+    static constexpr uint32_t prefetch_distance = 2;
+
+    explicit interleaved_query(std::vector<topk_queue> &topks,
+                               fused_threshold *shared = nullptr,
+                               query_context *context = nullptr,
+                               std::size_t range_size = default_range_size)
+        : m_topks(topks), m_shared(shared), m_context(context), m_range_size(range_size)
+    {}
+
+    template <typename CursorRange>
+    void operator()(std::vector<CursorRange> &queries, uint64_t max_docid)
+    {
+        assert(queries.size() == m_topks.size());
+        std::vector<shared_threshold_query<QueryAlg>> query_algs;
+        query_algs.reserve(queries.size());
+        for (std::size_t query = 0; query < queries.size(); ++query) {
+            query_algs.emplace_back(m_topks[query], m_shared, query, m_context);
+        }
+        for (uint64_t end = std::min<uint64_t>(m_range_size, max_docid);; end += m_range_size) {
+            end = std::min(end, max_docid);
+            for (std::size_t query = 0; query < queries.size(); ++query) {
+                auto &cursors = queries[query];
+                if (cursors.empty()) {
+                    continue;
+                }
+                query_algs[query].process_range(cursors, end);
+                for (auto const &cursor : cursors) {
+                    prefetch(cursor, 0);
+                }
+            }
+            if (end == max_docid) {
+                break;
+            }
+        }
+    }
+
+   private:
+    template <typename Cursor>
+    static auto prefetch(Cursor const &cursor, int) -> decltype(cursor.w, void())
+    {
+        prefetch_blocks(cursor.docs_enum, 0);
+        prefetch_blocks(cursor.w, 0);
+    }
+
+    template <typename Cursor>
+    static void prefetch(Cursor const &cursor, long)
+    {
+        prefetch_blocks(cursor.docs_enum, 0);
+    }
+
+    template <typename Enum>
+    static auto prefetch_blocks(Enum const &enumerator, int)
+        -> decltype(enumerator.prefetch_blocks(prefetch_distance))
+    {
+        enumerator.prefetch_blocks(prefetch_distance);
+    }
+
+    template <typename Enum>
+    static void prefetch_blocks(Enum const &, long)
+    {}
+
+    std::vector<topk_queue> &m_topks;
+    fused_threshold *m_shared;
+    query_context *m_context;
+    std::size_t m_range_size;
+};
+
+} // namespace pisa
@@ -1,15 +1,18 @@
 #pragma once
 
 #include <vector>
+#include "cursor/posting_score.hpp"
 #include "query/queries.hpp"
+#include "query/query_context.hpp"
 #include "topk_queue.hpp"
 
 namespace pisa {
 
-struct maxscore_query {
+template <typename Topk = topk_queue>
+struct basic_maxscore_query {
 
-    maxscore_query(topk_queue &topk)
-    : m_topk(topk) {}
+    basic_maxscore_query(Topk &topk, query_context *context = nullptr)
+        : m_topk(topk), m_context(context) {}
 
     template<typename CursorRange>
     void operator()(CursorRange &&cursors, uint64_t max_docid) {
@@ -17,7 +20,8 @@ struct maxscore_query {
         if (cursors.empty())
             return;
 
-        std::vector<Cursor *> ordered_cursors;
+        std::vector<Cursor *> local_cursors;
+        auto &ordered_cursors = scratch_buffer(m_context, local_cursors);
         ordered_cursors.reserve(cursors.size());
         for (auto &en : cursors) {
             ordered_cursors.push_back(&en);
@@ -29,7 +33,9 @@ struct maxscore_query {
                 return lhs->max_weight < rhs->max_weight;
             });
 
-        std::vector<float> upper_bounds(ordered_cursors.size());
+        std::vector<float> local_bounds;
+        auto &upper_bounds = scratch_buffer(m_context, local_bounds);
+        upper_bounds.resize(ordered_cursors.size());
         upper_bounds[0] = ordered_cursors[0]->max_weight;
         for (size_t i = 1; i < ordered_cursors.size(); ++i) {
             upper_bounds[i] = upper_bounds[i - 1] + ordered_cursors[i]->max_weight;
@@ -57,7 +63,7 @@ struct maxscore_query {
             uint64_t next_doc = max_docid;
             for (size_t i = non_essential_lists; i < ordered_cursors.size(); ++i) {
                 if (ordered_cursors[i]->docs_enum.docid() == cur_doc) {
-                    score += ordered_cursors[i]->scorer(ordered_cursors[i]->docs_enum.docid(), ordered_cursors[i]->docs_enum.freq());
+                    score += posting_score(*ordered_cursors[i]);
                     ordered_cursors[i]->docs_enum.next();
                 }
                 if (ordered_cursors[i]->docs_enum.docid() < next_doc) {
@@ -90,7 +96,8 @@ struct maxscore_query {
         if (cursors.empty())
             return;
 
-        std::vector<Cursor *> ordered_cursors;
+        std::vector<Cursor *> local_cursors;
+        auto &ordered_cursors = scratch_buffer(m_context, local_cursors);
         ordered_cursors.reserve(cursors.size());
         for (auto &en : cursors) {
             ordered_cursors.push_back(&en);
@@ -102,7 +109,9 @@ struct maxscore_query {
                 return lhs->max_weight < rhs->max_weight;
             });
 
-        std::vector<float> upper_bounds(ordered_cursors.size());
+        std::vector<float> local_bounds;
+        auto &upper_bounds = scratch_buffer(m_context, local_bounds);
+        upper_bounds.resize(ordered_cursors.size());
         upper_bounds[0] = ordered_cursors[0]->max_weight;
         for (size_t i = 1; i < ordered_cursors.size(); ++i) {
             upper_bounds[i] = upper_bounds[i - 1] + ordered_cursors[i]->max_weight;
@@ -130,7 +139,7 @@ struct maxscore_query {
             uint64_t next_doc = max_docid;
             for (size_t i = non_essential_lists; i < ordered_cursors.size(); ++i) {
                 if (ordered_cursors[i]->docs_enum.docid() == cur_doc) {
-                    score += ordered_cursors[i]->q_weight * ordered_cursors[i]->scorer(ordered_cursors[i]->docs_enum.docid(), ordered_cursors[i]->docs_enum.freq());
+                    score += ordered_cursors[i]->q_weight * posting_score(*ordered_cursors[i]);
                     ordered_cursors[i]->docs_enum.next();
                 }
                 if (ordered_cursors[i]->docs_enum.docid() < next_doc) {
@@ -161,7 +170,10 @@ struct maxscore_query {
     std::vector<std::pair<float, uint64_t>> const &topk() const { return m_topk.topk(); }
 
    private:
-    topk_queue      &m_topk;
+    Topk            &m_topk;
+    query_context   *m_context;
 };
 
+using maxscore_query = basic_maxscore_query<>;
+
 } // namespace pisa
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include "concurrent_topk_queue.hpp"
+#include "cursor/block_max_scored_cursor.hpp"
+#include "query/queries.hpp"
+#include "query/query_context.hpp"
+#include "topk_queue.hpp"
+#include "util/work_stealing_executor.hpp"
+
+namespace pisa {
+
+/// The operator `QueryAlg`, an instance of a class template on its top-k queue such as
+/// `basic_wand_query<topk_queue>`, instantiated for the queue `Topk` instead.
+template <typename QueryAlg, typename Topk>
+struct with_topk;
+
+template <template <typename> class QueryAlg, typename Original, typename Topk>
+struct with_topk<QueryAlg<Original>, Topk> {
+    using type = QueryAlg<Topk>;
+};
+
+template <typename QueryAlg, typename Topk>
+using with_topk_t = typename with_topk<QueryAlg, Topk>::type;
+
+/// Processes a single (typically large, SP-CS) query by splitting the document space into
+/// `num_ranges` ranges that are processed concurrently on an executor.
+///
+/// Each range gets its own copy of the cursors, moved to the start of the range, and runs
+/// `QueryAlg` on its own local queue of a `concurrent_topk_queue`, whose threshold is shared
+/// by all ranges while they run. Block-max upper bounds are used to skip ranges that cannot
+/// contain a document above that threshold, and ranges are started in decreasing order of
+/// their upper bound so that it rises early. Local results are merged at the end.
+///
+/// `QueryAlg` must be an operator templated on its top-k queue, see `with_topk`.
+///
+/// Cursors must provide block-max data (`w`), as those of `make_block_max_scored_cursors`.
+/// Term scores are weighted by `q_weight`, as in `QueryAlg::multi_query`.
+template <typename QueryAlg>
+struct parallel_range_query {
+
+    parallel_range_query(topk_queue &topk, work_stealing_executor &executor, size_t num_ranges)
+        : m_topk(topk), m_executor(executor), m_num_ranges(num_ranges)
+    {}
+
+    template <typename CursorRange>
+    void operator()(CursorRange &&cursors, uint64_t max_docid)
+    {
+        using Cursor = typename std::decay_t<CursorRange>::value_type;
+        if (cursors.empty() || max_docid == 0) {
+            return;
+        }
+        if (m_num_ranges <= 1) {
+            QueryAlg query_alg(m_topk);
+            query_alg.multi_query(cursors, max_docid);
+            return;
+        }
+
+        uint64_t range_size = (max_docid + m_num_ranges - 1) / m_num_ranges;
+        size_t num_ranges = (max_docid + range_size - 1) / range_size;
+        auto upper_bounds = range_upper_bounds(cursors, range_size, num_ranges, max_docid);
+        std::vector<size_t> order(num_ranges);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](auto lhs, auto rhs) {
+            return upper_bounds[lhs] > upper_bounds[rhs];
+        });
+
+        concurrent_topk_queue shared(m_topk.size(), m_topk.threshold());
+        m_executor.parallel_for(num_ranges, [&](size_t idx) {
+            auto range = order[idx];
+            if (upper_bounds[range] <= shared.threshold()) {
+                return;
+            }
+            uint64_t begin = range * range_size;
+            uint64_t end = std::min(begin + range_size, max_docid);
+            std::vector<Cursor> local_cursors(cursors.begin(), cursors.end());
+            for (auto &cursor : local_cursors) {
+                cursor.docs_enum.next_geq(begin);
+                cursor.w.next_geq(begin);
+            }
+            concurrent_topk_queue::local_queue topk(shared);
+            with_topk_t<QueryAlg, concurrent_topk_queue::local_queue> query_alg(topk);
+            query_alg.multi_query(local_cursors, end);
+            topk.finalize();
+        });
+
+        shared.finalize();
+        for (auto const &[score, docid] : shared.topk()) {
+            m_topk.insert(score, docid);
+        }
+    }
+
+    std::vector<std::pair<float, uint64_t>> const &topk() const { return m_topk.topk(); }
+
+   private:
+    /// Sums, for each range, the largest block-max score of every term over the blocks
+    /// overlapping the range.
+    template <typename CursorRange>
+    static auto range_upper_bounds(CursorRange const &cursors,
+                                   uint64_t range_size,
+                                   size_t num_ranges,
+                                   uint64_t max_docid) -> std::vector<float>
+    {
+        std::vector<float> upper_bounds(num_ranges, 0.0F);
+        for (auto const &cursor : cursors) {
+            auto w = cursor.w;
+            for (size_t range = 0; range < num_ranges; ++range) {
+                uint64_t begin = range * range_size;
+                uint64_t end = std::min(begin + range_size, max_docid);
+                w.next_geq(begin);
+                if (w.docid() < begin) {
+                    break; // past the last block
+                }
+                float block_max = w.score();
+                while (w.docid() + 1 < end) {
+                    auto last = w.docid();
+                    w.next_geq(last + 1);
+                    if (w.docid() == last) {
+                        break;
+                    }
+                    block_max = std::max(block_max, w.score());
+                }
+                upper_bounds[range] += cursor.q_weight * block_max;
+            }
+        }
+        return upper_bounds;
+    }
+
+    topk_queue &m_topk;
+    work_stealing_executor &m_executor;
+    size_t m_num_ranges;
+};
+
+/// Returns a function processing a query with `parallel_range_query<QueryAlg>` over
+/// `num_ranges` docid ranges on `executor`, with its top-k primed with the given threshold.
+///
+/// The function returns the finalized top-k, which is valid until its next call. Each copy of
+/// the function owns a `query_context`, so copies may run on different threads.
+template <typename QueryAlg, typename Index, typename WandType, typename Scorer>
+auto parallel_range_fun(Index const &index,
+                        WandType const &wdata,
+                        Scorer const &scorer,
+                        work_stealing_executor *executor,
+                        uint64_t k,
+                        size_t num_ranges)
+{
+    return [&index, &wdata, &scorer, executor, k, num_ranges, context = query_context()](
+               Query const &query,
+               Threshold t) mutable -> std::vector<std::pair<float, uint64_t>> const & {
+        auto &topk = context.topk(k);
+        topk.set_threshold(t);
+        parallel_range_query<QueryAlg> query_alg(topk, *executor, num_ranges);
+        query_alg(make_block_max_scored_cursors(context, index, wdata, scorer, query),
+                  index.num_docs());
+        topk.finalize();
+        return topk.topk();
+    };
+}
+
+} // namespace pisa
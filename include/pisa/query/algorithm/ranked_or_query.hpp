@@ -2,13 +2,15 @@
 
 #include <string>
 #include <vector>
+#include "cursor/posting_score.hpp"
 #include "query/queries.hpp"
 
 namespace pisa {
 
-struct ranked_or_query {
+template <typename Topk = topk_queue>
+struct basic_ranked_or_query {
 
-    ranked_or_query(topk_queue &topk)
+    basic_ranked_or_query(Topk &topk)
         : m_topk(topk){}
 
     template <typename CursorRange>
@@ -27,7 +29,7 @@ struct ranked_or_query {
             uint64_t next_doc = max_docid;
             for (size_t i = 0; i < cursors.size(); ++i) {
                 if (cursors[i].docs_enum.docid() == cur_doc) {
-                    score += cursors[i].scorer(cursors[i].docs_enum.docid(), cursors[i].docs_enum.freq());
+                    score += posting_score(cursors[i]);
                     cursors[i].docs_enum.next();
                 }
                 if (cursors[i].docs_enum.docid() < next_doc) {
@@ -56,7 +58,7 @@ struct ranked_or_query {
             uint64_t next_doc = max_docid;
             for (size_t i = 0; i < cursors.size(); ++i) {
                 if (cursors[i].docs_enum.docid() == cur_doc) {
-                    score += cursors[i].q_weight * cursors[i].scorer(cursors[i].docs_enum.docid(), cursors[i].docs_enum.freq());
+                    score += cursors[i].q_weight * posting_score(cursors[i]);
                     cursors[i].docs_enum.next();
                 }
                 if (cursors[i].docs_enum.docid() < next_doc) {
@@ -73,7 +75,9 @@ struct ranked_or_query {
     std::vector<std::pair<float, uint64_t>> const &topk() const { return m_topk.topk(); }
 
    private:
-    topk_queue      &m_topk;
+    Topk            &m_topk;
 };
 
+using ranked_or_query = basic_ranked_or_query<>;
+
 }  // namespace pisa
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "cursor/posting_score.hpp"
 #include "query/queries.hpp"
 #include "topk_queue.hpp"
 #include "util/intrinsics.hpp"
@@ -17,6 +18,22 @@ class ranked_or_taat_query {
 
     template <typename CursorRange, typename Acc>
     void operator()(CursorRange &&cursors, uint64_t max_docid, Acc &&accumulator) {
+        process<false>(cursors, max_docid, accumulator);
+    }
+
+    /// Like `operator()`, but scales the scores of each term by its query weight, which for a
+    /// fused query is the weight summed over the variations containing the term. Each distinct
+    /// term is thus traversed once, however many variations contain it.
+    template <typename CursorRange, typename Acc>
+    void multi_query(CursorRange &&cursors, uint64_t max_docid, Acc &&accumulator) {
+        process<true>(cursors, max_docid, accumulator);
+    }
+
+    std::vector<std::pair<float, uint64_t>> const &topk() const { return m_topk.topk(); }
+
+   private:
+    template <bool weighted, typename CursorRange, typename Acc>
+    void process(CursorRange &&cursors, uint64_t max_docid, Acc &&accumulator) {
         using Cursor = typename std::decay_t<CursorRange>::value_type;
         if (cursors.empty()) {
             return;
@@ -24,19 +41,41 @@ class ranked_or_taat_query {
         accumulator.init();
 
         for (auto &&cursor : cursors) {
-            while (cursor.docs_enum.docid() < max_docid) {
-                accumulator.accumulate(
-                    cursor.docs_enum.docid(),
-                    cursor.scorer(cursor.docs_enum.docid(), cursor.docs_enum.freq()));
-                cursor.docs_enum.next();
+            auto weight = [&](float score) {
+                if constexpr (weighted) {
+                    return cursor.q_weight * score;
+                } else {
+                    return score;
+                }
+            };
+            if constexpr (scores_blocks<Cursor>::value) {
+                // Score a block at a time, then accumulate its postings from the current one.
+                while (cursor.docs_enum.docid() < max_docid) {
+                    auto scores = cursor.block_scores();
+                    auto docs = cursor.block_docs();
+                    auto pos = cursor.docs_enum.position_in_block();
+                    for (; pos < cursor.block_length() && docs[pos] < max_docid; ++pos) {
+                        accumulator.accumulate(docs[pos], weight(scores[pos]));
+                    }
+                    if (pos < cursor.block_length()) {
+                        // Leave the cursor at `max_docid`, as range queries resume from it.
+                        cursor.docs_enum.next_geq(max_docid);
+                        break;
+                    }
+                    cursor.docs_enum.next_block();
+                }
+            } else {
+                while (cursor.docs_enum.docid() < max_docid) {
+                    accumulator.accumulate(
+                        cursor.docs_enum.docid(),
+                        weight(cursor.scorer(cursor.docs_enum.docid(), cursor.docs_enum.freq())));
+                    cursor.docs_enum.next();
+                }
             }
         }
         accumulator.aggregate(m_topk);
     }
 
-    std::vector<std::pair<float, uint64_t>> const &topk() const { return m_topk.topk(); }
-
-   private:
     topk_queue &m_topk;
 };
 
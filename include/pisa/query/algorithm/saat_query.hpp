@@ -0,0 +1,126 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "topk_queue.hpp"
+
+namespace pisa {
+
+/// Score-at-a-time processing of a weighted query over an `impact_ordered_index`.
+///
+/// The segments of all query terms are processed in decreasing order of their contribution,
+/// `q_weight * impact`, adding it to the accumulator of every document of the segment. Since
+/// the most important postings come first, processing can stop at any time: it ends before
+/// the next segment once `postings_budget` postings have been processed or `time_budget`
+/// has elapsed, which bounds the query latency. Without budgets, the result is exact with
+/// respect to the quantized scores.
+class saat_query {
+   public:
+    explicit saat_query(topk_queue &topk,
+                        uint64_t postings_budget = std::numeric_limits<uint64_t>::max(),
+                        std::chrono::microseconds time_budget = std::chrono::microseconds::max())
+        : m_topk(topk), m_postings_budget(postings_budget), m_time_budget(time_budget)
+    {}
+
+    /// Processes the distinct terms of a query with their weights, as returned by
+    /// `query_term_weights`. Scores are in the same units as the unquantized scores. Terms
+    /// must be in `index`, see `find_missing_term`.
+    template <typename Index, typename TermWeights, typename Acc>
+    void operator()(Index const &index, TermWeights const &terms, Acc &&accumulator)
+    {
+        auto start = std::chrono::steady_clock::now();
+        bool timed = m_time_budget != std::chrono::microseconds::max();
+        m_postings = 0;
+        m_terminated_early = false;
+        if (terms.empty()) {
+            return;
+        }
+        accumulator.init();
+
+        m_segments.clear();
+        for (auto const &[term, weight] : terms) {
+            assert(term < index.size());
+            for (uint64_t i = 0; i < index.num_segments(term); ++i) {
+                auto impact = index.get_segment(term, i).impact;
+                m_segments.push_back({weight * impact * index.quantization_scale(), term, i});
+            }
+        }
+        std::sort(m_segments.begin(), m_segments.end(), [](auto const &lhs, auto const &rhs) {
+            return lhs.contribution > rhs.contribution;
+        });
+
+        for (auto const &s : m_segments) {
+            if (m_postings >= m_postings_budget
+                || (timed && std::chrono::steady_clock::now() - start >= m_time_budget)) {
+                m_terminated_early = true;
+                break;
+            }
+            auto segment = index.get_segment(s.term, s.index);
+            for (auto docid = segment.begin; docid != segment.end; ++docid) {
+                accumulator.accumulate(*docid, s.contribution);
+            }
+            m_postings += segment.size();
+        }
+        accumulator.aggregate(m_topk);
+    }
+
+    std::vector<std::pair<float, uint64_t>> const &topk() const { return m_topk.topk(); }
+
+    /// Number of postings processed by the last query.
+    [[nodiscard]] auto postings() const -> uint64_t { return m_postings; }
+
+    /// Whether the last query stopped on a budget before processing every segment.
+    [[nodiscard]] auto terminated_early() const -> bool { return m_terminated_early; }
+
+   private:
+    struct segment_ref {
+        float contribution;
+        uint64_t term;
+        uint64_t index;
+    };
+
+    topk_queue &m_topk;
+    uint64_t m_postings_budget;
+    std::chrono::microseconds m_time_budget;
+    std::vector<segment_ref> m_segments;
+    uint64_t m_postings = 0;
+    bool m_terminated_early = false;
+};
+
+/// Returns the first term of `queries` that is not in `index`, if any. The terms of an
+/// impact-ordered index built from another collection may not cover those of the queries.
+template <typename Index, typename Queries>
+[[nodiscard]] auto find_missing_term(Index const &index, Queries const &queries)
+    -> std::optional<uint64_t>
+{
+    for (auto const &query : queries) {
+        for (auto term : query.terms) {
+            if (term >= index.size()) {
+                return term;
+            }
+        }
+    }
+    return std::nullopt;
+}
+
+/// Impact-ordered index and anytime budgets of `saat_query`, as given to the tools.
+struct saat_options {
+    std::optional<std::string> index_filename;
+    uint64_t postings_budget = std::numeric_limits<uint64_t>::max();
+    uint64_t time_budget = 0; // microseconds, 0 for none
+
+    [[nodiscard]] auto time() const -> std::chrono::microseconds
+    {
+        return time_budget > 0 ? std::chrono::microseconds(time_budget)
+                               : std::chrono::microseconds::max();
+    }
+};
+
+} // namespace pisa
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <vector>
+
+#include "query/queries.hpp"
+#include "topk_queue.hpp"
+
+namespace pisa {
+
+/// Computes the exact top-k of every variation of a multi-query in a single pass.
+///
+/// Each distinct term has a single cursor, shared by all variations containing it, so every
+/// posting list is decoded (and every posting scored) at most once. Each variation keeps its
+/// own top-k queue and MaxScore partition into essential and non-essential terms. A document
+/// is a candidate if it appears in a term that is essential for at least one variation;
+/// terms that are non-essential for every variation are only probed with `next_geq` when
+/// some variation still needs them to decide whether the candidate enters its top-k.
+///
+/// `Topk` is `topk_queue` or, for large k, `buffered_topk_queue`.
+template <typename Topk = topk_queue>
+struct shared_maxscore_query {
+
+    explicit shared_maxscore_query(std::vector<Topk> &topks) : m_topks(topks) {}
+
+    /// `variations[v]` lists the `(cursor position, weight)` pairs of variation `v`, as in
+    /// `shared_multi_query::variations`; its results are collected in `topks[v]`.
+    template <typename CursorRange, typename Variations>
+    void operator()(CursorRange &&cursors, Variations const &variations, uint64_t max_docid)
+    {
+        if (cursors.empty()) {
+            return;
+        }
+        assert(variations.size() <= m_topks.size());
+
+        struct variation_term {
+            size_t cursor;
+            float weight;
+            float max_weight;
+        };
+        struct variation_state {
+            std::vector<variation_term> terms; // increasing max_weight
+            std::vector<float> upper_bounds;   // prefix sums of max_weight
+            size_t non_essential = 0;
+        };
+        struct term_membership {
+            size_t variation;
+            size_t position;
+        };
+
+        std::vector<variation_state> states(variations.size());
+        std::vector<std::vector<term_membership>> memberships(cursors.size());
+        for (size_t v = 0; v < variations.size(); ++v) {
+            auto &state = states[v];
+            for (auto const &[cursor, weight] : variations[v]) {
+                state.terms.push_back({cursor, weight, weight * cursors[cursor].max_weight});
+            }
+            std::sort(state.terms.begin(), state.terms.end(), [](auto const &lhs, auto const &rhs) {
+                return lhs.max_weight < rhs.max_weight;
+            });
+            float sum = 0;
+            for (size_t pos = 0; pos < state.terms.size(); ++pos) {
+                sum += state.terms[pos].max_weight;
+                state.upper_bounds.push_back(sum);
+                memberships[state.terms[pos].cursor].push_back({v, pos});
+            }
+        }
+
+        // Number of variations for which each term is essential.
+        std::vector<size_t> essential_for(cursors.size(), 0);
+        for (auto &state : states) {
+            for (auto const &term : state.terms) {
+                essential_for[term.cursor] += 1;
+            }
+        }
+        // Snapshot of the essential terms, only refreshed between candidates so that all
+        // variations scoring the same document agree on which cursors were traversed.
+        std::vector<size_t> essential;
+        std::vector<bool> is_essential(cursors.size(), false);
+        auto update_essential = [&]() {
+            essential.clear();
+            for (size_t c = 0; c < cursors.size(); ++c) {
+                is_essential[c] = essential_for[c] > 0;
+                if (is_essential[c]) {
+                    essential.push_back(c);
+                }
+            }
+        };
+        auto update_non_essential = [&](size_t v) {
+            auto &state = states[v];
+            bool changed = false;
+            while (state.non_essential < state.terms.size()
+                   && !m_topks[v].would_enter(state.upper_bounds[state.non_essential])) {
+                essential_for[state.terms[state.non_essential].cursor] -= 1;
+                changed |= essential_for[state.terms[state.non_essential].cursor] == 0;
+                state.non_essential += 1;
+            }
+            return changed;
+        };
+        bool changed = false;
+        for (size_t v = 0; v < states.size(); ++v) {
+            changed |= update_non_essential(v);
+        }
+        update_essential();
+
+        // Scores of the current candidate, computed at most once per term.
+        constexpr uint64_t no_doc = std::numeric_limits<uint64_t>::max();
+        std::vector<float> term_scores(cursors.size(), 0);
+        std::vector<uint64_t> scored_doc(cursors.size(), no_doc);
+        std::vector<uint64_t> touched_doc(states.size(), no_doc);
+        std::vector<size_t> touched;
+        auto term_score = [&](size_t c, uint64_t doc) {
+            if (scored_doc[c] != doc) {
+                auto &cursor = cursors[c];
+                term_scores[c] = cursor.scorer(cursor.docs_enum.docid(), cursor.docs_enum.freq());
+                scored_doc[c] = doc;
+            }
+            return term_scores[c];
+        };
+
+        uint64_t cur_doc = max_docid;
+        for (auto c : essential) {
+            cur_doc = std::min<uint64_t>(cur_doc, cursors[c].docs_enum.docid());
+        }
+
+        while (not essential.empty() && cur_doc < max_docid) {
+            uint64_t next_doc = max_docid;
+            touched.clear();
+            for (auto c : essential) {
+                auto &cursor = cursors[c];
+                if (cursor.docs_enum.docid() == cur_doc) {
+                    term_score(c, cur_doc);
+                    for (auto const &m : memberships[c]) {
+                        if (touched_doc[m.variation] != cur_doc
+                            && m.position >= states[m.variation].non_essential) {
+                            touched_doc[m.variation] = cur_doc;
+                            touched.push_back(m.variation);
+                        }
+                    }
+                    cursor.docs_enum.next();
+                }
+                if (cursor.docs_enum.docid() < next_doc) {
+                    next_doc = cursor.docs_enum.docid();
+                }
+            }
+
+            changed = false;
+            for (auto v : touched) {
+                auto &state = states[v];
+                float score = 0;
+                float unknown = 0;
+                for (auto const &term : state.terms) {
+                    if (is_essential[term.cursor]) {
+                        if (scored_doc[term.cursor] == cur_doc) {
+                            score += term.weight * term_scores[term.cursor];
+                        }
+                    } else {
+                        unknown += term.max_weight;
+                    }
+                }
+                // Complete the score with the terms no variation treats as essential.
+                for (size_t pos = state.terms.size(); pos > 0 && unknown > 0; --pos) {
+                    auto const &term = state.terms[pos - 1];
+                    if (is_essential[term.cursor]) {
+                        continue;
+                    }
+                    if (!m_topks[v].would_enter(score + unknown)) {
+                        break;
+                    }
+                    unknown -= term.max_weight;
+                    auto &cursor = cursors[term.cursor];
+                    cursor.docs_enum.next_geq(cur_doc);
+                    if (cursor.docs_enum.docid() == cur_doc) {
+                        score += term.weight * term_score(term.cursor, cur_doc);
+                    }
+                }
+                if (m_topks[v].insert(score, cur_doc)) {
+                    changed |= update_non_essential(v);
+                }
+            }
+            if (changed) {
+                update_essential();
+                next_doc = max_docid;
+                for (auto c : essential) {
+                    next_doc = std::min<uint64_t>(next_doc, cursors[c].docs_enum.docid());
+                }
+            }
+            cur_doc = next_doc;
+        }
+    }
+
+    std::vector<Topk> const &topks() const { return m_topks; }
+
+   private:
+    std::vector<Topk> &m_topks;
+};
+
+} // namespace pisa
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <algorithm>
+#include <type_traits>
+
+#include "query/fused_threshold.hpp"
+#include "query/queries.hpp"
+#include "query/query_context.hpp"
+#include "topk_queue.hpp"
+
+namespace pisa {
+
+/// Runs `QueryAlg::multi_query`, which weights term scores by `q_weight`, for one variation of
+/// a multi-query while exchanging thresholds with the other variations through a
+/// `fused_threshold`.
+///
+/// Like `range_query`, documents are processed in ranges of `range_size`; before each range
+/// the local threshold is raised to the one derived from the shared bound, and after each
+/// range the local k-th score is published. Without a shared threshold, this is a single call.
+/// The operators get `context` for their scratch space if they accept one.
+template <typename QueryAlg>
+struct shared_threshold_query {
+
+    static constexpr std::size_t default_range_size = 1U << 16U;
+
+    shared_threshold_query(topk_queue &topk,
+                           fused_threshold *shared,
+                           std::size_t variation,
+                           query_context *context = nullptr,
+                           std::size_t range_size = default_range_size)
+        : m_topk(topk),
+          m_shared(shared),
+          m_variation(variation),
+          m_context(context),
+          m_range_size(range_size)
+    {}
+
+    template <typename CursorRange>
+    void operator()(CursorRange &&cursors, uint64_t max_docid)
+    {
+        if (m_shared == nullptr) {
+            make_query_alg().multi_query(cursors, max_docid);
+            return;
+        }
+        if (cursors.empty()) {
+            return;
+        }
+        for (uint64_t end = std::min<uint64_t>(m_range_size, max_docid);; end += m_range_size) {
+            end = std::min(end, max_docid);
+            process_range(cursors, end);
+            if (end == max_docid) {
+                break;
+            }
+        }
+    }
+
+    /// Processes the documents of `cursors` up to `end`, from where the last range stopped,
+    /// exchanging thresholds before and after it if there is a shared threshold.
+    template <typename CursorRange>
+    void process_range(CursorRange &cursors, uint64_t end)
+    {
+        if (m_shared != nullptr) {
+            auto threshold = m_shared->threshold(m_variation);
+            if (threshold > m_topk.threshold()) {
+                m_topk.set_threshold(threshold);
+            }
+        }
+        make_query_alg().multi_query(cursors, end);
+        if (m_shared != nullptr && m_topk.full()) {
+            m_shared->publish(m_topk.topk().front().first);
+        }
+    }
+
+    std::vector<std::pair<float, uint64_t>> const &topk() const { return m_topk.topk(); }
+
+   private:
+    [[nodiscard]] auto make_query_alg() -> QueryAlg
+    {
+        if constexpr (std::is_constructible_v<QueryAlg, topk_queue &, query_context *>) {
+            return QueryAlg(m_topk, m_context);
+        } else {
+            return QueryAlg(m_topk);
+        }
+    }
+
+    topk_queue &m_topk;
+    fused_threshold *m_shared;
+    std::size_t m_variation;
+    query_context *m_context;
+    std::size_t m_range_size;
+};
+
+} // namespace pisa
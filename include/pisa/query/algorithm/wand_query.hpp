@@ -4,14 +4,16 @@
 
 #include "topk_queue.hpp"
 #include "query/queries.hpp"
+#include "query/query_context.hpp"
 #include "topk_queue.hpp"
 
 namespace pisa {
 
-struct wand_query {
+template <typename Topk = topk_queue>
+struct basic_wand_query {
 
-    wand_query(topk_queue &topk)
-        : m_topk(topk) {}
+    basic_wand_query(Topk &topk, query_context *context = nullptr)
+        : m_topk(topk), m_context(context) {}
 
     template<typename CursorRange>
     void operator()(CursorRange &&cursors, uint64_t max_docid) {
@@ -19,7 +21,8 @@ struct wand_query {
         if (cursors.empty())
             return;
 
-        std::vector<Cursor *> ordered_cursors;
+        std::vector<Cursor *> local_cursors;
+        auto &ordered_cursors = scratch_buffer(m_context, local_cursors);
         ordered_cursors.reserve(cursors.size());
         for (auto &en : cursors) {
             ordered_cursors.push_back(&en);
@@ -94,7 +97,8 @@ struct wand_query {
         if (cursors.empty())
             return;
 
-        std::vector<Cursor *> ordered_cursors;
+        std::vector<Cursor *> local_cursors;
+        auto &ordered_cursors = scratch_buffer(m_context, local_cursors);
         ordered_cursors.reserve(cursors.size());
         for (auto &en : cursors) {
             ordered_cursors.push_back(&en);
@@ -168,7 +172,10 @@ struct wand_query {
     std::vector<std::pair<float, uint64_t>> const &topk() const { return m_topk.topk(); }
 
    private:
-    topk_queue      &m_topk;
+    Topk            &m_topk;
+    query_context   *m_context;
 };
 
+using wand_query = basic_wand_query<>;
+
 } // namespace pisa
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <numeric>
+#include <vector>
+
+namespace pisa {
+
+/// Threshold shared by the variations of a multi-query that are processed concurrently and
+/// then fused with CombSUM into a top-z list.
+///
+/// Variations publish a lower bound `L` on the z-th fused score: once a variation with k >= z
+/// has k results, every one of them has a fused score at least its k-th score. A document
+/// with score `s` in variation `v` has a fused score of at most `s + sum_{u != v} UB_u`, where
+/// `UB_u` bounds any score of variation `u`, so it cannot enter the fused top-z unless
+/// `s > L - sum_{u != v} UB_u`, which is the threshold returned for `v`.
+///
+/// Both bounds only hold if term scores are non-negative: a variation that does not match a
+/// document then adds 0 to its fused score, at most `UB_u`, and never lowers it.
+class fused_threshold {
+   public:
+    explicit fused_threshold(std::vector<float> upper_bounds)
+        : m_upper_bounds(std::move(upper_bounds)),
+          m_upper_bound_sum(std::accumulate(m_upper_bounds.begin(), m_upper_bounds.end(), 0.0F))
+    {}
+
+    /// Raises the shared lower bound on the fused k-th score to `score`, if higher.
+    void publish(float score)
+    {
+        float current = m_lower_bound.load(std::memory_order_relaxed);
+        while (score > current
+               && !m_lower_bound.compare_exchange_weak(current, score, std::memory_order_relaxed)) {
+        }
+    }
+
+    [[nodiscard]] auto lower_bound() const -> float
+    {
+        return m_lower_bound.load(std::memory_order_relaxed);
+    }
+
+    /// Returns the score a document must exceed in `variation` to possibly enter the fused list.
+    [[nodiscard]] auto threshold(std::size_t variation) const -> float
+    {
+        return lower_bound() - (m_upper_bound_sum - m_upper_bounds[variation]);
+    }
+
+   private:
+    std::atomic<float> m_lower_bound{0.0F};
+    std::vector<float> m_upper_bounds;
+    float m_upper_bound_sum;
+};
+
+/// Upper bound on the score of any document for a variation, given its distinct terms with
+/// their weights as returned by `query_term_weights`. Only an upper bound if the scorer never
+/// returns negative scores.
+template <typename WandType, typename TermWeights>
+[[nodiscard]] auto variation_upper_bound(WandType const &wdata, TermWeights const &term_weights)
+    -> float
+{
+    float upper_bound = 0.0F;
+    for (auto const &[term, weight] : term_weights) {
+        upper_bound += weight * wdata.max_term_weight(term);
+    }
+    return upper_bound;
+}
+
+} // namespace pisa
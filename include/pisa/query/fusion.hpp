@@ -0,0 +1,205 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "accumulator/fusion_accumulator.hpp"
+#include "buffered_topk_queue.hpp"
+#include "spdlog/spdlog.h"
+#include "topk_queue.hpp"
+
+namespace pisa {
+
+/// Methods for fusing the ranked lists of the variations of a multi-query.
+///
+///  - `combsum`: sum of the scores of a document.
+///  - `combmnz`: CombSUM multiplied by the number of lists containing the document.
+///  - `rrf`: reciprocal rank fusion, sum of `1 / (rrf_k + rank)` with 1-based ranks.
+///  - `borda`: a document at 0-based rank `r` of a list of length `n` gets `n - r` points.
+enum class fusion_method { combsum, combmnz, rrf, borda };
+
+[[nodiscard]] inline auto try_fusion_method_from_name(std::string const &name)
+    -> std::optional<fusion_method>
+{
+    if (name == "combsum") {
+        return fusion_method::combsum;
+    } else if (name == "combmnz") {
+        return fusion_method::combmnz;
+    } else if (name == "rrf") {
+        return fusion_method::rrf;
+    } else if (name == "borda") {
+        return fusion_method::borda;
+    }
+    return std::nullopt;
+}
+
+[[nodiscard]] inline auto fusion_method_from_name(std::string const &name) -> fusion_method
+{
+    if (auto method = try_fusion_method_from_name(name); method) {
+        return *method;
+    }
+    spdlog::error("Unknown fusion method {}", name);
+    std::abort();
+}
+
+/// How `result_fusion` gathers the contributions of a document.
+///
+///  - `accumulator`: sums them in a `fusion_accumulator`, then walks it into the top-k.
+///  - `heap_merge`: sorts each list by document and merges the lists with a k-way heap, so a
+///    document is complete, and goes into the top-k, as soon as the merge moves past it.
+///
+/// Both give the same fused scores, though documents tied at the k-th score may be kept in a
+/// different order. The accumulator is faster on the usual inputs; the merge needs no table.
+enum class fusion_strategy { accumulator, heap_merge };
+
+[[nodiscard]] inline auto fusion_strategy_from_name(std::string const &name) -> fusion_strategy
+{
+    if (name == "accumulator") {
+        return fusion_strategy::accumulator;
+    } else if (name == "heap_merge") {
+        return fusion_strategy::heap_merge;
+    }
+    spdlog::error("Unknown fusion strategy {}", name);
+    std::abort();
+}
+
+/// Fuses per-variation result lists, as returned by `topk_queue::topk()`, into a single top-k.
+///
+/// Contributions are gathered according to the `fusion_strategy` and the completed documents
+/// are inserted directly into the fused top-k, a `buffered_topk_queue` since every one of them
+/// is a candidate. Buffers are kept between calls to avoid reallocating for every topic.
+class result_fusion {
+   public:
+    using entry_type = topk_queue::entry_type;
+    using result_list = std::vector<entry_type>;
+
+    result_fusion(fusion_method method,
+                  uint64_t k,
+                  float rrf_k = 60.0F,
+                  fusion_strategy strategy = fusion_strategy::accumulator)
+        : m_method(method), m_strategy(strategy), m_topk(k), m_rrf_k(rrf_k)
+    {}
+
+    result_fusion(fusion_method method, uint64_t k, fusion_strategy strategy)
+        : result_fusion(method, k, 60.0F, strategy)
+    {}
+
+    [[nodiscard]] auto method() const -> fusion_method { return m_method; }
+    [[nodiscard]] auto strategy() const -> fusion_strategy { return m_strategy; }
+    [[nodiscard]] auto k() const -> uint64_t { return m_topk.size(); }
+
+    /// Returns the fused top-k, sorted by decreasing score. The result is only valid until the
+    /// next call.
+    template <typename ResultLists>
+    auto operator()(ResultLists const &lists) -> result_list const &
+    {
+        m_topk.clear();
+        if (m_strategy == fusion_strategy::heap_merge) {
+            merge(lists);
+        } else {
+            accumulate(lists);
+        }
+        m_topk.finalize();
+        return m_topk.topk();
+    }
+
+   private:
+    struct posting {
+        uint64_t docid;
+        float score;
+    };
+
+    template <typename ResultLists>
+    void accumulate(ResultLists const &lists)
+    {
+        std::size_t entries = 0;
+        for (auto const &list : lists) {
+            entries += list.size();
+        }
+        m_accumulator.reset(entries);
+        for (auto const &list : lists) {
+            auto depth = list.size();
+            for (size_t rank = 0; rank < depth; ++rank) {
+                m_accumulator.accumulate(list[rank].second,
+                                         contribution(list[rank].first, rank, depth));
+            }
+        }
+        m_accumulator.aggregate(m_topk, m_method == fusion_method::combmnz);
+    }
+
+    template <typename ResultLists>
+    void merge(ResultLists const &lists)
+    {
+        m_postings.clear();
+        m_offsets.assign(1, 0);
+        for (auto const &list : lists) {
+            auto depth = list.size();
+            for (size_t rank = 0; rank < depth; ++rank) {
+                m_postings.push_back(
+                    {list[rank].second, contribution(list[rank].first, rank, depth)});
+            }
+            std::sort(m_postings.begin() + m_offsets.back(),
+                      m_postings.end(),
+                      [](auto const &lhs, auto const &rhs) { return lhs.docid < rhs.docid; });
+            m_offsets.push_back(m_postings.size());
+        }
+
+        // Min-heap of (current document, list) over the non-exhausted lists.
+        m_heads.clear();
+        m_positions.assign(m_offsets.begin(), std::prev(m_offsets.end()));
+        for (size_t list = 0; list + 1 < m_offsets.size(); ++list) {
+            if (m_offsets[list] < m_offsets[list + 1]) {
+                m_heads.emplace_back(m_postings[m_offsets[list]].docid, list);
+            }
+        }
+        auto order = [](auto const &lhs, auto const &rhs) { return lhs > rhs; };
+        std::make_heap(m_heads.begin(), m_heads.end(), order);
+
+        while (not m_heads.empty()) {
+            auto docid = m_heads.front().first;
+            float score = 0;
+            size_t matches = 0;
+            while (not m_heads.empty() && m_heads.front().first == docid) {
+                std::pop_heap(m_heads.begin(), m_heads.end(), order);
+                auto list = m_heads.back().second;
+                score += m_postings[m_positions[list]].score;
+                ++matches;
+                if (++m_positions[list] < m_offsets[list + 1]) {
+                    m_heads.back().first = m_postings[m_positions[list]].docid;
+                    std::push_heap(m_heads.begin(), m_heads.end(), order);
+                } else {
+                    m_heads.pop_back();
+                }
+            }
+            if (m_method == fusion_method::combmnz) {
+                score *= matches;
+            }
+            m_topk.insert(score, docid);
+        }
+    }
+
+    [[nodiscard]] auto contribution(float score, size_t rank, size_t depth) const -> float
+    {
+        switch (m_method) {
+        case fusion_method::rrf: return 1.0F / (m_rrf_k + rank + 1);
+        case fusion_method::borda: return static_cast<float>(depth - rank);
+        default: return score;
+        }
+    }
+
+    fusion_method m_method;
+    fusion_strategy m_strategy;
+    buffered_topk_queue m_topk;
+    float m_rrf_k;
+    fusion_accumulator m_accumulator;
+    std::vector<posting> m_postings;
+    std::vector<size_t> m_offsets;
+    std::vector<size_t> m_positions;
+    std::vector<std::pair<uint64_t, size_t>> m_heads;
+};
+
+} // namespace pisa
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "query/fusion.hpp"
+#include "topk_queue.hpp"
+
+namespace pisa {
+
+/// Ways of estimating the threshold of a single-pass CombSUM (SP-CS) multi-query, i.e. the
+/// k-th score of the weighted union of its variations.
+///
+///  - `exact`: the k-th score itself, from processing the SP-CS query.
+///  - `term`: the highest k-th score of a single weighted term of the SP-CS query.
+///  - `variations`: the k-th fused score of the per-variation top-k lists.
+///
+/// `term` and `variations` are lower bounds only if no term score is negative, see
+/// `has_non_negative_scores`. All of them may equal the k-th score, so that a top-k queue,
+/// which only takes scores above its threshold, must be primed with a lower value, as
+/// `read_thresholds` does.
+enum class threshold_estimator { exact, term, variations };
+
+[[nodiscard]] inline auto threshold_estimator_from_name(std::string const &name)
+    -> threshold_estimator
+{
+    if (name == "exact") {
+        return threshold_estimator::exact;
+    } else if (name == "term") {
+        return threshold_estimator::term;
+    } else if (name == "variations") {
+        return threshold_estimator::variations;
+    } else {
+        spdlog::error("Unknown threshold estimator {}", name);
+        std::abort();
+    }
+}
+
+/// Lower bound on the k-th SP-CS score from the per-variation top-k lists, for scorers without
+/// negative scores.
+///
+/// The SP-CS score of a document is the sum of its scores in every variation, so the sum over
+/// only the lists in which it was retrieved never exceeds it.
+template <typename ResultLists>
+[[nodiscard]] auto fused_lower_bound(ResultLists const &lists, uint64_t k) -> float
+{
+    result_fusion fusion(fusion_method::combsum, k);
+    auto const &fused = fusion(lists);
+    return fused.size() == k ? fused.back().first : 0.0F;
+}
+
+/// Highest k-th score of a single term, weighted by `q_weight`, for scorers without negative
+/// scores.
+///
+/// As other term scores are non-negative, the k documents with the highest score for any term
+/// score at least as much for the whole query. Posting lists are scanned in full, with the
+/// running estimate as threshold so that only documents above it are inserted.
+template <typename CursorRange>
+[[nodiscard]] auto kth_term_threshold(CursorRange &&cursors, uint64_t k, uint64_t max_docid)
+    -> float
+{
+    float threshold = 0.0F;
+    for (auto &cursor : cursors) {
+        topk_queue topk(k);
+        topk.set_threshold(threshold);
+        while (cursor.docs_enum.docid() < max_docid) {
+            topk.insert(cursor.q_weight
+                            * cursor.scorer(cursor.docs_enum.docid(), cursor.docs_enum.freq()),
+                        cursor.docs_enum.docid());
+            cursor.docs_enum.next();
+        }
+        topk.finalize();
+        if (topk.topk().size() == k) {
+            threshold = std::max(threshold, topk.topk().back().first);
+        }
+    }
+    return threshold;
+}
+
+/// Reads the thresholds of `num_queries` queries, one per line, to prime their top-k queues.
+///
+/// A threshold may be the k-th score itself, which `topk_queue` would reject along with the
+/// k-th document, so that positive thresholds are lowered to the next float towards zero.
+///
+/// Throws `std::invalid_argument` if the file does not hold exactly `num_queries` thresholds.
+[[nodiscard]] inline auto read_thresholds(std::string const &filename, std::size_t num_queries)
+    -> std::vector<Threshold>
+{
+    std::ifstream tin(filename);
+    std::vector<Threshold> thresholds(std::istream_iterator<Threshold>(tin),
+                                      std::istream_iterator<Threshold>{});
+    if (thresholds.size() != num_queries) {
+        throw std::invalid_argument(fmt::format(
+            "Thresholds file {} has {} thresholds for {} queries",
+            filename,
+            thresholds.size(),
+            num_queries));
+    }
+    for (auto &threshold : thresholds) {
+        if (threshold > 0.0F) {
+            threshold = std::nextafter(threshold, 0.0F);
+        }
+    }
+    return thresholds;
+}
+
+/// Counts, as queries run, how often a primed threshold was too high and left fewer than k
+/// results. Safe to use from several threads.
+class short_topk_counter {
+   public:
+    explicit short_topk_counter(uint64_t k) : m_k(k) {}
+
+    void record(Threshold threshold, uint64_t results)
+    {
+        if (threshold > 0.0F) {
+            m_primed.fetch_add(1, std::memory_order_relaxed);
+            if (results < m_k) {
+                m_short.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void log() const
+    {
+        spdlog::info("Primed {} query runs, {} left with fewer than {} results",
+                     m_primed.load(),
+                     m_short.load(),
+                     m_k);
+    }
+
+   private:
+    uint64_t m_k;
+    std::atomic<std::size_t> m_primed{0};
+    std::atomic<std::size_t> m_short{0};
+};
+
+} // namespace pisa
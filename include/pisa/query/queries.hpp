@@ -1,5 +1,9 @@
 #pragma once
 
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
 #include <iostream>
 #include <memory>
 #include <optional>
@@ -45,47 +49,119 @@ struct Query {
     return {std::move(id), std::move(raw_query)};
 }
 
-[[nodiscard]] auto parse_query_terms(std::string const &query_string, TermProcessor term_processor)
+// A term may carry a weight as `term:weight`; returns the term and the weight, if any. Only a
+// finite, positive weight is split off: otherwise, the token is returned whole.
+[[nodiscard]] auto split_term_weight(std::string_view token)
+    -> std::pair<std::string_view, std::optional<float>>
+{
+    auto colon = token.rfind(':');
+    if (colon == std::string_view::npos || colon + 1 == token.size()) {
+        return {token, std::nullopt};
+    }
+    std::string weight(token.substr(colon + 1));
+    char *end = nullptr;
+    float value = std::strtof(weight.c_str(), &end);
+    if (end != weight.c_str() + weight.size() || not std::isfinite(value) || value <= 0.0F) {
+        return {token, std::nullopt};
+    }
+    return {token.substr(0, colon), value};
+}
+
+// Splits a query on whitespace, keeping only non-empty tokens.
+[[nodiscard]] auto split_query_tokens(std::string_view raw_query) -> std::vector<std::string>
+{
+    std::vector<std::string> tokens;
+    boost::split(tokens, raw_query, boost::is_any_of("\t, ,\v,\f,\r,\n"));
+    auto is_empty = [](const std::string &val) { return val.empty(); };
+    // remove_if move matching elements to the end, preparing them for erase.
+    tokens.erase(std::remove_if(tokens.begin(), tokens.end(), is_empty), tokens.end());
+    return tokens;
+}
+
+// Weights are only kept if at least one term has an explicit weight; others default to 1.
+void assign_term_weights(Query &query, std::vector<std::optional<float>> const &weights)
+{
+    if (std::none_of(weights.begin(), weights.end(), [](auto const &w) { return w.has_value(); })) {
+        return;
+    }
+    query.term_weights.clear();
+    for (auto const &weight : weights) {
+        query.term_weights.push_back(weight.value_or(1.0F));
+    }
+}
+
+// Parses the terms of a query line without its identifier.
+[[nodiscard]] auto parse_raw_query_terms(std::string_view raw_query, TermProcessor &term_processor)
     -> Query
 {
-    auto [id, raw_query] = split_query_at_colon(query_string);
-    TermTokenizer tokenizer(raw_query);
     std::vector<term_id_type> parsed_query;
-    for (auto term_iter = tokenizer.begin(); term_iter != tokenizer.end(); ++term_iter) {
-        auto raw_term = *term_iter;
-        auto term = term_processor(raw_term);
-        if (term) {
-            if (!term_processor.is_stopword(*term)) {
-                parsed_query.push_back(std::move(*term));
+    std::vector<std::optional<float>> weights;
+    for (auto const &token : split_query_tokens(raw_query)) {
+        auto [raw_terms, weight] = split_term_weight(token);
+        // numbers such as times or ratios (`12:30`) are terms, not weighted terms
+        if (weight && std::all_of(raw_terms.begin(), raw_terms.end(), [](char c) {
+                return std::isdigit(static_cast<unsigned char>(c));
+            })) {
+            raw_terms = token;
+            weight = std::nullopt;
+        }
+        TermTokenizer tokenizer(raw_terms);
+        for (auto term_iter = tokenizer.begin(); term_iter != tokenizer.end(); ++term_iter) {
+            auto raw_term = *term_iter;
+            auto term = term_processor(raw_term);
+            if (term) {
+                if (!term_processor.is_stopword(*term)) {
+                    parsed_query.push_back(std::move(*term));
+                    weights.push_back(weight);
+                } else {
+                    spdlog::warn("Term `{}` is a stopword and will be ignored", raw_term);
+                }
             } else {
-                spdlog::warn("Term `{}` is a stopword and will be ignored", raw_term);
+                spdlog::warn("Term `{}` not found and will be ignored", raw_term);
             }
-        } else {
-            spdlog::warn("Term `{}` not found and will be ignored", raw_term);
         }
     }
-    return {std::move(id), std::move(parsed_query), {}};
+    Query query{std::nullopt, std::move(parsed_query), {}};
+    assign_term_weights(query, weights);
+    return query;
 }
 
-[[nodiscard]] auto parse_query_ids(std::string const &query_string) -> Query
+[[nodiscard]] auto parse_query_terms(std::string const &query_string, TermProcessor term_processor)
+    -> Query
 {
     auto [id, raw_query] = split_query_at_colon(query_string);
-    std::vector<term_id_type> parsed_query;
-    std::vector<std::string> term_ids;
-    boost::split(term_ids, raw_query, boost::is_any_of("\t, ,\v,\f,\r,\n"));
+    auto query = parse_raw_query_terms(raw_query, term_processor);
+    query.id = std::move(id);
+    return query;
+}
 
-    auto is_empty = [](const std::string &val) { return val.empty(); };
-    // remove_if move matching elements to the end, preparing them for erase.
-    term_ids.erase(std::remove_if(term_ids.begin(), term_ids.end(), is_empty), term_ids.end());
+// Parses the term ids of a query line without its identifier; throws `std::invalid_argument`
+// if one of them is not a number.
+[[nodiscard]] auto parse_raw_query_ids(std::string_view raw_query) -> Query
+{
+    std::vector<term_id_type> parsed_query;
+    std::vector<std::optional<float>> weights;
+    for (auto const &token : split_query_tokens(raw_query)) {
+        auto [term_id, weight] = split_term_weight(token);
+        parsed_query.push_back(std::stoi(std::string(term_id)));
+        weights.push_back(weight);
+    }
+    Query query{std::nullopt, std::move(parsed_query), {}};
+    assign_term_weights(query, weights);
+    return query;
+}
 
+[[nodiscard]] auto parse_query_ids(std::string const &query_string) -> Query
+{
+    auto [id, raw_query] = split_query_at_colon(query_string);
     try {
-        auto to_int = [](const std::string &val) { return std::stoi(val); };
-        std::transform(term_ids.begin(), term_ids.end(), std::back_inserter(parsed_query), to_int);
+        auto query = parse_raw_query_ids(raw_query);
+        query.id = std::move(id);
+        return query;
     } catch (std::invalid_argument &err) {
         spdlog::error("Could not parse term identifiers of query `{}`", raw_query);
         exit(1);
     }
-    return {std::move(id), std::move(parsed_query), {}};
 }
 
 [[nodiscard]] std::function<void(const std::string)> resolve_query_parser(
@@ -142,6 +218,58 @@ term_freq_vec query_freqs(term_id_vec terms)
     return query_term_freqs;
 }
 
+// Distinct terms of a query in increasing order, each with the sum of its weights. Terms of a
+// query without weights count once per occurrence, as in `query_freqs`.
+//
+// Writes them to `term_weights`, whose storage is reused.
+void query_term_weights(Query const &query,
+                        std::vector<std::pair<term_id_type, float>> &term_weights)
+{
+    term_weights.clear();
+    for (size_t i = 0; i < query.terms.size(); ++i) {
+        term_weights.emplace_back(
+            query.terms[i], i < query.term_weights.size() ? query.term_weights[i] : 1.0F);
+    }
+    std::sort(term_weights.begin(), term_weights.end(), [](auto const &lhs, auto const &rhs) {
+        return lhs.first < rhs.first;
+    });
+    size_t distinct = 0;
+    for (size_t i = 0; i < term_weights.size(); ++i) {
+        if (distinct == 0 || term_weights[distinct - 1].first != term_weights[i].first) {
+            term_weights[distinct++] = term_weights[i];
+        } else {
+            term_weights[distinct - 1].second += term_weights[i].second;
+        }
+    }
+    term_weights.resize(distinct);
+}
+
+[[nodiscard]] auto query_term_weights(Query const &query)
+    -> std::vector<std::pair<term_id_type, float>>
+{
+    std::vector<std::pair<term_id_type, float>> term_weights;
+    term_weights.reserve(query.terms.size());
+    query_term_weights(query, term_weights);
+    return term_weights;
+}
+
+// Removes duplicate terms of a query. The weights of a repeated term are summed, as in
+// `query_term_weights`; a query without weights keeps each term once.
+void remove_duplicate_terms(Query &query)
+{
+    if (query.term_weights.empty()) {
+        remove_duplicate_terms(query.terms);
+        return;
+    }
+    auto term_weights = query_term_weights(query);
+    query.terms.clear();
+    query.term_weights.clear();
+    for (auto const &[term, weight] : term_weights) {
+        query.terms.push_back(term);
+        query.term_weights.push_back(weight);
+    }
+}
+
 using multi_query = std::vector<Query>;
 // Consume a vector of queries, and convert to multi-queries
 std::vector<multi_query> generate_multi_queries (std::vector<Query> queries)
@@ -155,7 +283,7 @@ std::vector<multi_query> generate_multi_queries (std::vector<Query> queries)
             spdlog::error("Error: Multi Queries must have IDs");
             exit(1);
         }
-        remove_duplicate_terms(q.terms); // Ensure queries are unique terms only
+        remove_duplicate_terms(q); // Ensure queries are unique terms only
         mapped_queries[id].push_back(q);
     }
 
@@ -183,8 +311,11 @@ std::vector<Query> multi_query_to_spcs (std::vector<multi_query> queries)
                 exit(1);
             }
             q_map[id].id = id;
-            for (const auto & term : query.terms) {
-                q_map[id].terms.push_back(term);
+            // Weights of a term are summed over variations by the cursors
+            for (size_t i = 0; i < query.terms.size(); ++i) {
+                q_map[id].terms.push_back(query.terms[i]);
+                q_map[id].term_weights.push_back(
+                    i < query.term_weights.size() ? query.term_weights[i] : 1.0F);
             }
         }
     }
@@ -197,17 +328,75 @@ std::vector<Query> multi_query_to_spcs (std::vector<multi_query> queries)
     return spcs_queries;
 }
 
+// The SP-CS query of a single multi-query, with the terms of all its variations.
+Query fuse_variations(multi_query const &variations)
+{
+    Query fused;
+    if (not variations.empty()) {
+        fused.id = variations.front().id;
+    }
+    for (auto const &query : variations) {
+        for (size_t i = 0; i < query.terms.size(); ++i) {
+            fused.terms.push_back(query.terms[i]);
+            fused.term_weights.push_back(
+                i < query.term_weights.size() ? query.term_weights[i] : 1.0F);
+        }
+    }
+    return fused;
+}
+
+// A multi-query expressed over its distinct terms: `terms` is sorted and holds every term
+// once, and each variation lists the positions of its terms in `terms` with their weights.
+// Cursors built from `as_query()` are in the same order as `terms`.
+struct shared_multi_query {
+    std::optional<std::string> id;
+    std::vector<term_id_type> terms;
+    std::vector<std::vector<std::pair<uint32_t, float>>> variations;
+
+    [[nodiscard]] Query as_query() const { return {id, terms, {}}; }
+};
+
+shared_multi_query multi_query_to_shared(multi_query const &variations)
+{
+    shared_multi_query shared;
+    if (not variations.empty()) {
+        shared.id = variations.front().id;
+    }
+    for (auto const &variation : variations) {
+        shared.terms.insert(shared.terms.end(), variation.terms.begin(), variation.terms.end());
+    }
+    remove_duplicate_terms(shared.terms);
+
+    shared.variations.reserve(variations.size());
+    for (auto const &variation : variations) {
+        std::vector<std::pair<uint32_t, float>> positions;
+        for (auto const &[term, weight] : query_term_weights(variation)) {
+            auto pos = std::lower_bound(shared.terms.begin(), shared.terms.end(), term)
+                       - shared.terms.begin();
+            positions.emplace_back(pos, weight);
+        }
+        shared.variations.push_back(std::move(positions));
+    }
+    return shared;
+}
+
 } // namespace pisa
 
 #include "algorithm/and_query.hpp"
 #include "algorithm/block_max_maxscore_query.hpp"
 #include "algorithm/block_max_ranked_and_query.hpp"
 #include "algorithm/block_max_wand_query.hpp"
+#include "algorithm/conjunctive_first_query.hpp"
+#include "algorithm/interleaved_query.hpp"
 #include "algorithm/maxscore_query.hpp"
 #include "algorithm/or_query.hpp"
+#include "algorithm/parallel_range_query.hpp"
 #include "algorithm/range_query.hpp"
 #include "algorithm/range_taat_query.hpp"
 #include "algorithm/ranked_and_query.hpp"
 #include "algorithm/ranked_or_query.hpp"
 #include "algorithm/ranked_or_taat_query.hpp"
+#include "algorithm/saat_query.hpp"
+#include "algorithm/shared_maxscore_query.hpp"
+#include "algorithm/shared_threshold_query.hpp"
 #include "algorithm/wand_query.hpp"
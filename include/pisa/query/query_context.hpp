@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "topk_queue.hpp"
+
+namespace pisa {
+
+/// Storage reused by the consecutive queries of one thread: the top-k queue, and vectors for
+/// cursors, term weights and the scratch space of query operators. Storage is reset when it is
+/// handed out, so that once it has grown to fit the largest query, processing a query does not
+/// allocate.
+///
+/// Copies start empty, so that every copy of a query function, e.g., one per thread, owns its
+/// storage. A context must not be used by two threads at once.
+class query_context {
+   public:
+    query_context() = default;
+    query_context(query_context const &) : query_context() {}
+    query_context(query_context &&) noexcept = default;
+    query_context &operator=(query_context const &) { return *this; }
+    query_context &operator=(query_context &&) noexcept = default;
+    ~query_context() = default;
+
+    /// Returns the top-k queue, emptied and set to keep the top `k`.
+    [[nodiscard]] auto topk(uint64_t k) -> topk_queue &
+    {
+        m_topk.reset(k);
+        return m_topk;
+    }
+
+    /// Returns an empty vector of `T`. There is one vector per type and `slot`: requesting it
+    /// again empties it, so code holding on to a vector, e.g., cursors being processed, and
+    /// code needing another vector of the same type must use different slots.
+    template <typename T>
+    [[nodiscard]] auto buffer(std::size_t slot = 0) -> std::vector<T> &
+    {
+        auto type = buffer_type<T>();
+        if (type >= m_buffers.size()) {
+            m_buffers.resize(type + 1);
+        }
+        if (m_buffers[type] == nullptr) {
+            m_buffers[type] = std::make_unique<typed_buffers<T>>();
+        }
+        auto &slots = static_cast<typed_buffers<T> &>(*m_buffers[type]).slots;
+        if (slot >= slots.size()) {
+            slots.resize(slot + 1);
+        }
+        slots[slot].clear();
+        return slots[slot];
+    }
+
+   private:
+    struct buffers {
+        virtual ~buffers() = default;
+    };
+
+    /// A deque, so that adding a slot leaves the vectors of the others in place.
+    template <typename T>
+    struct typed_buffers : buffers {
+        std::deque<std::vector<T>> slots;
+    };
+
+    /// Dense ids of the types requested from any context, indexing `m_buffers`.
+    template <typename T>
+    [[nodiscard]] static auto buffer_type() -> std::size_t
+    {
+        static std::size_t const type = next_buffer_type().fetch_add(1);
+        return type;
+    }
+
+    [[nodiscard]] static auto next_buffer_type() -> std::atomic<std::size_t> &
+    {
+        static std::atomic<std::size_t> next{0};
+        return next;
+    }
+
+    topk_queue m_topk{0};
+    std::vector<std::unique_ptr<buffers>> m_buffers;
+};
+
+/// Returns the context of the calling thread, for query functions shared by the threads of a
+/// `work_stealing_executor`. Tasks running on one thread do not overlap, unless a task waits on
+/// nested tasks, which must then not use the context.
+[[nodiscard]] inline auto thread_query_context() -> query_context &
+{
+    thread_local query_context context;
+    return context;
+}
+
+/// Returns `context->buffer<T>(slot)`, or `fallback` emptied without a context, for operators
+/// that may run with or without one.
+template <typename T>
+[[nodiscard]] auto scratch_buffer(query_context *context,
+                                  std::vector<T> &fallback,
+                                  std::size_t slot = 0) -> std::vector<T> &
+{
+    if (context == nullptr) {
+        fallback.clear();
+        return fallback;
+    }
+    return context->buffer<T>(slot);
+}
+
+} // namespace pisa
@@ -0,0 +1,419 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "boost/algorithm/string/classification.hpp"
+#include "boost/algorithm/string/split.hpp"
+#include "boost/preprocessor/seq/enum.hpp"
+#include "boost/preprocessor/seq/for_each.hpp"
+#include "boost/preprocessor/seq/size.hpp"
+#include "boost/preprocessor/stringize.hpp"
+
+#include "query/queries.hpp"
+
+// Ways of processing a multi-query with CombSUM fusion:
+//  - `spcs_maxscore`, `spcs_block_max_wand`: single pass over the fused (SP-CS) query.
+//  - `parallel_maxscore`: one MaxScore query per variation on the executor, then fused.
+//  - `taat`: term-at-a-time over the fused query.
+#define PISA_QUERY_PLANS (spcs_maxscore)(spcs_block_max_wand)(parallel_maxscore)(taat)
+
+// Features of a multi-query that the cost of every plan is predicted from. Postings are
+// counted over the distinct terms (`postings`) and once per variation containing a term
+// (`variation_postings`); `overlap` is the mean number of variations sharing a term.
+#define PISA_PLAN_FEATURES                                                                     \
+    (variations)(distinct_terms)(term_occurrences)(overlap)(postings)(variation_postings)(     \
+        max_postings)(k)
+
+namespace pisa {
+
+constexpr size_t num_query_plans = BOOST_PP_SEQ_SIZE(PISA_QUERY_PLANS);
+constexpr size_t num_plan_features = BOOST_PP_SEQ_SIZE(PISA_PLAN_FEATURES);
+
+enum class query_plan { BOOST_PP_SEQ_ENUM(PISA_QUERY_PLANS) };
+enum class plan_feature { BOOST_PP_SEQ_ENUM(PISA_PLAN_FEATURES) };
+
+[[nodiscard]] inline auto query_plan_name(query_plan plan) -> std::string
+{
+    switch (plan) {
+#define LOOP_BODY(R, DATA, T) \
+    case query_plan::T:       \
+        return BOOST_PP_STRINGIZE(T);
+        /**/
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_QUERY_PLANS);
+#undef LOOP_BODY
+    }
+    throw std::invalid_argument("Invalid query plan");
+}
+
+[[nodiscard]] inline auto parse_query_plan(std::string const &name) -> query_plan
+{
+    if (false) {
+#define LOOP_BODY(R, DATA, T)                   \
+    }                                           \
+    else if (name == BOOST_PP_STRINGIZE(T)) \
+    {                                           \
+        return query_plan::T;                   \
+        /**/
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_QUERY_PLANS);
+#undef LOOP_BODY
+    }
+    throw std::invalid_argument("Invalid query plan " + name);
+}
+
+[[nodiscard]] inline auto plan_feature_name(plan_feature f) -> std::string
+{
+    switch (f) {
+#define LOOP_BODY(R, DATA, T) \
+    case plan_feature::T:     \
+        return BOOST_PP_STRINGIZE(T);
+        /**/
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_PLAN_FEATURES);
+#undef LOOP_BODY
+    }
+    throw std::invalid_argument("Invalid plan feature");
+}
+
+[[nodiscard]] inline auto parse_plan_feature(std::string const &name) -> plan_feature
+{
+    if (false) {
+#define LOOP_BODY(R, DATA, T)                   \
+    }                                           \
+    else if (name == BOOST_PP_STRINGIZE(T)) \
+    {                                           \
+        return plan_feature::T;                 \
+        /**/
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_PLAN_FEATURES);
+#undef LOOP_BODY
+    }
+    throw std::invalid_argument("Invalid plan feature " + name);
+}
+
+class plan_features {
+   public:
+    plan_features() { m_values.fill(0); }
+
+    /// Features of `m_query` retrieving `k` documents, with posting counts from `wdata`.
+    template <typename Wand>
+    [[nodiscard]] static auto from_query(multi_query const &m_query, Wand const &wdata, uint64_t k)
+        -> plan_features
+    {
+        plan_features f;
+        std::vector<term_id_type> terms;
+        double variation_postings = 0;
+        for (auto const &variation : m_query) {
+            for (auto const &term_weight : query_term_weights(variation)) {
+                terms.push_back(term_weight.first);
+                variation_postings += wdata.term_posting_count(term_weight.first);
+            }
+        }
+        f[plan_feature::term_occurrences] = terms.size();
+        std::sort(terms.begin(), terms.end());
+        terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+
+        double postings = 0;
+        double max_postings = 0;
+        for (auto term : terms) {
+            double count = wdata.term_posting_count(term);
+            postings += count;
+            max_postings = std::max(max_postings, count);
+        }
+        f[plan_feature::variations] = m_query.size();
+        f[plan_feature::distinct_terms] = terms.size();
+        f[plan_feature::overlap] =
+            terms.empty() ? 0.0 : f[plan_feature::term_occurrences] / terms.size();
+        f[plan_feature::postings] = postings;
+        f[plan_feature::variation_postings] = variation_postings;
+        f[plan_feature::max_postings] = max_postings;
+        f[plan_feature::k] = k;
+        return f;
+    }
+
+    double &operator[](plan_feature f) { return m_values[static_cast<size_t>(f)]; }
+    double const &operator[](plan_feature f) const { return m_values[static_cast<size_t>(f)]; }
+    double &operator[](size_t i) { return m_values[i]; }
+    double const &operator[](size_t i) const { return m_values[i]; }
+
+   private:
+    std::array<double, num_plan_features> m_values;
+};
+
+/// A measured run of `plan` on a query with `features`, taking `usecs`.
+struct plan_sample {
+    query_plan plan;
+    plan_features features;
+    double usecs;
+};
+
+/// Linear latency model of a single plan: `bias + sum_i weights[i] * features[i]`.
+class plan_predictor {
+   public:
+    plan_predictor() { m_weights.fill(0); }
+
+    /// Least-squares fit to `samples` of a single plan.
+    ///
+    /// Features are scaled to [-1, 1] before solving the normal equations, with a tiny ridge
+    /// so that constant or collinear features (e.g., `k` in a single calibration run) do not
+    /// make them singular.
+    [[nodiscard]] static auto fit(std::vector<plan_sample const *> const &samples)
+        -> plan_predictor
+    {
+        constexpr size_t n = num_plan_features + 1;
+        std::array<double, n> scale;
+        scale.fill(1.0);
+        for (auto const *sample : samples) {
+            for (size_t i = 0; i < num_plan_features; ++i) {
+                scale[i + 1] = std::max(scale[i + 1], std::abs(sample->features[i]));
+            }
+        }
+
+        // Augmented system [A^T A + ridge | A^T y]
+        std::array<std::array<double, n + 1>, n> system{};
+        std::array<double, n> x;
+        for (auto const *sample : samples) {
+            x[0] = 1.0;
+            for (size_t i = 0; i < num_plan_features; ++i) {
+                x[i + 1] = sample->features[i] / scale[i + 1];
+            }
+            for (size_t row = 0; row < n; ++row) {
+                for (size_t col = 0; col < n; ++col) {
+                    system[row][col] += x[row] * x[col];
+                }
+                system[row][n] += x[row] * sample->usecs;
+            }
+        }
+        double const ridge = 1e-6 * std::max<size_t>(samples.size(), 1);
+        for (size_t row = 0; row < n; ++row) {
+            system[row][row] += ridge;
+        }
+
+        // Gaussian elimination with partial pivoting.
+        for (size_t col = 0; col < n; ++col) {
+            size_t pivot = col;
+            for (size_t row = col + 1; row < n; ++row) {
+                if (std::abs(system[row][col]) > std::abs(system[pivot][col])) {
+                    pivot = row;
+                }
+            }
+            std::swap(system[col], system[pivot]);
+            for (size_t row = col + 1; row < n; ++row) {
+                double factor = system[row][col] / system[col][col];
+                for (size_t c = col; c <= n; ++c) {
+                    system[row][c] -= factor * system[col][c];
+                }
+            }
+        }
+        std::array<double, n> solution;
+        for (size_t row = n; row-- > 0;) {
+            double value = system[row][n];
+            for (size_t c = row + 1; c < n; ++c) {
+                value -= system[row][c] * solution[c];
+            }
+            solution[row] = value / system[row][row];
+        }
+
+        plan_predictor predictor;
+        predictor.m_bias = solution[0];
+        for (size_t i = 0; i < num_plan_features; ++i) {
+            predictor.m_weights[i] = solution[i + 1] / scale[i + 1];
+        }
+        return predictor;
+    }
+
+    double &bias() { return m_bias; }
+    double const &bias() const { return m_bias; }
+    double &operator[](plan_feature f) { return m_weights[static_cast<size_t>(f)]; }
+    double const &operator[](plan_feature f) const { return m_weights[static_cast<size_t>(f)]; }
+
+    double operator()(plan_features const &f) const
+    {
+        double result = m_bias;
+        for (size_t i = 0; i < num_plan_features; ++i) {
+            result += m_weights[i] * f[i];
+        }
+        return result;
+    }
+
+   private:
+    double m_bias = 0;
+    std::array<double, num_plan_features> m_weights;
+};
+
+/// Chooses the plan of a multi-query with the lowest predicted latency.
+///
+/// Only plans with a predictor take part, so a model calibrated on a subset of the plans
+/// never picks the others. The model is written as one line per plan: its name followed by
+/// tab-separated `name=weight` pairs, including `bias`.
+class query_planner {
+   public:
+    query_planner() = default;
+
+    /// Fits a predictor for every plan with samples.
+    [[nodiscard]] static auto fit(std::vector<plan_sample> const &samples) -> query_planner
+    {
+        std::array<std::vector<plan_sample const *>, num_query_plans> by_plan;
+        for (auto const &sample : samples) {
+            by_plan[static_cast<size_t>(sample.plan)].push_back(&sample);
+        }
+        query_planner planner;
+        for (size_t plan = 0; plan < num_query_plans; ++plan) {
+            if (not by_plan[plan].empty()) {
+                planner.m_predictors[plan] = plan_predictor::fit(by_plan[plan]);
+            }
+        }
+        return planner;
+    }
+
+    [[nodiscard]] auto has(query_plan plan) const -> bool
+    {
+        return m_predictors[static_cast<size_t>(plan)].has_value();
+    }
+
+    /// Whether no plan has a predictor, so that `choose` would throw.
+    [[nodiscard]] auto empty() const -> bool
+    {
+        return std::none_of(m_predictors.begin(), m_predictors.end(), [](auto const &predictor) {
+            return predictor.has_value();
+        });
+    }
+
+    /// Predicted latency in microseconds, or infinity for a plan without a predictor.
+    [[nodiscard]] auto predict(query_plan plan, plan_features const &f) const -> double
+    {
+        auto const &predictor = m_predictors[static_cast<size_t>(plan)];
+        return predictor ? (*predictor)(f) : std::numeric_limits<double>::infinity();
+    }
+
+    [[nodiscard]] auto choose(plan_features const &f) const -> query_plan
+    {
+        auto best = query_plan::spcs_maxscore;
+        double best_cost = std::numeric_limits<double>::infinity();
+        for (size_t plan = 0; plan < num_query_plans; ++plan) {
+            auto cost = predict(static_cast<query_plan>(plan), f);
+            if (cost < best_cost) {
+                best = static_cast<query_plan>(plan);
+                best_cost = cost;
+            }
+        }
+        if (std::isinf(best_cost)) {
+            throw std::logic_error("Query planner has no fitted plan");
+        }
+        return best;
+    }
+
+    void write(std::ostream &os) const
+    {
+        for (size_t plan = 0; plan < num_query_plans; ++plan) {
+            auto const &predictor = m_predictors[plan];
+            if (not predictor) {
+                continue;
+            }
+            os << query_plan_name(static_cast<query_plan>(plan)) << "\tbias=" << predictor->bias();
+            for (size_t i = 0; i < num_plan_features; ++i) {
+                auto f = static_cast<plan_feature>(i);
+                os << '\t' << plan_feature_name(f) << '=' << (*predictor)[f];
+            }
+            os << '\n';
+        }
+    }
+
+    [[nodiscard]] static auto read(std::istream &is) -> query_planner
+    {
+        query_planner planner;
+        std::string line;
+        while (std::getline(is, line)) {
+            std::istringstream iss(line);
+            std::string name;
+            if (not(iss >> name)) {
+                continue;
+            }
+            plan_predictor predictor;
+            std::string field;
+            while (iss >> field) {
+                auto eq = field.find('=');
+                if (eq == std::string::npos) {
+                    throw std::invalid_argument("Invalid model field " + field);
+                }
+                auto key = field.substr(0, eq);
+                double value = std::stod(field.substr(eq + 1));
+                if (key == "bias") {
+                    predictor.bias() = value;
+                } else {
+                    predictor[parse_plan_feature(key)] = value;
+                }
+            }
+            planner.m_predictors[static_cast<size_t>(parse_query_plan(name))] = predictor;
+        }
+        return planner;
+    }
+
+   private:
+    std::array<std::optional<plan_predictor>, num_query_plans> m_predictors;
+};
+
+/// Writes the header of a plan log: `qid`, `plan`, `predicted`, `usecs` and every feature.
+inline void write_plan_log_header(std::ostream &os)
+{
+    os << "qid\tplan\tpredicted\tusecs";
+    for (size_t i = 0; i < num_plan_features; ++i) {
+        os << '\t' << plan_feature_name(static_cast<plan_feature>(i));
+    }
+    os << '\n';
+}
+
+inline void write_plan_log_line(std::ostream &os,
+                                std::string const &qid,
+                                query_plan plan,
+                                double predicted,
+                                double usecs,
+                                plan_features const &f)
+{
+    os << qid << '\t' << query_plan_name(plan) << '\t' << predicted << '\t' << usecs;
+    for (size_t i = 0; i < num_plan_features; ++i) {
+        os << '\t' << f[i];
+    }
+    os << '\n';
+}
+
+/// Reads the samples of a plan log, matching feature columns by the names in its header.
+[[nodiscard]] inline auto read_plan_log(std::istream &is) -> std::vector<plan_sample>
+{
+    std::vector<plan_sample> samples;
+    std::string line;
+    if (not std::getline(is, line)) {
+        return samples;
+    }
+    // Split on tabs only, since a query ID may be empty or contain spaces.
+    std::vector<std::string> columns;
+    boost::split(columns, line, boost::is_any_of("\t"));
+    std::vector<std::string> fields;
+    while (std::getline(is, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        boost::split(fields, line, boost::is_any_of("\t"));
+        plan_sample sample{query_plan::spcs_maxscore, plan_features{}, 0.0};
+        for (size_t col = 0; col < std::min(columns.size(), fields.size()); ++col) {
+            auto const &column = columns[col];
+            auto const &field = fields[col];
+            if (column == "plan") {
+                sample.plan = parse_query_plan(field);
+            } else if (column == "usecs") {
+                sample.usecs = std::stod(field);
+            } else if (column != "qid" && column != "predicted") {
+                sample.features[parse_plan_feature(column)] = std::stod(field);
+            }
+        }
+        samples.push_back(sample);
+    }
+    return samples;
+}
+
+} // namespace pisa
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/functional/hash.hpp>
+
+#include "spdlog/spdlog.h"
+
+#include "query/fusion.hpp"
+#include "query/queries.hpp"
+
+namespace pisa {
+
+using cache_key = std::vector<uint64_t>;
+
+struct cache_key_hash {
+    std::size_t operator()(cache_key const &key) const
+    {
+        return boost::hash_range(key.begin(), key.end());
+    }
+};
+
+struct cache_stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    std::size_t entries = 0;
+    std::size_t bytes = 0;
+};
+
+/// Thread-safe cache of result lists, evicting the least recently used entries once their
+/// size exceeds `budget` bytes. An entry is charged for its key, its results and a fixed
+/// bookkeeping overhead.
+class lru_result_cache {
+   public:
+    using result_list = result_fusion::result_list;
+
+    static constexpr std::size_t entry_overhead = 128;
+
+    explicit lru_result_cache(std::size_t budget) : m_budget(budget) {}
+
+    [[nodiscard]] auto find(cache_key const &key) -> std::optional<result_list>
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto pos = m_entries.find(key);
+        if (pos == m_entries.end()) {
+            m_stats.misses += 1;
+            return std::nullopt;
+        }
+        m_stats.hits += 1;
+        m_recency.splice(m_recency.begin(), m_recency, pos->second);
+        return pos->second->second;
+    }
+
+    void insert(cache_key const &key, result_list results)
+    {
+        auto bytes = charge(key, results);
+        if (bytes > m_budget) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (auto pos = m_entries.find(key); pos != m_entries.end()) {
+            m_stats.bytes -= charge(key, pos->second->second);
+            m_recency.erase(pos->second);
+            m_entries.erase(pos);
+        }
+        while (m_stats.bytes + bytes > m_budget) {
+            auto &oldest = m_recency.back();
+            m_stats.bytes -= charge(oldest.first, oldest.second);
+            m_stats.evictions += 1;
+            m_entries.erase(oldest.first);
+            m_recency.pop_back();
+        }
+        m_recency.emplace_front(key, std::move(results));
+        m_entries.emplace(key, m_recency.begin());
+        m_stats.bytes += bytes;
+        m_stats.entries = m_entries.size();
+    }
+
+    [[nodiscard]] auto stats() const -> cache_stats
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto stats = m_stats;
+        stats.entries = m_entries.size();
+        return stats;
+    }
+
+   private:
+    using entry_type = std::pair<cache_key, result_list>;
+
+    [[nodiscard]] static auto charge(cache_key const &key, result_list const &results)
+        -> std::size_t
+    {
+        return entry_overhead + key.size() * sizeof(uint64_t)
+               + results.size() * sizeof(result_fusion::entry_type);
+    }
+
+    std::size_t m_budget;
+    std::list<entry_type> m_recency;
+    std::unordered_map<cache_key, std::list<entry_type>::iterator, cache_key_hash> m_entries;
+    cache_stats m_stats;
+    mutable std::mutex m_mutex;
+};
+
+/// Key of the top-`k` list of a variation: `k` followed by its distinct sorted term ids, each
+/// with the bits of its weight, which scales its scores.
+[[nodiscard]] inline auto variation_cache_key(Query const &query, uint64_t k) -> cache_key
+{
+    cache_key key{k};
+    for (auto const &[term, weight] : query_term_weights(query)) {
+        uint32_t weight_bits;
+        std::memcpy(&weight_bits, &weight, sizeof(weight));
+        key.push_back(term);
+        key.push_back(weight_bits);
+    }
+    return key;
+}
+
+/// Key of the fused list of a multi-query: the fusion parameters followed by its distinct
+/// variations in sorted order, each as its length, the number of times it occurs (its weight
+/// in the fusion) and its weighted terms.
+[[nodiscard]] inline auto fused_cache_key(multi_query const &m_query,
+                                          fusion_method method,
+                                          uint64_t k,
+                                          uint64_t fusion_k) -> cache_key
+{
+    std::vector<cache_key> variations;
+    variations.reserve(m_query.size());
+    for (auto const &query : m_query) {
+        variations.push_back(variation_cache_key(query, 0));
+    }
+    std::sort(variations.begin(), variations.end());
+    cache_key key{static_cast<uint64_t>(method), k, fusion_k};
+    for (auto begin = variations.begin(); begin != variations.end();) {
+        auto end =
+            std::find_if(begin, variations.end(), [&](auto const &v) { return v != *begin; });
+        key.push_back(begin->size() - 1);
+        key.push_back(std::distance(begin, end));
+        key.insert(key.end(), std::next(begin->begin()), begin->end());
+        begin = end;
+    }
+    return key;
+}
+
+/// Two-level cache of multi-query results: fused lists keyed on the canonical variation set,
+/// and per-variation top-k lists keyed on their weighted terms. On a fused miss, only the
+/// variations missing from the second level are evaluated before fusing.
+///
+/// Per-variation lists must be exact top-k lists, e.g., not pruned by a `fused_threshold`.
+class multi_query_cache {
+   public:
+    using result_list = result_fusion::result_list;
+
+    /// Splits `budget` bytes evenly between the two levels.
+    explicit multi_query_cache(std::size_t budget) : m_fused(budget / 2), m_variations(budget / 2)
+    {}
+
+    /// Returns the fused results of `m_query`, calling `evaluate(missing, results)` to fill
+    /// `results[i]` for the indices `i` in `missing` of the variations that are not cached.
+    template <typename Evaluate>
+    [[nodiscard]] auto operator()(multi_query const &m_query,
+                                  uint64_t k,
+                                  result_fusion &fusion,
+                                  Evaluate &&evaluate) -> result_list
+    {
+        auto fused_key = fused_cache_key(m_query, fusion.method(), k, fusion.k());
+        if (auto fused = m_fused.find(fused_key); fused) {
+            return *std::move(fused);
+        }
+        std::vector<result_list> results(m_query.size());
+        std::vector<cache_key> keys;
+        std::vector<std::size_t> missing;
+        keys.reserve(m_query.size());
+        for (std::size_t idx = 0; idx < m_query.size(); ++idx) {
+            keys.push_back(variation_cache_key(m_query[idx], k));
+            if (auto cached = m_variations.find(keys.back()); cached) {
+                results[idx] = *std::move(cached);
+            } else {
+                missing.push_back(idx);
+            }
+        }
+        if (not missing.empty()) {
+            evaluate(missing, results);
+            for (auto idx : missing) {
+                m_variations.insert(keys[idx], results[idx]);
+            }
+        }
+        auto fused = fusion(results);
+        m_fused.insert(fused_key, fused);
+        return fused;
+    }
+
+    [[nodiscard]] auto fused_stats() const -> cache_stats { return m_fused.stats(); }
+    [[nodiscard]] auto variation_stats() const -> cache_stats { return m_variations.stats(); }
+
+    void log_stats() const
+    {
+        for (auto const &[level, stats] :
+             {std::pair{"fused", fused_stats()}, std::pair{"variation", variation_stats()}}) {
+            spdlog::info("Cache ({} lists): {} hits, {} misses, {} evictions, {} entries in {} "
+                         "bytes",
+                         level,
+                         stats.hits,
+                         stats.misses,
+                         stats.evictions,
+                         stats.entries,
+                         stats.bytes);
+        }
+    }
+
+   private:
+    lru_result_cache m_fused;
+    lru_result_cache m_variations;
+};
+
+} // namespace pisa
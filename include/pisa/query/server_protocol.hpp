@@ -0,0 +1,170 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <fmt/format.h>
+
+#include "query/fusion.hpp"
+
+namespace pisa {
+
+/// Line protocol of `query_server`.
+///
+/// A request is a single line of tab-separated fields. Leading fields of the form
+/// `--key=value` are options; every following field is a variation, written as a query line
+/// without its identifier (terms, or term ids, optionally as `term:weight`), which may thus
+/// contain `=`. A request with one variation is a plain query; with more, it is a multi-query
+/// whose results are fused.
+///
+/// Options, all of which default to the values the server was started with:
+///  - `id`: query identifier used in TREC output,
+///  - `algorithm`: query processing algorithm,
+///  - `k`: number of results retrieved per variation,
+///  - `fusion`: `combsum`, `combmnz`, `rrf` or `borda`,
+///  - `z`: number of fused results,
+///  - `format`: `trec` or `binary`.
+///
+/// `k` and `z` must be positive and at most the limit of the server, since the top-k queues
+/// are allocated up front.
+///
+/// The response starts with a status line, `OK <n>` or `ERR <message>`. On success, it is
+/// followed by `n` TREC run lines or, in the binary format, by `n` records made of a 64-bit
+/// docid and a 32-bit float score, in native byte order.
+enum class result_format { trec, binary };
+
+struct server_request {
+    std::optional<std::string> id;
+    std::optional<std::string> algorithm;
+    std::optional<uint64_t> k;
+    std::optional<fusion_method> fusion;
+    std::optional<uint64_t> fusion_k;
+    result_format format = result_format::trec;
+    std::vector<std::string> variations;
+};
+
+/// Prefix of option fields.
+constexpr std::string_view option_prefix = "--";
+
+/// Default limit of `k` and `z` in requests.
+constexpr uint64_t default_max_request_k = 10'000;
+
+/// Parses a request line; throws `std::invalid_argument` if it is malformed, or if it asks for
+/// more than `max_k` results.
+[[nodiscard]] inline auto parse_server_request(std::string const &line,
+                                               uint64_t max_k = default_max_request_k)
+    -> server_request
+{
+    auto parse_count = [max_k](std::string const &key, std::string const &value) -> uint64_t {
+        std::size_t end = 0;
+        uint64_t count = 0;
+        try {
+            count = std::stoull(value, &end);
+        } catch (std::logic_error const &) {
+            end = 0;
+        }
+        if (end == 0 || end != value.size() || count == 0) {
+            throw std::invalid_argument(fmt::format("Invalid value of {}: {}", key, value));
+        }
+        if (count > max_k) {
+            throw std::invalid_argument(
+                fmt::format("Value of {} above the limit of {}: {}", key, max_k, value));
+        }
+        return count;
+    };
+
+    std::vector<std::string> fields;
+    boost::split(fields, line, boost::is_any_of("\t"));
+    server_request request;
+    auto field = fields.begin();
+    for (; field != fields.end() && field->rfind(option_prefix, 0) == 0; ++field) {
+        auto eq = field->find('=');
+        if (eq == std::string::npos) {
+            throw std::invalid_argument(fmt::format("Option without value: {}", *field));
+        }
+        auto key = field->substr(option_prefix.size(), eq - option_prefix.size());
+        auto value = field->substr(eq + 1);
+        if (key == "id") {
+            request.id = value;
+        } else if (key == "algorithm") {
+            request.algorithm = value;
+        } else if (key == "k") {
+            request.k = parse_count(key, value);
+        } else if (key == "z") {
+            request.fusion_k = parse_count(key, value);
+        } else if (key == "fusion") {
+            request.fusion = try_fusion_method_from_name(value);
+            if (not request.fusion) {
+                throw std::invalid_argument(fmt::format("Unknown fusion method {}", value));
+            }
+        } else if (key == "format") {
+            if (value == "trec") {
+                request.format = result_format::trec;
+            } else if (value == "binary") {
+                request.format = result_format::binary;
+            } else {
+                throw std::invalid_argument(fmt::format("Unknown format {}", value));
+            }
+        } else {
+            throw std::invalid_argument(fmt::format("Unknown option {}", key));
+        }
+    }
+    for (; field != fields.end(); ++field) {
+        if (field->find_first_not_of(" \r") != std::string::npos) {
+            request.variations.push_back(std::move(*field));
+        }
+    }
+    if (request.variations.empty()) {
+        throw std::invalid_argument("Request has no query");
+    }
+    return request;
+}
+
+[[nodiscard]] inline auto server_error_response(std::string const &message) -> std::string
+{
+    std::string response = fmt::format("ERR {}\n", message);
+    std::replace(response.begin(), std::prev(response.end()), '\n', ' ');
+    return response;
+}
+
+/// Formats a successful response; `docname(docid)` is only used for the TREC format.
+template <typename DocName>
+[[nodiscard]] auto server_response(std::vector<std::pair<float, uint64_t>> const &results,
+                                   result_format format,
+                                   std::string const &qid,
+                                   DocName &&docname,
+                                   std::string const &run_id) -> std::string
+{
+    std::string response = fmt::format("OK {}\n", results.size());
+    if (format == result_format::binary) {
+        for (auto const &[score, docid] : results) {
+            char record[sizeof(docid) + sizeof(score)];
+            std::memcpy(record, &docid, sizeof(docid));
+            std::memcpy(record + sizeof(docid), &score, sizeof(score));
+            response.append(record, sizeof(record));
+        }
+        return response;
+    }
+    for (std::size_t rank = 0; rank < results.size(); ++rank) {
+        response += fmt::format("{}\t{}\t{}\t{}\t{}\t{}\n",
+                                qid,
+                                "Q0",
+                                docname(results[rank].second),
+                                rank,
+                                results[rank].first,
+                                run_id);
+    }
+    return response;
+}
+
+} // namespace pisa
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+#include "topk_queue.hpp"
+#include "util/do_not_optimize_away.hpp"
+#include "util/util.hpp"
+
+namespace pisa {
+
+/// Mean and quantiles of a set of query latencies.
+struct latency_summary {
+    std::size_t count = 0;
+    double mean = 0.0;
+    double q50 = 0.0;
+    double q90 = 0.0;
+    double q95 = 0.0;
+
+    /// Summarizes `times`, which is sorted in place.
+    static auto from(std::vector<double> &times) -> latency_summary
+    {
+        latency_summary summary;
+        summary.count = times.size();
+        if (times.empty()) {
+            return summary;
+        }
+        std::sort(times.begin(), times.end());
+        summary.mean = std::accumulate(times.begin(), times.end(), double()) / times.size();
+        summary.q50 = times[times.size() / 2];
+        summary.q90 = times[90 * times.size() / 100];
+        summary.q95 = times[95 * times.size() / 100];
+        return summary;
+    }
+};
+
+struct throughput_result {
+    /// Wall time of the timed runs, in seconds.
+    double seconds = 0.0;
+    /// Latencies in microseconds, one vector per thread.
+    std::vector<std::vector<double>> thread_times;
+
+    [[nodiscard]] auto queries() const -> std::size_t
+    {
+        std::size_t count = 0;
+        for (auto const &times : thread_times) {
+            count += times.size();
+        }
+        return count;
+    }
+
+    [[nodiscard]] auto qps() const -> double
+    {
+        return seconds > 0.0 ? queries() / seconds : 0.0;
+    }
+};
+
+/// Measures sustained throughput by running `runs` passes over `num_queries` queries on
+/// `num_threads` threads, each calling `fn(i)` for the `i`-th query.
+///
+/// Every thread works on its own copy of `fn`, so any state it carries (top-k queues,
+/// accumulators) is reused across the queries of that thread but never shared. Queries are
+/// handed out dynamically from a shared counter, so threads stay busy until the batch is
+/// drained. An untimed pass over all queries, shared by the threads, warms up caches and
+/// per-thread state before the clock starts.
+template <typename Fn>
+auto measure_throughput(Fn const &fn,
+                        std::size_t num_queries,
+                        std::size_t num_threads,
+                        std::size_t runs) -> throughput_result
+{
+    num_threads = std::max<std::size_t>(num_threads, 1);
+    std::size_t total = num_queries * runs;
+    std::atomic<std::size_t> next_warmup{0};
+    std::atomic<std::size_t> next{0};
+    std::atomic<std::size_t> warmed_up{0};
+    std::atomic<bool> start{false};
+    throughput_result result;
+    result.thread_times.resize(num_threads);
+
+    auto work = [&](std::size_t thread_id) {
+        Fn local_fn = fn;
+        for (auto query = next_warmup++; query < num_queries; query = next_warmup++) {
+            do_not_optimize_away(local_fn(query));
+        }
+        warmed_up += 1;
+        while (!start.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+        auto &times = result.thread_times[thread_id];
+        times.reserve(total / num_threads + 1);
+        for (auto task = next++; task < total; task = next++) {
+            auto begin = std::chrono::steady_clock::now();
+            do_not_optimize_away(local_fn(task % num_queries));
+            auto end = std::chrono::steady_clock::now();
+            times.push_back(
+                std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count());
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (std::size_t thread_id = 0; thread_id < num_threads; ++thread_id) {
+        threads.emplace_back(work, thread_id);
+    }
+    while (warmed_up.load() < num_threads) {
+        std::this_thread::yield();
+    }
+    auto begin = std::chrono::steady_clock::now();
+    start.store(true, std::memory_order_release);
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    auto end = std::chrono::steady_clock::now();
+    result.seconds = std::chrono::duration<double>(end - begin).count();
+    return result;
+}
+
+/// Runs `query_func(query, threshold)` over `queries` with `measure_throughput`, and logs the
+/// throughput and latencies, overall and per thread, of `query_type` on `index_type`.
+template <typename Functor, typename QueryType>
+void op_throughput(Functor query_func,
+                   std::vector<QueryType> const &queries,
+                   std::vector<Threshold> const &thresholds,
+                   std::string const &index_type,
+                   std::string const &query_type,
+                   size_t runs,
+                   size_t threads)
+{
+    auto result = measure_throughput(
+        [query_func, &queries, &thresholds](size_t idx) mutable {
+            return query_func(queries[idx], thresholds[idx]);
+        },
+        queries.size(),
+        threads,
+        runs);
+
+    std::vector<double> query_times;
+    std::vector<size_t> thread_queries;
+    std::vector<double> thread_avg, thread_q50, thread_q90, thread_q95;
+    for (auto &times : result.thread_times) {
+        query_times.insert(query_times.end(), times.begin(), times.end());
+        auto summary = latency_summary::from(times);
+        thread_queries.push_back(summary.count);
+        thread_avg.push_back(summary.mean);
+        thread_q50.push_back(summary.q50);
+        thread_q90.push_back(summary.q90);
+        thread_q95.push_back(summary.q95);
+    }
+    auto summary = latency_summary::from(query_times);
+
+    spdlog::info("---- {} {}", index_type, query_type);
+    spdlog::info("Threads: {}", threads);
+    spdlog::info("Throughput: {} queries/s", result.qps());
+    spdlog::info("Mean: {}", summary.mean);
+    spdlog::info("50% quantile: {}", summary.q50);
+    spdlog::info("90% quantile: {}", summary.q90);
+    spdlog::info("95% quantile: {}", summary.q95);
+    for (size_t thread = 0; thread < threads; ++thread) {
+        spdlog::info("Thread {}: {} queries, mean {}, q50 {}, q90 {}, q95 {}",
+                     thread,
+                     thread_queries[thread],
+                     thread_avg[thread],
+                     thread_q50[thread],
+                     thread_q90[thread],
+                     thread_q95[thread]);
+    }
+
+    stats_line()("type", index_type)("query", query_type)("threads", threads)("qps", result.qps())(
+        "avg", summary.mean)("q50", summary.q50)("q90", summary.q90)("q95", summary.q95)(
+        "thread_queries", thread_queries)("thread_avg", thread_avg)("thread_q50", thread_q50)(
+        "thread_q90", thread_q90)("thread_q95", thread_q95);
+}
+
+} // namespace pisa
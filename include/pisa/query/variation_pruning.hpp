@@ -0,0 +1,233 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <mio/mmap.hpp>
+
+#include "spdlog/spdlog.h"
+
+#include "mappable/mapper.hpp"
+#include "query/fused_threshold.hpp"
+#include "query/queries.hpp"
+
+namespace pisa {
+
+/// Options of `prune_variations`.
+///
+///  - `group`: merges variations with the same weighted terms into one, whose weights are
+///    multiplied by the number of copies. Exact for CombSUM, which sums the copies' scores.
+///  - `min_contribution`: drops variations whose upper bound is below this fraction of the
+///    highest upper bound of the topic.
+///  - `max_variations`, `max_postings`: keep at most this many variations, or as many as fit
+///    in this many postings, by decreasing upper bound; 0 for no limit.
+///
+/// If scores cannot be negative (`non_negative_scores`, see `scorer::has_non_negative_scores`),
+/// variations with a zero upper bound, e.g., made only of terms missing from the collection,
+/// add nothing to any fused score and are always dropped. With signed scorers, negative
+/// contributions still change the fused order, so they are kept. The other pruning is unsafe
+/// and trades effectiveness for latency.
+struct variation_pruning {
+    bool group = false;
+    float min_contribution = 0.0F;
+    std::size_t max_variations = 0;
+    uint64_t max_postings = 0;
+    bool non_negative_scores = true;
+
+    [[nodiscard]] auto enabled() const -> bool
+    {
+        return group || min_contribution > 0.0F || max_variations > 0 || max_postings > 0;
+    }
+};
+
+/// Effect of `prune_variations` on a topic. Postings estimate the work of the variations:
+/// `postings` and `postings_saved` count the lists of every variation, as processed in
+/// parallel, and `distinct_postings_saved` the lists of terms left in no variation, as saved
+/// by SP-CS processing.
+struct variation_pruning_stats {
+    std::size_t variations = 0;
+    std::size_t grouped = 0;
+    std::size_t dropped = 0;
+    uint64_t postings = 0;
+    uint64_t postings_saved = 0;
+    uint64_t distinct_postings_saved = 0;
+
+    variation_pruning_stats &operator+=(variation_pruning_stats const &other)
+    {
+        variations += other.variations;
+        grouped += other.grouped;
+        dropped += other.dropped;
+        postings += other.postings;
+        postings_saved += other.postings_saved;
+        distinct_postings_saved += other.distinct_postings_saved;
+        return *this;
+    }
+};
+
+/// Groups and drops the variations of `m_query` as set by `options`, keeping their order. A
+/// topic left without variations gets a single one with no terms.
+template <typename Wand>
+[[nodiscard]] auto prune_variations(multi_query const &m_query,
+                                    Wand const &wdata,
+                                    variation_pruning const &options)
+    -> std::pair<multi_query, variation_pruning_stats>
+{
+    using term_weights = std::vector<std::pair<term_id_type, float>>;
+    auto postings_of = [&](term_weights const &terms) {
+        return std::accumulate(terms.begin(), terms.end(), uint64_t(0), [&](auto sum, auto term) {
+            return sum + wdata.term_posting_count(term.first);
+        });
+    };
+
+    variation_pruning_stats stats;
+    stats.variations = m_query.size();
+    std::vector<term_weights> groups;
+    std::vector<std::size_t> copies;
+    for (auto const &variation : m_query) {
+        auto terms = query_term_weights(variation);
+        stats.postings += postings_of(terms);
+        auto group = options.group ? std::find(groups.begin(), groups.end(), terms) : groups.end();
+        if (group != groups.end()) {
+            copies[std::distance(groups.begin(), group)] += 1;
+            stats.grouped += 1;
+        } else {
+            groups.push_back(std::move(terms));
+            copies.push_back(1);
+        }
+    }
+
+    std::vector<float> upper_bounds;
+    for (std::size_t idx = 0; idx < groups.size(); ++idx) {
+        for (auto &term : groups[idx]) {
+            term.second *= copies[idx];
+        }
+        upper_bounds.push_back(variation_upper_bound(wdata, groups[idx]));
+    }
+    float max_upper_bound =
+        upper_bounds.empty() ? 0.0F : *std::max_element(upper_bounds.begin(), upper_bounds.end());
+
+    std::vector<std::size_t> by_utility(groups.size());
+    std::iota(by_utility.begin(), by_utility.end(), 0);
+    std::stable_sort(by_utility.begin(), by_utility.end(), [&](auto lhs, auto rhs) {
+        return upper_bounds[lhs] > upper_bounds[rhs];
+    });
+    std::vector<bool> kept(groups.size(), false);
+    std::size_t num_kept = 0;
+    uint64_t kept_postings = 0;
+    for (auto idx : by_utility) {
+        if (options.non_negative_scores && upper_bounds[idx] <= 0.0F) {
+            break;
+        }
+        if (options.min_contribution > 0.0F
+            && upper_bounds[idx] < options.min_contribution * max_upper_bound) {
+            break;
+        }
+        auto postings = postings_of(groups[idx]);
+        if (num_kept > 0
+            && ((options.max_variations > 0 && num_kept == options.max_variations)
+                || (options.max_postings > 0 && kept_postings + postings > options.max_postings))) {
+            break;
+        }
+        kept[idx] = true;
+        num_kept += 1;
+        kept_postings += postings;
+    }
+
+    multi_query pruned;
+    std::vector<term_id_type> dropped_terms;
+    std::vector<term_id_type> kept_terms;
+    for (std::size_t idx = 0; idx < groups.size(); ++idx) {
+        auto &terms = kept[idx] ? kept_terms : dropped_terms;
+        for (auto const &term : groups[idx]) {
+            terms.push_back(term.first);
+        }
+        if (not kept[idx]) {
+            stats.dropped += 1;
+            stats.postings_saved += copies[idx] * postings_of(groups[idx]);
+            continue;
+        }
+        stats.postings_saved += (copies[idx] - 1) * postings_of(groups[idx]);
+        Query query{m_query.front().id, {}, {}};
+        for (auto const &[term, weight] : groups[idx]) {
+            query.terms.push_back(term);
+            query.term_weights.push_back(weight);
+        }
+        pruned.push_back(std::move(query));
+    }
+    if (pruned.empty() && not m_query.empty()) {
+        // Keeps the topic, with no terms, so that it still gets an empty result list.
+        pruned.push_back(Query{m_query.front().id, {}, {}});
+    }
+    remove_duplicate_terms(kept_terms);
+    remove_duplicate_terms(dropped_terms);
+    for (auto term : dropped_terms) {
+        if (not std::binary_search(kept_terms.begin(), kept_terms.end(), term)) {
+            stats.distinct_postings_saved += wdata.term_posting_count(term);
+        }
+    }
+    return {std::move(pruned), stats};
+}
+
+/// Prunes the variations of every topic, writing the effect on each to `report` as tab-separated
+/// `qid`, `variations`, `grouped`, `dropped`, `postings`, `postings_saved` and
+/// `distinct_postings_saved`, if not null.
+template <typename Wand>
+[[nodiscard]] auto prune_multi_queries(std::vector<multi_query> const &multi_queries,
+                                       Wand const &wdata,
+                                       variation_pruning const &options,
+                                       std::ostream *report) -> std::vector<multi_query>
+{
+    if (report != nullptr) {
+        *report << "qid\tvariations\tgrouped\tdropped\tpostings\tpostings_saved\t"
+                   "distinct_postings_saved\n";
+    }
+    std::vector<multi_query> pruned;
+    pruned.reserve(multi_queries.size());
+    variation_pruning_stats total;
+    for (auto const &m_query : multi_queries) {
+        auto [variations, stats] = prune_variations(m_query, wdata, options);
+        if (report != nullptr) {
+            *report << m_query.front().id.value_or("") << '\t' << stats.variations << '\t'
+                    << stats.grouped << '\t' << stats.dropped << '\t' << stats.postings << '\t'
+                    << stats.postings_saved << '\t' << stats.distinct_postings_saved << '\n';
+        }
+        total += stats;
+        pruned.push_back(std::move(variations));
+    }
+    spdlog::info("Pruned {} of {} variations ({} grouped, {} dropped), saving {} of {} postings",
+                 total.grouped + total.dropped,
+                 total.variations,
+                 total.grouped,
+                 total.dropped,
+                 total.postings_saved,
+                 total.postings);
+    return pruned;
+}
+
+/// Prunes `multi_queries` with the upper bounds of the `WandType` data in `wand_data_filename`,
+/// writing the report of `prune_multi_queries` to `report_filename`, if any.
+template <typename WandType>
+[[nodiscard]] auto prune_with_wand_data(std::string const &wand_data_filename,
+                                        std::vector<multi_query> const &multi_queries,
+                                        variation_pruning const &pruning,
+                                        std::optional<std::string> const &report_filename)
+    -> std::vector<multi_query>
+{
+    WandType wdata;
+    mio::mmap_source md(wand_data_filename.c_str());
+    mapper::map(wdata, md);
+    std::optional<std::ofstream> report;
+    if (report_filename) {
+        report.emplace(*report_filename);
+    }
+    return prune_multi_queries(multi_queries, wdata, pruning, report ? &*report : nullptr);
+}
+
+} // namespace pisa
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+#include "spdlog/spdlog.h"
+
+#include "bm25.hpp"
+#include "qld.hpp"
+
+namespace pisa {
+
+/// Term scorer that also scores whole blocks of postings at once.
+///
+/// Supports BM25 and QLD, with the same formulas as `bm25` and `qld`. Block scoring gathers
+/// the document lengths of 8 (AVX2) or 16 (AVX-512) postings at a time from the lengths
+/// stored in `wand_data`. For QLD, the two logarithms are taken per posting after the
+/// vectorized part, since there is no vector logarithm to keep scores identical to `qld`.
+/// Scores are not multiplied by the query term weight, as with `term_scorer_t`.
+class block_term_scorer {
+   public:
+    [[nodiscard]] static auto supports(std::string const &scorer_name) -> bool
+    {
+        return scorer_name == "bm25" || scorer_name == "qld";
+    }
+
+    template <typename Wand>
+    [[nodiscard]] static auto from_name(std::string const &scorer_name,
+                                        Wand const &wdata,
+                                        uint64_t term_id) -> block_term_scorer
+    {
+        block_term_scorer scorer;
+        scorer.m_doc_lens = wdata.doc_lens();
+        if (scorer_name == "bm25") {
+            scorer.m_kind = kind::bm25;
+            scorer.m_k1 = bm25<Wand>::k1;
+            scorer.m_b = bm25<Wand>::b;
+            scorer.m_avg_len = wdata.avg_len();
+            scorer.m_term_weight = bm25<Wand>::query_term_weight(
+                wdata.term_posting_count(term_id), wdata.num_docs());
+        } else if (scorer_name == "qld") {
+            scorer.m_kind = kind::qld;
+            scorer.m_mu = qld<Wand>::mu;
+            scorer.m_collection_prob =
+                (float)wdata.term_occurrence_count(term_id) / wdata.collection_len();
+        } else {
+            spdlog::error("No block scorer for {}", scorer_name);
+            std::abort();
+        }
+        return scorer;
+    }
+
+    /// Score of a single posting.
+    float operator()(uint32_t doc, uint32_t freq) const
+    {
+        float len = m_doc_lens[doc];
+        if (m_kind == kind::bm25) {
+            float f = freq;
+            return m_term_weight * (f / (f + m_k1 * (1.0F - m_b + m_b * (len / m_avg_len))));
+        }
+        return std::log(1 + freq / (m_mu * m_collection_prob)) + std::log(m_mu / (len + m_mu));
+    }
+
+    /// Writes the scores of the `n` postings `(docs[i], freqs[i])` to `scores`.
+    void operator()(uint32_t const *docs, uint32_t const *freqs, size_t n, float *scores) const
+    {
+        if (m_kind == kind::bm25) {
+            score_bm25(docs, freqs, n, scores);
+        } else {
+            score_qld(docs, freqs, n, scores);
+        }
+    }
+
+   private:
+    enum class kind { bm25, qld };
+
+    block_term_scorer() = default;
+
+    void score_bm25(uint32_t const *docs, uint32_t const *freqs, size_t n, float *scores) const
+    {
+        size_t i = 0;
+#if defined(__AVX512F__)
+        {
+            auto const lens = reinterpret_cast<int const *>(m_doc_lens);
+            auto const avg = _mm512_set1_ps(m_avg_len);
+            auto const k1 = _mm512_set1_ps(m_k1);
+            auto const b = _mm512_set1_ps(m_b);
+            auto const one_minus_b = _mm512_set1_ps(1.0F - m_b);
+            auto const weight = _mm512_set1_ps(m_term_weight);
+            for (; i + 16 <= n; i += 16) {
+                auto d = _mm512_loadu_si512(docs + i);
+                auto len = _mm512_cvtepi32_ps(_mm512_i32gather_epi32(d, lens, 4));
+                auto f = _mm512_cvtepi32_ps(_mm512_loadu_si512(freqs + i));
+                auto norm = _mm512_add_ps(one_minus_b, _mm512_mul_ps(b, _mm512_div_ps(len, avg)));
+                auto denominator = _mm512_add_ps(f, _mm512_mul_ps(k1, norm));
+                _mm512_storeu_ps(scores + i, _mm512_mul_ps(weight, _mm512_div_ps(f, denominator)));
+            }
+        }
+#endif
+#if defined(__AVX2__)
+        {
+            auto const lens = reinterpret_cast<int const *>(m_doc_lens);
+            auto const avg = _mm256_set1_ps(m_avg_len);
+            auto const k1 = _mm256_set1_ps(m_k1);
+            auto const b = _mm256_set1_ps(m_b);
+            auto const one_minus_b = _mm256_set1_ps(1.0F - m_b);
+            auto const weight = _mm256_set1_ps(m_term_weight);
+            for (; i + 8 <= n; i += 8) {
+                auto d = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(docs + i));
+                auto len = _mm256_cvtepi32_ps(_mm256_i32gather_epi32(lens, d, 4));
+                auto f = _mm256_cvtepi32_ps(
+                    _mm256_loadu_si256(reinterpret_cast<__m256i const *>(freqs + i)));
+                auto norm = _mm256_add_ps(one_minus_b, _mm256_mul_ps(b, _mm256_div_ps(len, avg)));
+                auto denominator = _mm256_add_ps(f, _mm256_mul_ps(k1, norm));
+                _mm256_storeu_ps(scores + i, _mm256_mul_ps(weight, _mm256_div_ps(f, denominator)));
+            }
+        }
+#endif
+        for (; i < n; ++i) {
+            scores[i] = operator()(docs[i], freqs[i]);
+        }
+    }
+
+    void score_qld(uint32_t const *docs, uint32_t const *freqs, size_t n, float *scores) const
+    {
+        // `scores` first holds the argument of the document length logarithm.
+        float tf_arguments[block_size];
+        float const tf_scale = m_mu * m_collection_prob;
+        for (size_t begin = 0; begin < n; begin += block_size) {
+            size_t end = std::min(n, begin + block_size);
+            size_t i = begin;
+#if defined(__AVX2__)
+            auto const lens = reinterpret_cast<int const *>(m_doc_lens);
+            auto const mu = _mm256_set1_ps(m_mu);
+            auto const scale = _mm256_set1_ps(tf_scale);
+            auto const one = _mm256_set1_ps(1.0F);
+            for (; i + 8 <= end; i += 8) {
+                auto d = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(docs + i));
+                auto len = _mm256_cvtepi32_ps(_mm256_i32gather_epi32(lens, d, 4));
+                auto f = _mm256_cvtepi32_ps(
+                    _mm256_loadu_si256(reinterpret_cast<__m256i const *>(freqs + i)));
+                _mm256_storeu_ps(tf_arguments + (i - begin),
+                                 _mm256_add_ps(one, _mm256_div_ps(f, scale)));
+                _mm256_storeu_ps(scores + i, _mm256_div_ps(mu, _mm256_add_ps(len, mu)));
+            }
+#endif
+            for (; i < end; ++i) {
+                tf_arguments[i - begin] = 1 + freqs[i] / tf_scale;
+                scores[i] = m_mu / (m_doc_lens[docs[i]] + m_mu);
+            }
+            for (i = begin; i < end; ++i) {
+                scores[i] = std::log(tf_arguments[i - begin]) + std::log(scores[i]);
+            }
+        }
+    }
+
+    static constexpr size_t block_size = 128;
+
+    kind m_kind = kind::bm25;
+    uint32_t const *m_doc_lens = nullptr;
+    float m_k1 = 0;
+    float m_b = 0;
+    float m_avg_len = 1;
+    float m_term_weight = 0;
+    float m_mu = 0;
+    float m_collection_prob = 0;
+};
+
+} // namespace pisa
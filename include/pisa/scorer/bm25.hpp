@@ -29,7 +29,7 @@ struct bm25 : public index_scorer<Wand> {
         return std::max(epsilon_score, idf) * (1.0f + k1);
     }
 
-    term_scorer_t term_scorer(uint64_t term_id) const override
+    auto static_term_scorer(uint64_t term_id) const
     {
         auto term_len = this->m_wdata.term_posting_count(term_id);
         auto term_weight = query_term_weight(term_len, this->m_wdata.num_docs());
@@ -38,5 +38,10 @@ struct bm25 : public index_scorer<Wand> {
         };
         return s;
     }
+
+    term_scorer_t term_scorer(uint64_t term_id) const override
+    {
+        return static_term_scorer(term_id);
+    }
 };
 } // namespace pisa
@@ -20,4 +20,23 @@ struct index_scorer {
     virtual term_scorer_t term_scorer(uint64_t term_id) const = 0;
 };
 
+/// Exposes the concretely typed term scorers of `Scorer`. Cursors built from it carry the
+/// scoring function itself instead of a `term_scorer_t`, so operators can inline it.
+template <typename Scorer>
+class static_scorer {
+   public:
+    template <typename Wand>
+    explicit static_scorer(Wand const &wdata) : m_scorer(wdata)
+    {}
+
+    // Term scorers refer to the scorer, which must then stay in place.
+    static_scorer(static_scorer const &) = delete;
+    static_scorer &operator=(static_scorer const &) = delete;
+
+    auto term_scorer(uint64_t term_id) const { return m_scorer.static_term_scorer(term_id); }
+
+   private:
+    Scorer m_scorer;
+};
+
 } // namespace pisa
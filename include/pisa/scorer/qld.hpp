@@ -14,7 +14,7 @@ struct qld : public index_scorer<Wand> {
 
     using index_scorer<Wand>::index_scorer;
 
-    term_scorer_t term_scorer(uint64_t term_id) const override
+    auto static_term_scorer(uint64_t term_id) const
     {
         auto s = [&, term_id](uint32_t doc, uint32_t freq) {
             float numerator = 1
@@ -27,6 +27,11 @@ struct qld : public index_scorer<Wand> {
         };
         return s;
     }
+
+    term_scorer_t term_scorer(uint64_t term_id) const override
+    {
+        return static_term_scorer(term_id);
+    }
 };
 
 } // namespace pisa
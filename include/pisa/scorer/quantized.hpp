@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+
+#include "index_scorer.hpp"
+
+namespace pisa {
+
+/// Scorer of an index built with quantized impacts in place of frequencies: the score of a
+/// posting is the impact stored in the frequency stream, with no per-document statistics.
+template <typename Wand>
+struct quantized : public index_scorer<Wand> {
+    using index_scorer<Wand>::index_scorer;
+
+    auto static_term_scorer([[maybe_unused]] uint64_t term_id) const
+    {
+        return [](uint32_t, uint32_t freq) { return static_cast<float>(freq); };
+    }
+
+    term_scorer_t term_scorer(uint64_t term_id) const override
+    {
+        return static_term_scorer(term_id);
+    }
+};
+
+} // namespace pisa
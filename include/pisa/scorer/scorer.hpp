@@ -2,12 +2,17 @@
 
 #include <string>
 
+#include "boost/preprocessor/seq/for_each.hpp"
+#include "boost/preprocessor/stringize.hpp"
 #include "spdlog/spdlog.h"
 #include "index_scorer.hpp"
 #include "qld.hpp"
 #include "pl2.hpp"
 #include "bm25.hpp"
 #include "dph.hpp"
+#include "quantized.hpp"
+
+#define PISA_SCORERS (bm25)(qld)(pl2)(dph)(quantized)
 
 namespace pisa {
 namespace scorer{
@@ -20,11 +25,41 @@ auto from_name = [](std::string const &scorer_name, auto const &wdata) -> std::u
         return std::make_unique<pl2<decltype(wdata)>>(wdata);
     } else if (scorer_name == "dph") {
         return std::make_unique<dph<decltype(wdata)>>(wdata);
+    } else if (scorer_name == "quantized") {
+        return std::make_unique<quantized<decltype(wdata)>>(wdata);
     } else {
         spdlog::error("Unknown scorer {}", scorer_name);
         std::abort();
 
     }
 };
+
+/// Whether no term score of `scorer_name` is negative, as bounds that leave out some terms of
+/// a query assume. QLD, PL2 and DPH scores can be negative.
+[[nodiscard]] inline auto has_non_negative_scores(std::string const &scorer_name) -> bool
+{
+    return scorer_name == "bm25" || scorer_name == "quantized";
+}
+
+/// Calls `fn` with the scorer `scorer_name` wrapped in a `static_scorer`: the compile-time
+/// counterpart of `from_name`, instantiating `fn` once for each of `PISA_SCORERS`.
+template <typename Wand, typename Fn>
+void with_static_scorer(std::string const &scorer_name, Wand const &wdata, Fn &&fn)
+{
+    if (false) {
+#define LOOP_BODY(R, DATA, S)                        \
+    }                                                \
+    else if (scorer_name == BOOST_PP_STRINGIZE(S)) { \
+        static_scorer<S<Wand>> scorer(wdata);        \
+        fn(scorer);                                  \
+        /**/
+
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_SCORERS);
+#undef LOOP_BODY
+    } else {
+        spdlog::error("Unknown scorer {}", scorer_name);
+        std::abort();
+    }
+}
 }
 } // namespace pisa
@@ -58,11 +58,23 @@ struct topk_queue {
         m_threshold = t;
     }
 
+    [[nodiscard]] Threshold threshold() const noexcept { return m_threshold; }
+
+    [[nodiscard]] bool full() const noexcept { return m_q.size() >= m_k; }
+
     void clear() noexcept {
         m_q.clear();
         m_threshold = 0;
     }
 
+    /// Empties the queue for a query keeping the top `k`, reusing its storage.
+    void reset(uint64_t k)
+    {
+        clear();
+        m_k = k;
+        m_q.reserve(m_k + 1);
+    }
+
     [[nodiscard]] uint64_t size() const noexcept { return m_k; }
 
    private:
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+namespace pisa {
+
+/// Number of values compared at once by `count_below`.
+#if defined(__AVX512F__)
+constexpr std::size_t simd_search_width = 16;
+#else
+constexpr std::size_t simd_search_width = 8;
+#endif
+
+/// Returns how many of the `n <= simd_search_width` sorted `values` are below `target`.
+inline auto count_below(uint32_t const *values, std::size_t n, uint32_t target) -> std::size_t
+{
+#if defined(__AVX512F__)
+    if (n == 16) {
+        auto below = _mm512_cmp_epu32_mask(
+            _mm512_loadu_si512(values), _mm512_set1_epi32(target), _MM_CMPINT_LT);
+        return __builtin_popcount(below);
+    }
+#elif defined(__AVX2__)
+    if (n == 8) {
+        auto v = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(values));
+        // v >= target iff max(v, target) == v, as unsigned integers
+        auto geq = _mm256_cmpeq_epi32(_mm256_max_epu32(v, _mm256_set1_epi32(target)), v);
+        return 8 - __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(geq)));
+    }
+#endif
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        count += static_cast<std::size_t>(values[i] < target);
+    }
+    return count;
+}
+
+/// Returns the position of the first value at least `target` among the sorted
+/// `values[begin, end)`; `values[end - 1]` must be at least `target`.
+///
+/// After `begin` itself, the next `simd_search_width` values are compared at once, which
+/// settles the most common, short skips. Past them, the search gallops, doubling the distance
+/// each time, then narrows the range down to one chunk with a binary search and compares that
+/// chunk at once, so that long skips cost a logarithmic number of comparisons in the distance
+/// instead of a linear scan.
+inline auto find_geq(uint32_t const *values, std::size_t begin, std::size_t end, uint32_t target)
+    -> std::size_t
+{
+    if (values[begin] >= target) {
+        return begin;
+    }
+    // the values in [begin, lo) are below target, and the one at hi - 1 is not
+    std::size_t lo = begin + 1;
+    if (lo + simd_search_width <= end) {
+        auto below = count_below(values + lo, simd_search_width, target);
+        if (below < simd_search_width) {
+            return lo + below;
+        }
+        lo += simd_search_width;
+    }
+    std::size_t step = 2 * simd_search_width;
+    while (lo + step < end && values[lo + step - 1] < target) {
+        lo += step;
+        step *= 2;
+    }
+    std::size_t hi = std::min(lo + step, end);
+    while (hi - lo > simd_search_width) {
+        auto mid = lo + (hi - lo) / 2;
+        if (values[mid - 1] < target) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo + count_below(values + lo, hi - lo, target);
+}
+
+} // namespace pisa
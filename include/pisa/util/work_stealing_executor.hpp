@@ -0,0 +1,317 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "configuration.hpp"
+
+namespace pisa {
+
+/// A long-lived pool of worker threads executing short tasks.
+///
+/// Every worker owns a task deque: it pops its own work from the back and, once it runs
+/// dry, steals from the front of the other workers' deques. Workers are optionally pinned
+/// to the CPUs the process may run on, one each, and the time they spend running tasks is
+/// tracked so that callers can report how busy the pool was.
+class work_stealing_executor {
+   public:
+    using task_type = std::function<void()>;
+
+    struct statistics {
+        size_t workers = 0;
+        /// Tasks run by the workers and by the threads waiting in `parallel_for`.
+        uint64_t tasks = 0;
+        uint64_t steals = 0;
+        /// Fraction of the wall time (since construction or the last reset) that the workers
+        /// spent running tasks, averaged over all workers.
+        double utilization = 0.0;
+    };
+
+    explicit work_stealing_executor(size_t num_workers = configuration::get().worker_threads,
+                                    bool pin_workers = configuration::get().pin_threads)
+        : m_workers(std::max<size_t>(num_workers, 1))
+    {
+        for (auto &w : m_workers) {
+            w = std::make_unique<worker>();
+        }
+        m_epoch = std::chrono::steady_clock::now();
+        auto cpus = pin_workers ? allowed_cpus() : std::vector<int>{};
+        for (size_t id = 0; id < m_workers.size(); ++id) {
+            m_workers[id]->thread = std::thread([this, id] { run_worker(id); });
+            if (not cpus.empty()) {
+                pin(m_workers[id]->thread, cpus[id % cpus.size()]);
+            }
+        }
+    }
+
+    work_stealing_executor(work_stealing_executor const &) = delete;
+    work_stealing_executor &operator=(work_stealing_executor const &) = delete;
+
+    ~work_stealing_executor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_sleep_mutex);
+            m_stop = true;
+        }
+        m_wakeup.notify_all();
+        for (auto &w : m_workers) {
+            w->thread.join();
+        }
+    }
+
+    [[nodiscard]] size_t size() const noexcept { return m_workers.size(); }
+
+    /// Runs `fn(i)` for every `i` in `[0, n)` as separate tasks, and blocks until all of them
+    /// have finished. The calling thread helps executing tasks while it waits, so it is safe
+    /// to call this from within a task. If any `fn(i)` throws, the first exception is rethrown
+    /// once all tasks have finished.
+    template <typename Fn>
+    void parallel_for(size_t n, Fn fn)
+    {
+        if (n == 0) {
+            return;
+        }
+        auto group = std::make_shared<task_group>(n);
+        size_t first = m_next_queue.fetch_add(n, std::memory_order_relaxed);
+        for (size_t i = 0; i < n; ++i) {
+            push((first + i) % m_workers.size(), [group, &fn, i] {
+                try {
+                    fn(i);
+                } catch (...) {
+                    group->fail(std::current_exception());
+                }
+                group->finish_one();
+            });
+        }
+        wait(*group);
+    }
+
+    /// Enqueues a task without waiting for it.
+    void submit(task_type task)
+    {
+        push(m_next_queue.fetch_add(1, std::memory_order_relaxed) % m_workers.size(),
+             std::move(task));
+    }
+
+    [[nodiscard]] auto stats() const -> statistics
+    {
+        statistics s;
+        s.workers = m_workers.size();
+        s.tasks = m_caller_tasks.load(std::memory_order_relaxed);
+        uint64_t busy_ns = 0;
+        for (auto const &w : m_workers) {
+            s.tasks += w->tasks.load(std::memory_order_relaxed);
+            s.steals += w->steals.load(std::memory_order_relaxed);
+            busy_ns += w->busy_ns.load(std::memory_order_relaxed);
+        }
+        auto wall_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now() - m_epoch)
+                           .count();
+        if (wall_ns > 0) {
+            s.utilization = static_cast<double>(busy_ns) / (double(wall_ns) * s.workers);
+        }
+        return s;
+    }
+
+    void reset_stats()
+    {
+        for (auto &w : m_workers) {
+            w->tasks = 0;
+            w->steals = 0;
+            w->busy_ns = 0;
+        }
+        m_caller_tasks = 0;
+        m_epoch = std::chrono::steady_clock::now();
+    }
+
+   private:
+    struct worker {
+        std::mutex mutex;
+        std::deque<task_type> queue;
+        std::thread thread;
+        std::atomic<uint64_t> tasks{0};
+        std::atomic<uint64_t> steals{0};
+        std::atomic<uint64_t> busy_ns{0};
+    };
+
+    struct task_group {
+        explicit task_group(size_t n) : remaining(n) {}
+
+        void finish_one()
+        {
+            if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard<std::mutex> lock(mutex);
+                done.notify_all();
+            }
+        }
+
+        /// Records the exception of a failed task, if it is the first one.
+        void fail(std::exception_ptr exception)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error) {
+                error = std::move(exception);
+            }
+        }
+
+        std::atomic<size_t> remaining;
+        std::mutex mutex;
+        std::condition_variable done;
+        std::exception_ptr error;
+    };
+
+    /// CPUs in the affinity mask of the calling thread, so that pinning respects `taskset` and
+    /// cpusets; empty if it cannot be read.
+    static auto allowed_cpus() -> std::vector<int>
+    {
+        std::vector<int> cpus;
+#if defined(__linux__)
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        if (sched_getaffinity(0, sizeof(cpu_set_t), &cpuset) == 0) {
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                if (CPU_ISSET(cpu, &cpuset)) {
+                    cpus.push_back(cpu);
+                }
+            }
+        }
+#endif
+        return cpus;
+    }
+
+    static void pin([[maybe_unused]] std::thread &thread, [[maybe_unused]] int cpu)
+    {
+#if defined(__linux__)
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(cpu, &cpuset);
+        pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set_t), &cpuset);
+#endif
+    }
+
+    void push(size_t queue, task_type task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_workers[queue]->mutex);
+            m_workers[queue]->queue.push_back(std::move(task));
+            std::lock_guard<std::mutex> sleep_lock(m_sleep_mutex);
+            ++m_pending;
+        }
+        m_wakeup.notify_one();
+    }
+
+    /// Takes a task from the back of `queue` (own work) or from its front (stolen work).
+    bool take(size_t queue, bool steal, task_type &task)
+    {
+        auto &w = *m_workers[queue];
+        std::lock_guard<std::mutex> lock(w.mutex);
+        if (w.queue.empty()) {
+            return false;
+        }
+        if (steal) {
+            task = std::move(w.queue.front());
+            w.queue.pop_front();
+        } else {
+            task = std::move(w.queue.back());
+            w.queue.pop_back();
+        }
+        std::lock_guard<std::mutex> sleep_lock(m_sleep_mutex);
+        --m_pending;
+        return true;
+    }
+
+    bool find_task(size_t id, task_type &task, bool &stolen)
+    {
+        stolen = false;
+        if (take(id, false, task)) {
+            return true;
+        }
+        for (size_t offset = 1; offset < m_workers.size(); ++offset) {
+            if (take((id + offset) % m_workers.size(), true, task)) {
+                stolen = true;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run_worker(size_t id)
+    {
+        auto &self = *m_workers[id];
+        task_type task;
+        while (true) {
+            bool stolen;
+            if (find_task(id, task, stolen)) {
+                // Counted before running, so that a finished `parallel_for` is accounted for.
+                self.tasks.fetch_add(1, std::memory_order_relaxed);
+                auto start = std::chrono::steady_clock::now();
+                task();
+                task = nullptr;
+                auto elapsed = std::chrono::steady_clock::now() - start;
+                self.busy_ns.fetch_add(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+                    std::memory_order_relaxed);
+                if (stolen) {
+                    self.steals.fetch_add(1, std::memory_order_relaxed);
+                }
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(m_sleep_mutex);
+            m_wakeup.wait(lock, [this] { return m_stop || m_pending > 0; });
+            if (m_stop && m_pending == 0) {
+                return;
+            }
+        }
+    }
+
+    void wait(task_group &group)
+    {
+        task_type task;
+        size_t start = m_next_queue.load(std::memory_order_relaxed);
+        while (group.remaining.load(std::memory_order_acquire) > 0) {
+            bool found = false;
+            for (size_t offset = 0; offset < m_workers.size() && !found; ++offset) {
+                found = take((start + offset) % m_workers.size(), true, task);
+            }
+            if (found) {
+                m_caller_tasks.fetch_add(1, std::memory_order_relaxed);
+                task();
+                task = nullptr;
+                continue;
+            }
+            // Nothing left to steal: the remaining tasks are running on the workers.
+            std::unique_lock<std::mutex> lock(group.mutex);
+            group.done.wait(lock, [&] { return group.remaining.load() == 0; });
+        }
+        std::lock_guard<std::mutex> lock(group.mutex);
+        if (group.error) {
+            std::rethrow_exception(group.error);
+        }
+    }
+
+    std::vector<std::unique_ptr<worker>> m_workers;
+    std::atomic<size_t> m_next_queue{0};
+    std::atomic<uint64_t> m_caller_tasks{0};
+    std::mutex m_sleep_mutex;
+    std::condition_variable m_wakeup;
+    size_t m_pending = 0;
+    bool m_stop = false;
+    std::chrono::steady_clock::time_point m_epoch;
+};
+
+} // namespace pisa
@@ -2,12 +2,14 @@
 
 #include <algorithm>
 #include <numeric>
+#include <optional>
 #include <unordered_set>
 
 #include "boost/variant.hpp"
 #include "spdlog/spdlog.h"
 
 #include "binary_freq_collection.hpp"
+#include "linear_quantizer.hpp"
 #include "mappable/mappable_vector.hpp"
 #include "util/progress.hpp"
 #include "util/util.hpp"
@@ -18,6 +20,30 @@
 class enumerator;
 namespace pisa {
 
+/// Returns the largest score of any posting of `coll`, skipping `terms_to_drop`. As in
+/// `wand_data`, terms are numbered for the scorer after dropping.
+template <typename Scorer>
+float max_posting_score(binary_freq_collection const &coll,
+                        Scorer const &scorer,
+                        std::unordered_set<size_t> const &terms_to_drop = {})
+{
+    float max_score = 0;
+    size_t term_id = 0;
+    size_t new_term_id = 0;
+    for (auto const &seq : coll) {
+        if (terms_to_drop.find(term_id) == terms_to_drop.end()) {
+            auto s = scorer.term_scorer(new_term_id);
+            auto freq = seq.freqs.begin();
+            for (auto doc = seq.docs.begin(); doc != seq.docs.end(); ++doc, ++freq) {
+                max_score = std::max(max_score, s(*doc, *freq));
+            }
+            new_term_id += 1;
+        }
+        term_id += 1;
+    }
+    return max_score;
+}
+
 template <typename block_wand_type = wand_data_raw>
 class wand_data {
    public:
@@ -25,13 +51,18 @@ class wand_data {
 
     wand_data() {}
 
+    /// With `quantization_bits`, upper bounds are computed on scores quantized by a
+    /// `linear_quantizer` over the largest score of the collection, matching an index built
+    /// with `create_freq_index --quantize` and queried with the `quantized` scorer.
     template <typename LengthsIterator>
     wand_data(LengthsIterator len_it,
               uint64_t num_docs,
               binary_freq_collection const &coll,
               std::string const &scorer_name,
               BlockSize block_size,
-              std::unordered_set<size_t> const &terms_to_drop) : m_num_docs(num_docs)
+              std::unordered_set<size_t> const &terms_to_drop,
+              std::optional<uint32_t> quantization_bits = std::nullopt)
+        : m_num_docs(num_docs)
     {
         std::vector<uint32_t> doc_lens(num_docs);
         std::vector<float> max_term_weight;
@@ -72,6 +103,13 @@ class wand_data {
         m_term_posting_counts.steal(term_posting_counts);
 
         auto scorer = scorer::from_name(scorer_name, *this);
+        std::optional<linear_quantizer> quantizer;
+        if (quantization_bits) {
+            quantizer.emplace(max_posting_score(coll, *scorer, terms_to_drop), *quantization_bits);
+            spdlog::info("Quantizing scores up to {} to {} bits",
+                         quantizer->max_score(),
+                         *quantization_bits);
+        }
         {
             pisa::progress progress("Storing score upper bounds", coll.size());
             size_t term_id = 0;
@@ -82,7 +120,14 @@ class wand_data {
                     term_id += 1;
                     continue;
                 }
-                auto v = builder.add_sequence(seq, coll, doc_lens, m_avg_len, scorer->term_scorer(new_term_id), block_size);
+                auto term_scorer = scorer->term_scorer(new_term_id);
+                if (quantizer) {
+                    term_scorer = [q = *quantizer, s = term_scorer](uint32_t doc, uint32_t freq) {
+                        return static_cast<float>(q(s(doc, freq)));
+                    };
+                }
+                auto v = builder.add_sequence(
+                    seq, coll, doc_lens, m_avg_len, term_scorer, block_size);
                 max_term_weight.push_back(v);
                 term_id += 1;
                 new_term_id += 1;
@@ -97,6 +142,9 @@ class wand_data {
 
     size_t doc_len(uint64_t doc_id) const { return m_doc_lens[doc_id]; }
 
+    // document lengths indexed by docid, for scoring kernels that gather them
+    uint32_t const *doc_lens() const { return m_doc_lens.data(); }
+
     size_t term_occurrence_count(uint64_t term_id) const { return m_term_occurrence_counts[term_id]; }
 
     size_t term_posting_count(uint64_t term_id) const { return m_term_posting_counts[term_id]; }
@@ -8,6 +8,7 @@
 #include "binary_freq_collection.hpp"
 #include "global_parameters.hpp"
 #include "util/compiler_attribute.hpp"
+#include "util/simd_search.hpp"
 #include "wand_utils.hpp"
 
 namespace pisa {
@@ -100,10 +101,15 @@ class wand_data_raw {
 
         void PISA_NOINLINE next_geq(uint64_t lower_bound)
         {
-            while (cur_pos + 1 < block_number
-                   && m_block_docid[block_start + cur_pos] < lower_bound) {
-                cur_pos++;
+            auto const *block_docid = m_block_docid.data() + block_start;
+            if (block_docid[cur_pos] >= lower_bound) {
+                return;
             }
+            if (lower_bound > block_docid[block_number - 1]) {
+                cur_pos = block_number - 1;
+                return;
+            }
+            cur_pos = find_geq(block_docid, cur_pos, block_number, lower_bound);
         }
 
         float PISA_FLATTEN_FUNC score() const
@@ -115,6 +121,18 @@ class wand_data_raw {
 
         uint64_t PISA_FLATTEN_FUNC find_next_skip() { return m_block_docid[cur_pos + block_start]; }
 
+        /// Prefetches the docids and maxima of up to `blocks` blocks following the current one,
+        /// as `block_posting_list::document_enumerator::prefetch_blocks`.
+        void prefetch_blocks(uint32_t blocks) const
+        {
+            if (cur_pos + 1 >= block_number) {
+                return;
+            }
+            auto last = block_start + std::min<uint64_t>(cur_pos + blocks, block_number - 1);
+            m_block_docid.prefetch(last);
+            m_block_max_term_weight.prefetch(last);
+        }
+
        private:
         uint64_t cur_pos;
         uint64_t block_start;
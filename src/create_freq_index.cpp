@@ -1,5 +1,6 @@
 #include <algorithm>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <numeric>
 #include <thread>
@@ -11,10 +12,16 @@
 #include "mappable/mapper.hpp"
 
 #include "configuration.hpp"
+#include "impact_ordered_index.hpp"
+#include "linear_quantizer.hpp"
 #include "util/index_build_utils.hpp"
 #include "index_types.hpp"
 #include "util/util.hpp"
 #include "util/verify_collection.hpp" // XXX move to index_build_utils
+#include "wand_data.hpp"
+#include "wand_data_compressed.hpp"
+#include "wand_data_raw.hpp"
+#include "scorer/scorer.hpp"
 
 #include "CLI/CLI.hpp"
 
@@ -47,12 +54,18 @@ void dump_index_specific_stats(pisa::pefopt_index const &coll, std::string const
         "freqs_avg_part", long_postings / freqs_partitions);
 }
 
+// Returns, for a term, the function computing the quantized impacts of its postings.
+using term_impacts_t = std::function<pisa::term_scorer_t(uint64_t)>;
+
+/// Builds an index of `input`. With `term_impacts`, the frequencies are replaced by the
+/// quantized impacts of the postings.
 template <typename InputCollection, typename CollectionType>
 void create_collection(InputCollection const &input,
                        pisa::global_parameters const &params,
                        const std::optional<std::string> &output_filename,
                        bool check,
-                       std::string const &seq_type) {
+                       std::string const &seq_type,
+                       term_impacts_t const &term_impacts) {
     using namespace pisa;
     spdlog::info("Processing {} documents", input.num_docs());
     double tick = get_time_usecs();
@@ -62,11 +75,29 @@ void create_collection(InputCollection const &input,
     size_t postings = 0;
     {
         pisa::progress progress("Create index", input.size());
+        std::vector<uint32_t> impacts;
+        size_t term = 0;
         for (auto const &plist : input) {
             uint64_t freqs_sum;
             size = plist.docs.size();
-            freqs_sum = std::accumulate(plist.freqs.begin(), plist.freqs.begin() + size, uint64_t(0));
-            builder.add_posting_list(size, plist.docs.begin(), plist.freqs.begin(), freqs_sum);
+            if (term_impacts) {
+                auto impact = term_impacts(term);
+                impacts.resize(size);
+                std::transform(plist.docs.begin(),
+                               plist.docs.end(),
+                               plist.freqs.begin(),
+                               impacts.begin(),
+                               [&](uint32_t doc, uint32_t freq) {
+                                   return static_cast<uint32_t>(impact(doc, freq));
+                               });
+                freqs_sum = std::accumulate(impacts.begin(), impacts.end(), uint64_t(0));
+                builder.add_posting_list(size, plist.docs.begin(), impacts.begin(), freqs_sum);
+            } else {
+                freqs_sum =
+                    std::accumulate(plist.freqs.begin(), plist.freqs.begin() + size, uint64_t(0));
+                builder.add_posting_list(size, plist.docs.begin(), plist.freqs.begin(), freqs_sum);
+            }
+            term += 1;
 
             progress.update(1);
             postings += size;
@@ -86,13 +117,81 @@ void create_collection(InputCollection const &input,
 
     if (output_filename) {
         mapper::freeze(coll, (*output_filename).c_str());
-        if (check) {
+        if (check && term_impacts) {
+            spdlog::warn("Skipping the check: quantized impacts replace the frequencies");
+        } else if (check) {
             verify_collection<InputCollection, CollectionType>(input,
                                                                (*output_filename).c_str());
         }
     }
 }
 
+/// Builds an impact-ordered index of `input`. The builder drops postings with non-positive
+/// scores, so `scorer_name` must not produce negative scores.
+template <typename WandType>
+void create_impact_index(pisa::binary_freq_collection const &input,
+                         std::string const &wand_data_filename,
+                         std::string const &scorer_name,
+                         uint32_t impact_levels,
+                         std::string const &output_filename)
+{
+    using namespace pisa;
+    spdlog::info("Processing {} documents", input.num_docs());
+    double tick = get_time_usecs();
+
+    WandType wdata;
+    mio::mmap_source md(wand_data_filename.c_str());
+    mapper::map(wdata, md);
+    auto scorer = scorer::from_name(scorer_name, wdata);
+
+    float max_score = 0;
+    for (size_t term = 0; term < input.size(); ++term) {
+        max_score = std::max(max_score, wdata.max_term_weight(term));
+    }
+
+    impact_ordered_index::builder builder(input.num_docs(), max_score, impact_levels);
+    size_t postings = 0;
+    {
+        pisa::progress progress("Create impact-ordered index", input.size());
+        size_t term = 0;
+        for (auto const &plist : input) {
+            builder.add_posting_list(plist.docs.size(),
+                                     plist.docs.begin(),
+                                     plist.freqs.begin(),
+                                     scorer->term_scorer(term));
+            postings += plist.docs.size();
+            term += 1;
+            progress.update(1);
+        }
+    }
+
+    impact_ordered_index index;
+    builder.build(index);
+    double elapsed_secs = (get_time_usecs() - tick) / 1000000;
+    spdlog::info("impact collection built in {} seconds", elapsed_secs);
+
+    stats_line()("type", "impact")("impact_levels", impact_levels)("postings", postings)(
+        "construction_time", elapsed_secs);
+    mapper::freeze(index, output_filename.c_str());
+}
+
+/// Calls `fn` with the wand data mapped from `filename`.
+template <typename Fn>
+void with_wand_data(std::string const &filename, bool compressed, Fn fn)
+{
+    using namespace pisa;
+    mio::mmap_source md(filename.c_str());
+    if (compressed) {
+        wand_data<wand_data_compressed> wdata;
+        mapper::map(wdata, md);
+        fn(wdata);
+    } else {
+        wand_data<wand_data_raw> wdata;
+        mapper::map(wdata, md);
+        fn(wdata);
+    }
+}
+
 int main(int argc, char **argv) {
 
     using namespace pisa;
@@ -100,32 +199,96 @@ int main(int argc, char **argv) {
     std::string input_basename;
     std::optional<std::string> output_filename;
     bool check = false;
+    std::optional<std::string> wand_data_filename;
+    std::string scorer_name = "bm25";
+    uint32_t impact_levels = 255;
+    bool compressed = false;
+    std::optional<uint32_t> quantization_bits;
 
     CLI::App app{"create_freq_index - a tool for creating an index."};
     app.add_option("-t,--type", type, "Index type")->required();
     app.add_option("-c,--collection", input_basename, "Collection basename")->required();
     app.add_option("-o,--output", output_filename, "Output filename")->required();
     app.add_flag("--check", check, "Check the correctness of the index");
+    app.add_option(
+        "-w,--wand", wand_data_filename, "Wand data filename (impact or quantized index)");
+    app.add_option("-s,--scorer", scorer_name, "Scorer function (impact or quantized index)");
+    app.add_flag("--compressed-wand", compressed, "Compressed wand input file");
+    app.add_option("--impact-levels", impact_levels, "Number of quantized impacts (impact index)");
+    app.add_option("--quantize",
+                   quantization_bits,
+                   "Store scores quantized to this many bits instead of frequencies");
     CLI11_PARSE(app, argc, argv);
 
     binary_freq_collection input(input_basename.c_str());
 
+    if (type == "impact") {
+        if (not wand_data_filename) {
+            spdlog::error("An impact-ordered index needs wand data to score postings");
+            return 1;
+        }
+        if (not scorer::has_non_negative_scores(scorer_name)) {
+            spdlog::error("Cannot order {} scores by impact, as they can be negative", scorer_name);
+            return 1;
+        }
+        if (impact_levels == 0 || impact_levels > impact_ordered_index::max_impact_levels) {
+            spdlog::error("The number of impact levels must be between 1 and {}",
+                          impact_ordered_index::max_impact_levels);
+            return 1;
+        }
+        if (compressed) {
+            create_impact_index<wand_data<wand_data_compressed>>(
+                input, *wand_data_filename, scorer_name, impact_levels, *output_filename);
+        } else {
+            create_impact_index<wand_data<wand_data_raw>>(
+                input, *wand_data_filename, scorer_name, impact_levels, *output_filename);
+        }
+        return 0;
+    }
+
     pisa::global_parameters params;
     params.log_partition_size = configuration::get().log_partition_size;
 
-    if (false) {
-#define LOOP_BODY(R, DATA, T)                                               \
-    }                                                                       \
-    else if (type == BOOST_PP_STRINGIZE(T)) {                               \
-        create_collection<binary_freq_collection, BOOST_PP_CAT(T, _index)>( \
-            input, params, output_filename, check, type);                   \
+    auto build = [&](term_impacts_t const &term_impacts) {
+        if (false) {
+#define LOOP_BODY(R, DATA, T)                                                   \
+    }                                                                           \
+    else if (type == BOOST_PP_STRINGIZE(T)) {                                   \
+        create_collection<binary_freq_collection, BOOST_PP_CAT(T, _index)>(     \
+            input, params, output_filename, check, type, term_impacts);         \
         /**/
 
-        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_INDEX_TYPES);
+            BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_INDEX_TYPES);
 #undef LOOP_BODY
-    } else {
-        spdlog::error("Unknown type {}", type);
-    }
+        } else {
+            spdlog::error("Unknown type {}", type);
+        }
+    };
 
+    if (not quantization_bits) {
+        build({});
+        return 0;
+    }
+    if (not wand_data_filename) {
+        spdlog::error("A quantized index needs wand data to score postings");
+        return 1;
+    }
+    if (not scorer::has_non_negative_scores(scorer_name)) {
+        spdlog::error("Cannot quantize {} scores, which can be negative", scorer_name);
+        return 1;
+    }
+    // Quantized wand data must be built with the same scorer, bits and no dropped terms, so
+    // that both quantize over the same largest score.
+    with_wand_data(*wand_data_filename, compressed, [&](auto const &wdata) {
+        auto scorer = scorer::from_name(scorer_name, wdata);
+        linear_quantizer quantizer(max_posting_score(input, *scorer), *quantization_bits);
+        spdlog::info(
+            "Quantizing scores up to {} to {} bits", quantizer.max_score(), *quantization_bits);
+        build([&](uint64_t term) -> term_scorer_t {
+            return [&quantizer, s = scorer->term_scorer(term)](uint32_t doc, uint32_t freq) {
+                return static_cast<float>(quantizer(s(doc, freq)));
+            };
+        });
+    });
     return 0;
 }
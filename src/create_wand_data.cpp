@@ -29,6 +29,7 @@ int main(int argc, const char **argv)
     bool compress = false;
     bool range = false;
     std::string terms_to_drop_filename;
+    std::optional<uint32_t> quantization_bits;
 
     CLI::App app{"create_wand_data - a tool for creating additional data for query processing."};
     app.add_option("-c,--collection", input_basename, "Collection basename")->required();
@@ -44,9 +45,15 @@ int main(int argc, const char **argv)
     app.add_option("-s,--scorer", scorer_name, "Scorer function")->required();
     app.add_flag("--range", range, "Create docid-range based data")->excludes(var_block_opt);
     app.add_option("--terms-to-drop", terms_to_drop_filename, "A filename containing a list of term IDs that we want to drop");
+    app.add_option("--quantize", quantization_bits, "Quantize scores to this many bits");
 
     CLI11_PARSE(app, argc, argv);
 
+    if (quantization_bits && not scorer::has_non_negative_scores(scorer_name)) {
+        spdlog::error("Cannot quantize {} scores, which can be negative", scorer_name);
+        return 1;
+    }
+
     std::string partition_type_name = (lambda) ? "variable partition" : "static partition";
     spdlog::info("Block based wand creation with {}", partition_type_name);
 
@@ -74,15 +81,33 @@ int main(int argc, const char **argv)
 
     if (compress) {
         wand_data<wand_data_compressed> wdata(
-            sizes_coll.begin()->begin(), coll.num_docs(), coll,scorer_name, block_size, dropped_term_ids);
+            sizes_coll.begin()->begin(),
+            coll.num_docs(),
+            coll,
+            scorer_name,
+            block_size,
+            dropped_term_ids,
+            quantization_bits);
         mapper::freeze(wdata, output_filename.c_str());
     } else if (range) {
         wand_data<wand_data_range<128, 1024>> wdata(
-            sizes_coll.begin()->begin(), coll.num_docs(), coll, scorer_name, block_size, dropped_term_ids);
+            sizes_coll.begin()->begin(),
+            coll.num_docs(),
+            coll,
+            scorer_name,
+            block_size,
+            dropped_term_ids,
+            quantization_bits);
         mapper::freeze(wdata, output_filename.c_str());
     } else {
         wand_data<wand_data_raw> wdata(
-            sizes_coll.begin()->begin(), coll.num_docs(), coll, scorer_name, block_size, dropped_term_ids);
+            sizes_coll.begin()->begin(),
+            coll.num_docs(),
+            coll,
+            scorer_name,
+            block_size,
+            dropped_term_ids,
+            quantization_bits);
         mapper::freeze(wdata, output_filename.c_str());
     }
 }
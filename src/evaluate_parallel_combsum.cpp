@@ -6,23 +6,24 @@
 #include <functional>
 
 #include "accumulator/lazy_accumulator.hpp"
+#include "buffered_topk_queue.hpp"
 #include "mio/mmap.hpp"
 #include "spdlog/sinks/stdout_color_sinks.h"
 #include "spdlog/spdlog.h"
 
 #include "mappable/mapper.hpp"
 
-#include "tbb/parallel_for.h"
-#include "tbb/task_scheduler_init.h"
-#include <thread>
-
 #include "cursor/block_max_scored_cursor.hpp"
 #include "cursor/max_scored_cursor.hpp"
 #include "cursor/scored_cursor.hpp"
 #include "index_types.hpp"
 #include "io.hpp"
+#include "query/fused_threshold.hpp"
+#include "query/fusion.hpp"
 #include "query/queries.hpp"
+#include "query/query_context.hpp"
 #include "util/util.hpp"
+#include "util/work_stealing_executor.hpp"
 #include "wand_data_compressed.hpp"
 #include "wand_data_raw.hpp"
 
@@ -33,8 +34,27 @@
 using namespace pisa;
 using ranges::views::enumerate;
 
-void join_thread(std::thread& t) {
-    t.join();
+/// Returns a function evaluating all the variations of a multi-query on the calling thread,
+/// interleaved by `interleaved_query<QueryAlg>` over the cursors returned by `make_cursors`,
+/// with the scratch space of the thread's `query_context`.
+template <typename QueryAlg, typename MakeCursors>
+auto interleaved_fun(MakeCursors make_cursors, uint64_t k, uint64_t max_docid)
+{
+    return [=](multi_query const &m_query, fused_threshold *shared) {
+        std::vector<decltype(make_cursors(m_query.front()))> cursors;
+        for (auto const &query : m_query) {
+            cursors.push_back(make_cursors(query));
+        }
+        std::vector<topk_queue> topks(m_query.size(), topk_queue(k));
+        interleaved_query<QueryAlg> query_alg(topks, shared, &thread_query_context());
+        query_alg(cursors, max_docid);
+        std::vector<std::vector<std::pair<float, uint64_t>>> results;
+        for (auto &topk : topks) {
+            topk.finalize();
+            results.push_back(topk.topk());
+        }
+        return results;
+    };
 }
 
 template <typename IndexType, typename WandType>
@@ -46,6 +66,10 @@ void evaluate_queries(const std::string &index_filename,
                       std::string const &query_type,
                       uint64_t k,
                       uint64_t fusion_k,
+                      fusion_method fusion_type,
+                      fusion_strategy fusion_algo,
+                      bool shared_threshold,
+                      bool interleave,
                       std::string const &documents_filename,
                       std::string const &scorer_name,
                       std::string const &run_id = "R0",
@@ -70,52 +94,101 @@ void evaluate_queries(const std::string &index_filename,
         mapper::map(wdata, md, mapper::map_flags::warmup);
     }
 
-    std::function<std::vector<std::pair<float, uint64_t>>(Query)> query_fun;
+    // Called by the executor threads at once, each with its own context.
+    std::function<std::vector<std::pair<float, uint64_t>>(Query, fused_threshold *, size_t)>
+        query_fun;
+    std::function<std::vector<std::vector<std::pair<float, uint64_t>>>(multi_query const &)>
+        multi_query_fun;
+    std::function<std::vector<std::vector<std::pair<float, uint64_t>>>(multi_query const &,
+                                                                       fused_threshold *)>
+        interleaved_multi_query_fun;
+    auto max_scored_cursors = [&](Query const &query) {
+        return make_max_scored_cursors(index, wdata, *scorer, query);
+    };
+    auto block_max_scored_cursors = [&](Query const &query) {
+        return make_block_max_scored_cursors(index, wdata, *scorer, query);
+    };
 
     if (query_type == "wand" && wand_data_filename) {
-        query_fun = [&](Query query) {
-            topk_queue topk(k);
-            wand_query wand_q(topk);
-            wand_q(make_max_scored_cursors(index, wdata, *scorer, query),
+        query_fun = [&](Query query, fused_threshold *shared, size_t variation) {
+            auto &context = thread_query_context();
+            auto &topk = context.topk(k);
+            shared_threshold_query<wand_query> wand_q(topk, shared, variation, &context);
+            wand_q(make_max_scored_cursors(context, index, wdata, *scorer, query),
                    index.num_docs());
             topk.finalize();
             return topk.topk();
         };
+        interleaved_multi_query_fun =
+            interleaved_fun<wand_query>(max_scored_cursors, k, index.num_docs());
     } else if (query_type == "block_max_wand" && wand_data_filename) {
-        query_fun = [&](Query query) {
-            topk_queue topk(k);
-            block_max_wand_query block_max_wand_q(topk);
-            block_max_wand_q(make_block_max_scored_cursors(index, wdata, *scorer, query),
+        query_fun = [&](Query query, fused_threshold *shared, size_t variation) {
+            auto &context = thread_query_context();
+            auto &topk = context.topk(k);
+            shared_threshold_query<block_max_wand_query> block_max_wand_q(
+                topk, shared, variation, &context);
+            block_max_wand_q(make_block_max_scored_cursors(context, index, wdata, *scorer, query),
                              index.num_docs());
             topk.finalize();
             return topk.topk();
         };
+        interleaved_multi_query_fun =
+            interleaved_fun<block_max_wand_query>(block_max_scored_cursors, k, index.num_docs());
     } else if (query_type == "block_max_maxscore" && wand_data_filename) {
-        query_fun = [&](Query query) {
-            topk_queue topk(k);
-            block_max_maxscore_query block_max_maxscore_q(topk);
+        query_fun = [&](Query query, fused_threshold *shared, size_t variation) {
+            auto &context = thread_query_context();
+            auto &topk = context.topk(k);
+            shared_threshold_query<block_max_maxscore_query> block_max_maxscore_q(
+                topk, shared, variation, &context);
             block_max_maxscore_q(
-                make_block_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
+                make_block_max_scored_cursors(context, index, wdata, *scorer, query),
+                index.num_docs());
             topk.finalize();
             return topk.topk();
         };
+        interleaved_multi_query_fun = interleaved_fun<block_max_maxscore_query>(
+            block_max_scored_cursors, k, index.num_docs());
     } else if (query_type == "ranked_or" && wand_data_filename) {
-        query_fun = [&](Query query) {
-            topk_queue topk(k);
-            ranked_or_query ranked_or_q(topk);
-            ranked_or_q(make_scored_cursors(index, *scorer, query), index.num_docs());
+        query_fun = [&](Query query, fused_threshold *shared, size_t variation) {
+            auto &context = thread_query_context();
+            auto &topk = context.topk(k);
+            shared_threshold_query<ranked_or_query> ranked_or_q(topk, shared, variation);
+            ranked_or_q(make_scored_cursors(context, index, *scorer, query), index.num_docs());
             topk.finalize();
             return topk.topk();
         };
+        interleaved_multi_query_fun = interleaved_fun<ranked_or_query>(
+            [&](Query const &query) { return make_scored_cursors(index, *scorer, query); },
+            k,
+            index.num_docs());
     } else if (query_type == "maxscore" && wand_data_filename) {
-        query_fun = [&](Query query) {
-            topk_queue topk(k);
-            maxscore_query maxscore_q(topk);
-            maxscore_q(make_max_scored_cursors(index, wdata, *scorer, query),
+        query_fun = [&](Query query, fused_threshold *shared, size_t variation) {
+            auto &context = thread_query_context();
+            auto &topk = context.topk(k);
+            shared_threshold_query<maxscore_query> maxscore_q(topk, shared, variation, &context);
+            maxscore_q(make_max_scored_cursors(context, index, wdata, *scorer, query),
                        index.num_docs());
             topk.finalize();
             return topk.topk();
         };
+        interleaved_multi_query_fun =
+            interleaved_fun<maxscore_query>(max_scored_cursors, k, index.num_docs());
+    } else if (query_type == "shared_maxscore" && wand_data_filename) {
+        // All variations in one pass, decoding each distinct term once.
+        multi_query_fun = [&](multi_query const &m_query) {
+            auto shared = multi_query_to_shared(m_query);
+            std::vector<buffered_topk_queue> topks(m_query.size(), buffered_topk_queue(k));
+            shared_maxscore_query shared_maxscore_q(topks);
+            shared_maxscore_q(make_max_scored_cursors(index, wdata, *scorer, shared.as_query()),
+                              shared.variations,
+                              index.num_docs());
+            std::vector<std::vector<std::pair<float, uint64_t>>> results;
+            for (auto &topk : topks) {
+                topk.finalize();
+                results.push_back(topk.topk());
+            }
+            return results;
+        };
     } else {
         spdlog::error("Unsupported query type: {}", query_type);
         return;
@@ -124,44 +197,59 @@ void evaluate_queries(const std::string &index_filename,
     auto source = std::make_shared<mio::mmap_source>(documents_filename.c_str());
     auto docmap = Payload_Vector<>::from(*source);
 
-    std::vector<std::vector<std::pair<float, uint64_t>>> raw_results(queries.size());
-    auto start_batch = std::chrono::steady_clock::now();
-    size_t query_idx = 0;
-
-    for (auto const & m_query : queries) {
-               
-        topk_queue fused_top_k(fusion_k);
-        std::unordered_map<uint64_t, float> fusion_accumulators;
-        std::vector<std::thread> query_threads;
-        std::vector<std::vector<std::pair<float, uint64_t>>> mq_results(m_query.size());
+    if (interleave && not interleaved_multi_query_fun) {
+        spdlog::warn("Interleaving is not supported by {}, disabling it", query_type);
+        interleave = false;
+    }
+    auto variation_upper_bounds = [&](multi_query const &m_query) {
+        std::vector<float> upper_bounds;
+        for (auto const &query : m_query) {
+            upper_bounds.push_back(variation_upper_bound(wdata, query_term_weights(query)));
+        }
+        return upper_bounds;
+    };
 
-        double tick = get_time_usecs();
-        size_t idx = 0;
-        for (auto const & query : m_query) {
-            
-            auto q_thread = std::thread( [&, idx] {            
-                mq_results[idx] = query_fun(query);
+    work_stealing_executor executor;
+    spdlog::info("Running {} on {} worker threads",
+                 interleave ? "multi-queries" : "variations",
+                 executor.size());
+    if (not multi_query_fun) {
+        multi_query_fun = [&](multi_query const &m_query) {
+            std::optional<fused_threshold> shared;
+            if (shared_threshold) {
+                shared.emplace(variation_upper_bounds(m_query));
+            }
+            std::vector<std::vector<std::pair<float, uint64_t>>> results(m_query.size());
+            executor.parallel_for(m_query.size(), [&](size_t idx) {
+                results[idx] = query_fun(m_query[idx], shared ? &*shared : nullptr, idx);
             });
+            return results;
+        };
+    }
 
-            query_threads.emplace_back(std::move(q_thread));
-            ++idx;
-        }
-        
-        std::for_each(query_threads.begin(), query_threads.end(), join_thread);
+    result_fusion fusion(fusion_type, fusion_k, fusion_algo);
+    std::vector<std::vector<std::pair<float, uint64_t>>> raw_results(queries.size());
+    auto start_batch = std::chrono::steady_clock::now();
+    size_t query_idx = 0;
 
-        // CombSUM fusion
-        for (auto const & result : mq_results) {
-            for (auto const & scored_pair : result) {
-                fusion_accumulators[scored_pair.second] += scored_pair.first; 
+    if (interleave) {
+        // Variations are interleaved on one thread, to overlap their memory accesses, and
+        // multi-queries run in parallel.
+        executor.parallel_for(queries.size(), [&](size_t idx) {
+            std::optional<fused_threshold> shared;
+            if (shared_threshold) {
+                shared.emplace(variation_upper_bounds(queries[idx]));
             }
-        } 
-        // Now create fused top-k
-        for (auto it = fusion_accumulators.begin(); it != fusion_accumulators.end(); ++it) {
-            fused_top_k.insert(it->second, it->first);
+            result_fusion query_fusion(fusion_type, fusion_k, fusion_algo);
+            raw_results[idx] = query_fusion(
+                interleaved_multi_query_fun(queries[idx], shared ? &*shared : nullptr));
+        });
+    } else {
+        for (auto const &m_query : queries) {
+            auto mq_results = multi_query_fun(m_query);
+            raw_results[query_idx] = fusion(mq_results);
+            ++query_idx;
         }
-        fused_top_k.finalize();
-        raw_results[query_idx] = fused_top_k.topk();
-        ++query_idx;
     }
  
     auto end_batch = std::chrono::steady_clock::now();
@@ -186,6 +274,12 @@ void evaluate_queries(const std::string &index_filename,
         std::chrono::duration_cast<std::chrono::milliseconds>(end_print - start_batch).count();
     spdlog::info("Time taken to process queries: {}ms", batch_ms);
     spdlog::info("Time taken to process queries with printing: {}ms", batch_with_print_ms);
+    auto executor_stats = executor.stats();
+    spdlog::info("Executor: {} tasks on {} workers, {} stolen, {:.1f}% busy",
+                 executor_stats.tasks,
+                 executor_stats.workers,
+                 executor_stats.steals,
+                 100.0 * executor_stats.utilization);
 }
 
 using wand_raw_index = wand_data<wand_data_raw>;
@@ -209,6 +303,10 @@ int main(int argc, const char **argv)
     std::string run_id = "R0";
     uint64_t k = configuration::get().k;
     uint64_t fusion_k = 100;
+    std::string fusion_name = "combsum";
+    std::string fusion_strategy_name = "accumulator";
+    bool shared_threshold = false;
+    bool interleave = false;
     bool compressed = false;
 
     CLI::App app{"Retrieves query results in TREC format."};
@@ -223,6 +321,17 @@ int main(int argc, const char **argv)
     app.add_flag("--compressed-wand", compressed, "Compressed wand input file");
     app.add_option("-k", k, "k value");
     app.add_option("-z", fusion_k, "k value for final fused list");
+    app.add_option("--fusion", fusion_name, "Fusion method: combsum, combmnz, rrf or borda");
+    app.add_option("--fusion-strategy",
+                   fusion_strategy_name,
+                   "Fusion strategy: accumulator or heap_merge");
+    app.add_flag("--shared-threshold",
+                 shared_threshold,
+                 "Prune variations against a threshold shared through CombSUM fusion");
+    app.add_flag("--interleave",
+                 interleave,
+                 "Interleave the variations of a multi-query on one thread, prefetching their "
+                 "postings, and run multi-queries in parallel");
     auto *terms_opt = app.add_option("--terms", terms_file, "Term lexicon");
     app.add_option("--stopwords", stopwords_filename, "File containing stopwords to ignore")
         ->needs(terms_opt);
@@ -244,6 +353,16 @@ int main(int argc, const char **argv)
         io::for_each_line(std::cin, push_query);
     }
     auto multi_queries = generate_multi_queries(queries);
+    auto fusion_type = fusion_method_from_name(fusion_name);
+    auto fusion_algo = fusion_strategy_from_name(fusion_strategy_name);
+    if (shared_threshold && (fusion_type != fusion_method::combsum || k < fusion_k)) {
+        spdlog::warn("Shared threshold requires CombSUM fusion and k >= z, disabling it");
+        shared_threshold = false;
+    }
+    if (shared_threshold && not scorer::has_non_negative_scores(scorer_name)) {
+        spdlog::warn("Shared threshold requires non-negative scores, disabling it");
+        shared_threshold = false;
+    }
     auto spcs_queries = multi_query_to_spcs(multi_queries); 
 
     /**/
@@ -261,6 +380,10 @@ int main(int argc, const char **argv)
                                                                           query_type,          \
                                                                           k,                   \
                                                                           fusion_k,            \
+                                                                          fusion_type,         \
+                                                                          fusion_algo,         \
+                                                                          shared_threshold,    \
+                                                                          interleave,          \
                                                                           documents_file,      \
                                                                           scorer_name,         \
                                                                           run_id);             \
@@ -273,6 +396,10 @@ int main(int argc, const char **argv)
                                                                       query_type,              \
                                                                       k,                       \
                                                                       fusion_k,                \
+                                                                      fusion_type,             \
+                                                                      fusion_algo,             \
+                                                                      shared_threshold,        \
+                                                                      interleave,              \
                                                                       documents_file,          \
                                                                       scorer_name,             \
                                                                       run_id);                 \
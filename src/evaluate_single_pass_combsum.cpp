@@ -1,4 +1,6 @@
+#include <chrono>
 #include <iostream>
+#include <limits>
 #include <optional>
 
 #include "boost/algorithm/string/classification.hpp"
@@ -6,6 +8,7 @@
 #include <functional>
 
 #include "accumulator/lazy_accumulator.hpp"
+#include "accumulator/simple_accumulator.hpp"
 #include "mio/mmap.hpp"
 #include "spdlog/sinks/stdout_color_sinks.h"
 #include "spdlog/spdlog.h"
@@ -19,10 +22,13 @@
 #include "cursor/block_max_scored_cursor.hpp"
 #include "cursor/max_scored_cursor.hpp"
 #include "cursor/scored_cursor.hpp"
+#include "impact_ordered_index.hpp"
 #include "index_types.hpp"
 #include "io.hpp"
+#include "query/multi_query_thresholds.hpp"
 #include "query/queries.hpp"
 #include "util/util.hpp"
+#include "util/work_stealing_executor.hpp"
 #include "wand_data_compressed.hpp"
 #include "wand_data_raw.hpp"
 
@@ -41,6 +47,8 @@ void evaluate_queries(const std::string &index_filename,
                       std::string const &type,
                       std::string const &query_type,
                       uint64_t k,
+                      size_t num_ranges,
+                      saat_options const &saat,
                       std::string const &documents_filename,
                       std::string const &scorer_name,
                       std::string const &run_id = "R0",
@@ -65,53 +73,127 @@ void evaluate_queries(const std::string &index_filename,
         mapper::map(wdata, md, mapper::map_flags::warmup);
     }
 
-    std::function<std::vector<std::pair<float, uint64_t>>(Query)> query_fun;
+    std::vector<Threshold> thresholds(queries.size(), 0.0);
+    if (thresholds_filename) {
+        try {
+            thresholds = read_thresholds(*thresholds_filename, queries.size());
+        } catch (std::invalid_argument const &err) {
+            spdlog::error("{}", err.what());
+            std::exit(1);
+        }
+    }
+
+    impact_ordered_index impact_index;
+    mio::mmap_source mi;
+    if (saat.index_filename) {
+        std::error_code error;
+        mi.map(*saat.index_filename, error);
+        if (error) {
+            spdlog::error("error mapping file: {}, exiting...", error.message());
+            std::abort();
+        }
+        mapper::map(impact_index, mi);
+        if (auto term = find_missing_term(impact_index, queries); term) {
+            spdlog::error("Term {} is not in the impact-ordered index", *term);
+            std::exit(1);
+        }
+    }
+
+    std::unique_ptr<work_stealing_executor> executor;
+    if (num_ranges > 1) {
+        executor = std::make_unique<work_stealing_executor>();
+        spdlog::info("Splitting queries into {} ranges on {} worker threads",
+                     num_ranges,
+                     executor->size());
+    }
+
+    std::function<std::vector<std::pair<float, uint64_t>>(Query, Threshold)> query_fun;
+    std::function<std::vector<std::pair<float, uint64_t>>(Query, Threshold)> range_fun;
 
     if (query_type == "wand" && wand_data_filename) {
-        query_fun = [&](Query query) {
+        query_fun = [&](Query query, Threshold t) {
             topk_queue topk(k);
+            topk.set_threshold(t);
             wand_query wand_q(topk);
             wand_q.multi_query(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
             topk.finalize();
             return topk.topk();
         };
+        range_fun = parallel_range_fun<wand_query>(
+            index, wdata, *scorer, executor.get(), k, num_ranges);
     } else if (query_type == "block_max_wand" && wand_data_filename) {
-        query_fun = [&](Query query) {
+        query_fun = [&](Query query, Threshold t) {
             topk_queue topk(k);
+            topk.set_threshold(t);
             block_max_wand_query block_max_wand_q(topk);
             block_max_wand_q.multi_query(make_block_max_scored_cursors(index, wdata, *scorer, query),
                              index.num_docs());
             topk.finalize();
             return topk.topk();
         };
+        range_fun = parallel_range_fun<block_max_wand_query>(
+            index, wdata, *scorer, executor.get(), k, num_ranges);
     } else if (query_type == "block_max_maxscore" && wand_data_filename) {
-        query_fun = [&](Query query) {
+        query_fun = [&](Query query, Threshold t) {
             topk_queue topk(k);
+            topk.set_threshold(t);
             block_max_maxscore_query block_max_maxscore_q(topk);
             block_max_maxscore_q.multi_query(make_block_max_scored_cursors(index, wdata, *scorer, query),
                                  index.num_docs());
             topk.finalize();
             return topk.topk();
         };
+        range_fun = parallel_range_fun<block_max_maxscore_query>(
+            index, wdata, *scorer, executor.get(), k, num_ranges);
     } else if (query_type == "ranked_or" && wand_data_filename) {
-        query_fun = [&](Query query) {
+        query_fun = [&](Query query, Threshold t) {
             topk_queue topk(k);
+            topk.set_threshold(t);
             ranked_or_query ranked_or_q(topk);
             ranked_or_q.multi_query(make_scored_cursors(index, *scorer, query), index.num_docs());
             topk.finalize();
             return topk.topk();
         };
+        range_fun = parallel_range_fun<ranked_or_query>(
+            index, wdata, *scorer, executor.get(), k, num_ranges);
     } else if (query_type == "maxscore" && wand_data_filename) {
-        query_fun = [&](Query query) {
+        query_fun = [&](Query query, Threshold t) {
             topk_queue topk(k);
+            topk.set_threshold(t);
             maxscore_query maxscore_q(topk);
             maxscore_q.multi_query(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
             topk.finalize();
             return topk.topk();
         };
+        range_fun = parallel_range_fun<maxscore_query>(
+            index, wdata, *scorer, executor.get(), k, num_ranges);
+    } else if (query_type == "ranked_or_taat" && wand_data_filename) {
+        query_fun = [&](Query query, Threshold t) {
+            Simple_Accumulator accumulator(index.num_docs());
+            topk_queue topk(k);
+            topk.set_threshold(t);
+            ranked_or_taat_query ranked_or_taat_q(topk);
+            ranked_or_taat_q.multi_query(
+                make_scored_cursors(index, *scorer, query), index.num_docs(), accumulator);
+            topk.finalize();
+            return topk.topk();
+        };
+    } else if (query_type == "saat" && saat.index_filename) {
+        query_fun = [&](Query query, Threshold t) {
+            Simple_Accumulator accumulator(impact_index.num_docs());
+            topk_queue topk(k);
+            topk.set_threshold(t);
+            saat_query saat_q(topk, saat.postings_budget, saat.time());
+            saat_q(impact_index, query_term_weights(query), accumulator);
+            topk.finalize();
+            return topk.topk();
+        };
     } else {
         spdlog::error("Unsupported query type: {}", query_type);
     }
+    if (num_ranges > 1 && range_fun) {
+        query_fun = range_fun;
+    }
 
     auto source = std::make_shared<mio::mmap_source>(documents_filename.c_str());
     auto docmap = Payload_Vector<>::from(*source);
@@ -119,10 +201,23 @@ void evaluate_queries(const std::string &index_filename,
     std::vector<std::vector<std::pair<float, uint64_t>>> raw_results(queries.size());
     auto start_batch = std::chrono::steady_clock::now();
     tbb::parallel_for(size_t(0), queries.size(), [&, query_fun](size_t query_idx) {
-        raw_results[query_idx] = query_fun(queries[query_idx]);
+        raw_results[query_idx] = query_fun(queries[query_idx], thresholds[query_idx]);
     });
     auto end_batch = std::chrono::steady_clock::now();
 
+    if (thresholds_filename) {
+        size_t primed = 0;
+        size_t short_topk = 0;
+        for (size_t query_idx = 0; query_idx < queries.size(); ++query_idx) {
+            if (thresholds[query_idx] > 0.0) {
+                primed += 1;
+                short_topk += raw_results[query_idx].size() < k ? 1 : 0;
+            }
+        }
+        spdlog::info(
+            "Primed {} queries, {} left with fewer than {} results", primed, short_topk, k);
+    }
+
     for (size_t query_idx = 0; query_idx < raw_results.size(); ++query_idx) {
         auto results = raw_results[query_idx];
         auto qid = queries[query_idx].id;
@@ -165,6 +260,8 @@ int main(int argc, const char **argv)
     std::optional<std::string> stemmer = std::nullopt;
     std::string run_id = "R0";
     uint64_t k = configuration::get().k;
+    size_t num_ranges = 0;
+    saat_options saat;
     size_t threads = std::thread::hardware_concurrency();
     bool compressed = false;
 
@@ -180,6 +277,12 @@ int main(int argc, const char **argv)
     app.add_option("--threads", threads, "Thread Count");
     app.add_flag("--compressed-wand", compressed, "Compressed wand input file");
     app.add_option("-k", k, "k value");
+    app.add_option("-T,--thresholds", thresholds_filename, "Thresholds file");
+    app.add_option(
+        "--ranges", num_ranges, "Split each query into docid ranges processed in parallel");
+    app.add_option("--impact-index", saat.index_filename, "Impact-ordered index for saat");
+    app.add_option("--postings-budget", saat.postings_budget, "Postings processed by saat");
+    app.add_option("--time-budget", saat.time_budget, "Time budget of saat in microseconds");
     auto *terms_opt = app.add_option("--terms", terms_file, "Term lexicon");
     app.add_option("--stopwords", stopwords_filename, "File containing stopwords to ignore")
         ->needs(terms_opt);
@@ -220,6 +323,8 @@ int main(int argc, const char **argv)
                                                                           type,                \
                                                                           query_type,          \
                                                                           k,                   \
+                                                                          num_ranges,          \
+                                                                          saat,                \
                                                                           documents_file,      \
                                                                           scorer_name,         \
                                                                           run_id);             \
@@ -231,6 +336,8 @@ int main(int argc, const char **argv)
                                                                       type,                    \
                                                                       query_type,              \
                                                                       k,                       \
+                                                                      num_ranges,              \
+                                                                      saat,                    \
                                                                       documents_file,          \
                                                                       scorer_name,             \
                                                                       run_id);                 \
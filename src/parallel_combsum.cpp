@@ -15,14 +15,21 @@
 #include "mappable/mapper.hpp"
 
 #include "accumulator/lazy_accumulator.hpp"
+#include "buffered_topk_queue.hpp"
 #include "cursor/block_max_scored_cursor.hpp"
 #include "cursor/cursor.hpp"
 #include "cursor/max_scored_cursor.hpp"
 #include "cursor/scored_cursor.hpp"
 #include "index_types.hpp"
+#include "query/fused_threshold.hpp"
+#include "query/fusion.hpp"
 #include "query/queries.hpp"
+#include "query/query_context.hpp"
+#include "query/result_cache.hpp"
+#include "query/variation_pruning.hpp"
 #include "timer.hpp"
 #include "util/util.hpp"
+#include "util/work_stealing_executor.hpp"
 #include "wand_data_compressed.hpp"
 #include "wand_data_raw.hpp"
 
@@ -32,16 +39,11 @@
 using namespace pisa;
 using ranges::views::enumerate;
 
-void join_thread(std::thread& t) {
-    t.join();
-}
-
 template <typename Functor>
 void extract_times(Functor query_func,
                    std::vector<multi_query> const &queries,
                    std::string const &index_type,
                    std::string const &query_type,
-                   size_t fusion_k,
                    size_t runs,
                    std::ostream &os)
 {
@@ -49,36 +51,8 @@ void extract_times(Functor query_func,
     
     for (auto const & m_query : queries) {
         for (size_t i = 0; i < runs; ++i) {
-               
-            topk_queue fused_top_k(fusion_k);
-            std::unordered_map<uint64_t, float> fusion_accumulators;
-            std::vector<std::thread> query_threads;
-            std::vector<std::vector<std::pair<float, uint64_t>>> raw_results(m_query.size());
- 
             double tick = get_time_usecs();
-            size_t idx = 0;
-            for (auto const & query : m_query) {
-                
-                auto q_thread = std::thread( [&, idx] {            
-                    raw_results[idx] = query_func(query);
-                });
-
-                query_threads.emplace_back(std::move(q_thread));
-                ++idx;
-            }
-            
-            std::for_each(query_threads.begin(), query_threads.end(), join_thread);
-
-            // CombSUM fusion
-            for (auto const & result : raw_results) {
-                for (auto const & scored_pair : result) {
-                    fusion_accumulators[scored_pair.second] += scored_pair.first; 
-                }
-            } 
-            // Now create fused top-k
-            for (auto it = fusion_accumulators.begin(); it != fusion_accumulators.end(); ++it) {
-                fused_top_k.insert(it->second, it->first);
-            }
+            query_func(m_query);
             double tock = get_time_usecs();
             double usecs = tock-tick;
             times[i] = usecs;
@@ -94,45 +68,16 @@ void op_perftest(Functor query_func,
                  std::vector<multi_query> const &queries,
                  std::string const &index_type,
                  std::string const &query_type,
-                 size_t fusion_k,
                  size_t runs)
 {
 
     std::vector<double> query_times;
-    topk_queue fused_top_k(fusion_k);
-    std::unordered_map<uint64_t, float> fusion_accumulators;
 
     for (size_t run = 0; run <= runs; ++run) {
         for (auto const & m_query : queries) {
                    
-            std::vector<std::thread> query_threads;
-            std::vector<std::vector<std::pair<float, uint64_t>>> raw_results(m_query.size());
- 
             double tick = get_time_usecs();
-            size_t idx = 0;
-            for (auto const & query : m_query) {
-                
-                auto q_thread = std::thread( [&, idx] {            
-                    raw_results[idx] = query_func(query);
-                });
-
-                query_threads.emplace_back(std::move(q_thread));
-                ++idx;
-            }
-            
-            std::for_each(query_threads.begin(), query_threads.end(), join_thread);
-
-            // CombSUM fusion
-            for (auto const & result : raw_results) {
-                for (auto const & scored_pair : result) {
-                    fusion_accumulators[scored_pair.second] += scored_pair.first; 
-                }
-            } 
-            // Now create fused top-k
-            for (auto it = fusion_accumulators.begin(); it != fusion_accumulators.end(); ++it) {
-                fused_top_k.insert(it->second, it->first);
-            }
-            fused_top_k.finalize();
+            query_func(m_query);
  
             double tock = get_time_usecs();
             double usecs = tock-tick;            
@@ -175,8 +120,13 @@ void perftest(const std::string &index_filename,
               std::string const &query_type,
               uint64_t k,
               uint64_t fusion_k,
+              fusion_method fusion_type,
+              fusion_strategy fusion_algo,
+              bool shared_threshold,
               std::string const &scorer_name,
-              bool extract)
+              bool extract,
+              bool static_scorer,
+              std::size_t cache_budget)
 {
     IndexType index;
     spdlog::info("Loading index from {}", index_filename);
@@ -220,69 +170,166 @@ void perftest(const std::string &index_filename,
         }
     }
 
-    auto scorer = scorer::from_name(scorer_name, wdata);
-
     spdlog::info("Performing {} queries", type);
     spdlog::info("K: {}", k);
 
-    for (auto &&t : query_types) {
-        spdlog::info("Query type: {}", t);
-        std::function<std::vector<std::pair<float, uint64_t>>(Query)> query_fun;
-
-        if (t == "wand" && wand_data_filename) {
-            query_fun = [&](Query query) {
-                topk_queue topk(k);
-                wand_query wand_q(topk);
-                wand_q(make_max_scored_cursors(index, wdata, *scorer, query),
-                       index.num_docs());
-                topk.finalize();
-                return topk.topk();
-            };
-        } else if (t == "block_max_wand" && wand_data_filename) {
-            query_fun = [&](Query query) {
-                topk_queue topk(k);
-                block_max_wand_query block_max_wand_q(topk);
-                block_max_wand_q(make_block_max_scored_cursors(index, wdata, *scorer, query),
-                                 index.num_docs());
-                topk.finalize();
-                return topk.topk();
-            };
-        } else if (t == "block_max_maxscore" && wand_data_filename) {
-            query_fun = [&](Query query) {
-                topk_queue topk(k);
-                block_max_maxscore_query block_max_maxscore_q(topk);
-                block_max_maxscore_q(
-                    make_block_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.topk();
-            };
-        } else if (t == "ranked_or" && wand_data_filename) {
-            query_fun = [&](Query query) {
-                topk_queue topk(k);
-                ranked_or_query ranked_or_q(topk);
-                ranked_or_q(make_scored_cursors(index, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.topk();
-            };
-        } else if (t == "maxscore" && wand_data_filename) {
-            query_fun = [&](Query query) {
-                topk_queue topk(k);
-                maxscore_query maxscore_q(topk);
-                maxscore_q(make_max_scored_cursors(index, wdata, *scorer, query),
+    work_stealing_executor executor;
+    spdlog::info("Running variations on {} worker threads", executor.size());
+
+    // `scorer` is either a type-erased runtime scorer or a `static_scorer`.
+    auto run_queries = [&](auto const &scorer) {
+        for (auto &&t : query_types) {
+            spdlog::info("Query type: {}", t);
+            // Called by the executor threads at once, each with its own context.
+            std::function<std::vector<std::pair<float, uint64_t>>(
+                Query const &, fused_threshold *, size_t)>
+                query_fun;
+            std::function<std::vector<std::vector<std::pair<float, uint64_t>>>(multi_query const &)>
+                multi_query_fun;
+
+            if (t == "wand" && wand_data_filename) {
+                query_fun = [&](Query const &query, fused_threshold *shared, size_t variation) {
+                    auto &context = thread_query_context();
+                    auto &topk = context.topk(k);
+                    shared_threshold_query<wand_query> wand_q(topk, shared, variation, &context);
+                    wand_q(make_max_scored_cursors(context, index, wdata, scorer, query),
                            index.num_docs());
-                topk.finalize();
-                return topk.topk();
-            };
-        } else {
-            spdlog::error("Unsupported query type: {}", t);
-            break;
-        }
+                    topk.finalize();
+                    return topk.topk();
+                };
+            } else if (t == "block_max_wand" && wand_data_filename) {
+                query_fun = [&](Query const &query, fused_threshold *shared, size_t variation) {
+                    auto &context = thread_query_context();
+                    auto &topk = context.topk(k);
+                    shared_threshold_query<block_max_wand_query> block_max_wand_q(
+                        topk, shared, variation, &context);
+                    block_max_wand_q(
+                        make_block_max_scored_cursors(context, index, wdata, scorer, query),
+                        index.num_docs());
+                    topk.finalize();
+                    return topk.topk();
+                };
+            } else if (t == "block_max_maxscore" && wand_data_filename) {
+                query_fun = [&](Query const &query, fused_threshold *shared, size_t variation) {
+                    auto &context = thread_query_context();
+                    auto &topk = context.topk(k);
+                    shared_threshold_query<block_max_maxscore_query> block_max_maxscore_q(
+                        topk, shared, variation, &context);
+                    block_max_maxscore_q(
+                        make_block_max_scored_cursors(context, index, wdata, scorer, query),
+                        index.num_docs());
+                    topk.finalize();
+                    return topk.topk();
+                };
+            } else if (t == "ranked_or" && wand_data_filename) {
+                query_fun = [&](Query const &query, fused_threshold *shared, size_t variation) {
+                    auto &context = thread_query_context();
+                    auto &topk = context.topk(k);
+                    shared_threshold_query<ranked_or_query> ranked_or_q(topk, shared, variation);
+                    ranked_or_q(make_scored_cursors(context, index, scorer, query),
+                                index.num_docs());
+                    topk.finalize();
+                    return topk.topk();
+                };
+            } else if (t == "maxscore" && wand_data_filename) {
+                query_fun = [&](Query const &query, fused_threshold *shared, size_t variation) {
+                    auto &context = thread_query_context();
+                    auto &topk = context.topk(k);
+                    shared_threshold_query<maxscore_query> maxscore_q(
+                        topk, shared, variation, &context);
+                    maxscore_q(make_max_scored_cursors(context, index, wdata, scorer, query),
+                               index.num_docs());
+                    topk.finalize();
+                    return topk.topk();
+                };
+            } else if (t == "shared_maxscore" && wand_data_filename) {
+                // All variations in one pass, decoding each distinct term once.
+                multi_query_fun = [&](multi_query const &m_query) {
+                    auto shared = multi_query_to_shared(m_query);
+                    std::vector<buffered_topk_queue> topks(m_query.size(), buffered_topk_queue(k));
+                    shared_maxscore_query shared_maxscore_q(topks);
+                    shared_maxscore_q(
+                        make_max_scored_cursors(index, wdata, scorer, shared.as_query()),
+                        shared.variations,
+                        index.num_docs());
+                    std::vector<std::vector<std::pair<float, uint64_t>>> results;
+                    for (auto &topk : topks) {
+                        topk.finalize();
+                        results.push_back(topk.topk());
+                    }
+                    return results;
+                };
+            } else {
+                spdlog::error("Unsupported query type: {}", t);
+                break;
+            }
         
-        if (extract) {
-            extract_times(query_fun, queries, type, t, fusion_k, 2, std::cout);
-        } else {
-            op_perftest(query_fun, queries, type, t, fusion_k, 2);
+            if (not multi_query_fun) {
+                multi_query_fun = [&](multi_query const &m_query) {
+                    std::optional<fused_threshold> shared;
+                    if (shared_threshold) {
+                        std::vector<float> upper_bounds;
+                        for (auto const &query : m_query) {
+                            upper_bounds.push_back(
+                                variation_upper_bound(wdata, query_term_weights(query)));
+                        }
+                        shared.emplace(std::move(upper_bounds));
+                    }
+                    std::vector<std::vector<std::pair<float, uint64_t>>> results(m_query.size());
+                    executor.parallel_for(m_query.size(), [&](size_t idx) {
+                        results[idx] = query_fun(m_query[idx], shared ? &*shared : nullptr, idx);
+                    });
+                    return results;
+                };
+            }
+
+            result_fusion fusion(fusion_type, fusion_k, fusion_algo);
+            // Fuses the results of a multi-query, from the cache if there is one, and returns their
+            // number.
+            std::function<std::size_t(multi_query const &)> fused_fun;
+            std::optional<multi_query_cache> cache;
+            if (cache_budget > 0) {
+                cache.emplace(cache_budget);
+                fused_fun = [&](multi_query const &m_query) {
+                    return (*cache)(m_query, k, fusion, [&](auto const &missing, auto &results) {
+                        multi_query uncached;
+                        for (auto idx : missing) {
+                            uncached.push_back(m_query[idx]);
+                        }
+                        auto uncached_results = multi_query_fun(uncached);
+                        for (size_t pos = 0; pos < missing.size(); ++pos) {
+                            results[missing[pos]] = std::move(uncached_results[pos]);
+                        }
+                    }).size();
+                };
+            } else {
+                fused_fun = [&](multi_query const &m_query) {
+                    return fusion(multi_query_fun(m_query)).size();
+                };
+            }
+
+            executor.reset_stats();
+            if (extract) {
+                extract_times(fused_fun, queries, type, t, 2, std::cout);
+            } else {
+                op_perftest(fused_fun, queries, type, t, 2);
+            }
+            if (cache) {
+                cache->log_stats();
+            }
+            auto executor_stats = executor.stats();
+            spdlog::info("Executor: {} tasks on {} workers, {} stolen, {:.1f}% busy",
+                         executor_stats.tasks,
+                         executor_stats.workers,
+                         executor_stats.steals,
+                         100.0 * executor_stats.utilization);
         }
+    };
+
+    if (static_scorer) {
+        scorer::with_static_scorer(scorer_name, wdata, run_queries);
+    } else {
+        run_queries(*scorer::from_name(scorer_name, wdata));
     }
 }
 
@@ -303,9 +350,16 @@ int main(int argc, const char **argv)
     std::optional<std::string> stemmer = std::nullopt;
     uint64_t k = configuration::get().k;
     uint64_t fusion_k = 100;
+    std::string fusion_name = "combsum";
+    std::string fusion_strategy_name = "accumulator";
+    bool shared_threshold = false;
     bool compressed = false;
     bool extract = false;
+    bool static_scorer = false;
     bool silent = false;
+    std::size_t cache_budget = 0;
+    variation_pruning pruning;
+    std::optional<std::string> pruning_report;
 
     CLI::App app{"queries - a tool for performing queries on an index."};
     app.set_config("--config", "", "Configuration .ini file", false);
@@ -318,12 +372,37 @@ int main(int argc, const char **argv)
     app.add_flag("--compressed-wand", compressed, "Compressed wand input file");
     app.add_option("-k", k, "k value for per-variation top-k");
     app.add_option("-z", fusion_k, "k value for final fused list");
+    app.add_option("--fusion", fusion_name, "Fusion method: combsum, combmnz, rrf or borda");
+    app.add_option("--fusion-strategy",
+                   fusion_strategy_name,
+                   "Fusion strategy: accumulator or heap_merge");
+    app.add_flag("--shared-threshold",
+                 shared_threshold,
+                 "Prune variations against a threshold shared through CombSUM fusion");
     app.add_option("-T,--thresholds", thresholds_filename, "k value");
     auto *terms_opt = app.add_option("--terms", terms_file, "Term lexicon");
     app.add_option("--stopwords", stopwords_filename, "File containing stopwords to ignore")
         ->needs(terms_opt);
     app.add_option("--stemmer", stemmer, "Stemmer type")->needs(terms_opt);
     app.add_flag("--extract", extract, "Extract individual query times");
+    app.add_flag("--static-scorer",
+                 static_scorer,
+                 "Dispatch the scorer at compile time so that operators can inline it");
+    app.add_option("--cache-budget",
+                   cache_budget,
+                   "Cache fused and per-variation results in this many bytes");
+    app.add_flag("--group-variations",
+                 pruning.group,
+                 "Merge identical variations into one weighted by their number");
+    app.add_option("--min-contribution",
+                   pruning.min_contribution,
+                   "Drop variations bounded below this fraction of the best one of the topic");
+    app.add_option("--max-variations", pruning.max_variations, "Keep at most this many variations");
+    app.add_option("--max-postings",
+                   pruning.max_postings,
+                   "Keep as many variations as fit in this many postings per topic");
+    app.add_option(
+        "--pruning-report", pruning_report, "Write the variations pruned from each topic here");
     app.add_flag("--silent", silent, "Suppress logging");
     CLI11_PARSE(app, argc, argv);
 
@@ -345,6 +424,34 @@ int main(int argc, const char **argv)
         io::for_each_line(std::cin, parse_query);
     }
     auto multi_queries = generate_multi_queries(queries);
+    auto fusion_type = fusion_method_from_name(fusion_name);
+    auto fusion_algo = fusion_strategy_from_name(fusion_strategy_name);
+    if (shared_threshold && (fusion_type != fusion_method::combsum || k < fusion_k)) {
+        spdlog::warn("Shared threshold requires CombSUM fusion and k >= z, disabling it");
+        shared_threshold = false;
+    }
+    if (shared_threshold && not scorer::has_non_negative_scores(scorer_name)) {
+        spdlog::warn("Shared threshold requires non-negative scores, disabling it");
+        shared_threshold = false;
+    }
+    if (shared_threshold && cache_budget > 0) {
+        spdlog::warn("Lists pruned by a shared threshold cannot be cached, disabling it");
+        shared_threshold = false;
+    }
+    if (pruning.group && fusion_type != fusion_method::combsum) {
+        spdlog::warn("Grouping variations requires CombSUM fusion, disabling it");
+        pruning.group = false;
+    }
+    pruning.non_negative_scores = scorer::has_non_negative_scores(scorer_name);
+    if (pruning.enabled() && not wand_data_filename) {
+        spdlog::warn("Pruning variations requires wand data, keeping all of them");
+    } else if (pruning.enabled() && compressed) {
+        multi_queries = prune_with_wand_data<wand_uniform_index>(
+            *wand_data_filename, multi_queries, pruning, pruning_report);
+    } else if (pruning.enabled()) {
+        multi_queries = prune_with_wand_data<wand_raw_index>(
+            *wand_data_filename, multi_queries, pruning, pruning_report);
+    }
 
     /**/
     if (false) {
@@ -361,8 +468,13 @@ int main(int argc, const char **argv)
                                                                   query_type,          \
                                                                   k,                   \
                                                                   fusion_k,            \
+                                                                  fusion_type,         \
+                                                                  fusion_algo,         \
+                                                                  shared_threshold,    \
                                                                   scorer_name,         \
-                                                                  extract);            \
+                                                                  extract,             \
+                                                                  static_scorer,       \
+                                                                  cache_budget);       \
         } else {                                                                       \
             perftest<BOOST_PP_CAT(T, _index), wand_raw_index>(index_filename,          \
                                                               wand_data_filename,      \
@@ -372,8 +484,13 @@ int main(int argc, const char **argv)
                                                               query_type,              \
                                                               k,                       \
                                                               fusion_k,                \
+                                                              fusion_type,             \
+                                                              fusion_algo,             \
+                                                              shared_threshold,        \
                                                               scorer_name,             \
-                                                              extract);                \
+                                                              extract,                 \
+                                                              static_scorer,           \
+                                                              cache_budget);           \
         }                                                                              \
         /**/
 
@@ -0,0 +1,349 @@
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <unordered_set>
+
+#include <mio/mmap.hpp>
+#include <spdlog/sinks/null_sink.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+
+#include "mappable/mapper.hpp"
+
+#include "accumulator/simple_accumulator.hpp"
+#include "cursor/block_max_scored_cursor.hpp"
+#include "cursor/max_scored_cursor.hpp"
+#include "cursor/scored_cursor.hpp"
+#include "index_types.hpp"
+#include "io.hpp"
+#include "query/fusion.hpp"
+#include "query/queries.hpp"
+#include "query/query_planner.hpp"
+#include "timer.hpp"
+#include "util/do_not_optimize_away.hpp"
+#include "util/util.hpp"
+#include "util/work_stealing_executor.hpp"
+#include "wand_data_compressed.hpp"
+#include "wand_data_raw.hpp"
+
+#include "CLI/CLI.hpp"
+#include "scorer/scorer.hpp"
+
+using namespace pisa;
+
+// Runs a multi-query with any plan, returning the size of its fused top-k.
+template <typename Index, typename WandType, typename Scorer>
+class plan_runner {
+   public:
+    plan_runner(Index const &index, WandType const &wdata, Scorer const &scorer, uint64_t k)
+        : m_index(index),
+          m_wdata(wdata),
+          m_scorer(scorer),
+          m_k(k),
+          m_accumulator(index.num_docs()),
+          m_fusion(fusion_method::combsum, k)
+    {}
+
+    uint64_t operator()(query_plan plan, multi_query const &m_query)
+    {
+        topk_queue topk(m_k);
+        switch (plan) {
+        case query_plan::spcs_maxscore: {
+            maxscore_query maxscore_q(topk);
+            maxscore_q.multi_query(
+                make_max_scored_cursors(m_index, m_wdata, m_scorer, fuse_variations(m_query)),
+                m_index.num_docs());
+            break;
+        }
+        case query_plan::spcs_block_max_wand: {
+            block_max_wand_query block_max_wand_q(topk);
+            block_max_wand_q.multi_query(
+                make_block_max_scored_cursors(
+                    m_index, m_wdata, m_scorer, fuse_variations(m_query)),
+                m_index.num_docs());
+            break;
+        }
+        case query_plan::parallel_maxscore: {
+            std::vector<std::vector<std::pair<float, uint64_t>>> results(m_query.size());
+            m_executor.parallel_for(m_query.size(), [&](size_t idx) {
+                topk_queue variation_topk(m_k);
+                maxscore_query maxscore_q(variation_topk);
+                maxscore_q.multi_query(
+                    make_max_scored_cursors(m_index, m_wdata, m_scorer, m_query[idx]),
+                    m_index.num_docs());
+                variation_topk.finalize();
+                results[idx] = variation_topk.topk();
+            });
+            return m_fusion(results).size();
+        }
+        case query_plan::taat: {
+            ranked_or_taat_query ranked_or_taat_q(topk);
+            ranked_or_taat_q.multi_query(
+                make_scored_cursors(m_index, m_scorer, fuse_variations(m_query)),
+                m_index.num_docs(),
+                m_accumulator);
+            break;
+        }
+        }
+        topk.finalize();
+        return topk.topk().size();
+    }
+
+    // Mean time of `runs` runs of `plan` on `m_query` in microseconds, after an untimed one.
+    double time(query_plan plan, multi_query const &m_query, size_t runs)
+    {
+        do_not_optimize_away((*this)(plan, m_query));
+        double total = 0;
+        for (size_t run = 0; run < runs; ++run) {
+            total += run_with_timer<std::chrono::microseconds>([&]() {
+                         do_not_optimize_away((*this)(plan, m_query));
+                     }).count();
+        }
+        return total / runs;
+    }
+
+   private:
+    Index const &m_index;
+    WandType const &m_wdata;
+    Scorer const &m_scorer;
+    uint64_t m_k;
+    Simple_Accumulator m_accumulator;
+    result_fusion m_fusion;
+    work_stealing_executor m_executor;
+};
+
+template <typename IndexType, typename WandType>
+void plan_queries(const std::string &index_filename,
+                  const std::string &wand_data_filename,
+                  const std::vector<multi_query> &queries,
+                  std::string const &type,
+                  std::string const &scorer_name,
+                  uint64_t k,
+                  std::optional<std::string> const &model_filename,
+                  query_planner planner,
+                  bool calibrate,
+                  size_t runs)
+{
+    IndexType index;
+    spdlog::info("Loading index from {}", index_filename);
+    mio::mmap_source m(index_filename.c_str());
+    mapper::map(index, m);
+
+    spdlog::info("Warming up posting lists");
+    std::unordered_set<term_id_type> warmed_up;
+    for (auto const &mq : queries) {
+        for (auto const &q : mq) {
+            for (auto t : q.terms) {
+                if (!warmed_up.count(t)) {
+                    index.warmup(t);
+                    warmed_up.insert(t);
+                }
+            }
+        }
+    }
+
+    WandType wdata;
+    mio::mmap_source md;
+    std::error_code error;
+    md.map(wand_data_filename, error);
+    if (error) {
+        std::cerr << "error mapping file: " << error.message() << ", exiting..." << std::endl;
+        throw std::runtime_error("Error opening file");
+    }
+    mapper::map(wdata, md, mapper::map_flags::warmup);
+
+    auto scorer = scorer::from_name(scorer_name, wdata);
+    plan_runner runner(index, wdata, *scorer, k);
+    spdlog::info("Performing {} queries", type);
+    spdlog::info("K: {}", k);
+
+    std::vector<plan_sample> samples;
+    std::array<size_t, num_query_plans> chosen{};
+    std::vector<double> query_times;
+    write_plan_log_header(std::cout);
+    for (auto const &m_query : queries) {
+        auto qid = m_query.front().id.value_or("");
+        auto features = plan_features::from_query(m_query, wdata, k);
+        if (calibrate) {
+            for (size_t p = 0; p < num_query_plans; ++p) {
+                auto plan = static_cast<query_plan>(p);
+                auto usecs = runner.time(plan, m_query, runs);
+                samples.push_back({plan, features, usecs});
+                write_plan_log_line(std::cout, qid, plan, 0, usecs, features);
+            }
+        } else {
+            auto plan = planner.choose(features);
+            auto usecs = runner.time(plan, m_query, runs);
+            chosen[static_cast<size_t>(plan)] += 1;
+            query_times.push_back(usecs);
+            write_plan_log_line(
+                std::cout, qid, plan, planner.predict(plan, features), usecs, features);
+        }
+    }
+
+    if (calibrate) {
+        planner = query_planner::fit(samples);
+        std::ofstream os(*model_filename);
+        planner.write(os);
+        spdlog::info("Wrote model fitted to {} runs to {}", samples.size(), *model_filename);
+        return;
+    }
+    for (size_t p = 0; p < num_query_plans; ++p) {
+        spdlog::info("{}: {} queries", query_plan_name(static_cast<query_plan>(p)), chosen[p]);
+    }
+    if (not query_times.empty()) {
+        std::sort(query_times.begin(), query_times.end());
+        double avg =
+            std::accumulate(query_times.begin(), query_times.end(), double()) / query_times.size();
+        double q50 = query_times[query_times.size() / 2];
+        double q90 = query_times[90 * query_times.size() / 100];
+        double q95 = query_times[95 * query_times.size() / 100];
+        spdlog::info("---- {} planned", type);
+        spdlog::info("Mean: {}", avg);
+        spdlog::info("50% quantile: {}", q50);
+        spdlog::info("90% quantile: {}", q90);
+        spdlog::info("95% quantile: {}", q95);
+        stats_line()("type", type)("query", "planned")("avg", avg)("q50", q50)("q90", q90)(
+            "q95", q95);
+    }
+}
+
+using wand_raw_index = wand_data<wand_data_raw>;
+using wand_uniform_index = wand_data<wand_data_compressed>;
+
+int main(int argc, const char **argv)
+{
+    std::string type;
+    std::string index_filename;
+    std::string wand_data_filename;
+    std::string scorer_name;
+    std::optional<std::string> terms_file;
+    std::optional<std::string> query_filename;
+    std::optional<std::string> stopwords_filename;
+    std::optional<std::string> stemmer = std::nullopt;
+    std::optional<std::string> model_filename;
+    std::vector<std::string> train_filenames;
+    uint64_t k = configuration::get().k;
+    size_t runs = 1;
+    bool calibrate = false;
+    bool compressed = false;
+    bool silent = false;
+
+    CLI::App app{"plan_queries - a tool for processing multi-queries with the fastest plan for "
+                 "each, as predicted by a calibrated cost model."};
+    app.set_config("--config", "", "Configuration .ini file", false);
+    app.add_option("-t,--type", type, "Index type");
+    app.add_option("-i,--index", index_filename, "Collection basename");
+    app.add_option("-w,--wand", wand_data_filename, "Wand data filename");
+    app.add_option("-q,--query", query_filename, "Queries filename");
+    app.add_option("-s,--scorer", scorer_name, "Scorer function");
+    app.add_flag("--compressed-wand", compressed, "Compressed wand input file");
+    app.add_option("-k", k, "k value");
+    app.add_option("-m,--model", model_filename, "Cost model, read or written by --calibrate")
+        ->required();
+    auto *calibrate_opt = app.add_flag(
+        "--calibrate", calibrate, "Run every plan on every query and fit the model to them");
+    app.add_option("--train", train_filenames, "Fit the model to the given plan logs instead")
+        ->excludes(calibrate_opt);
+    app.add_option("--runs", runs, "Timed runs of each plan per query");
+    auto *terms_opt = app.add_option("--terms", terms_file, "Term lexicon");
+    app.add_option("--stopwords", stopwords_filename, "File containing stopwords to ignore")
+        ->needs(terms_opt);
+    app.add_option("--stemmer", stemmer, "Stemmer type")->needs(terms_opt);
+    app.add_flag("--silent", silent, "Suppress logging");
+    CLI11_PARSE(app, argc, argv);
+
+    if (silent) {
+        spdlog::set_default_logger(spdlog::create<spdlog::sinks::null_sink_mt>("stderr"));
+    } else {
+        spdlog::set_default_logger(spdlog::stderr_color_mt("stderr"));
+    }
+
+    if (not train_filenames.empty()) {
+        std::vector<plan_sample> samples;
+        for (auto const &filename : train_filenames) {
+            std::ifstream is(filename);
+            if (not is) {
+                spdlog::error("Cannot open plan log {}", filename);
+                return 1;
+            }
+            auto log = read_plan_log(is);
+            samples.insert(samples.end(), log.begin(), log.end());
+        }
+        std::ofstream os(*model_filename);
+        query_planner::fit(samples).write(os);
+        spdlog::info("Wrote model fitted to {} runs to {}", samples.size(), *model_filename);
+        return 0;
+    }
+    if (type.empty() || index_filename.empty() || wand_data_filename.empty()
+        || scorer_name.empty()) {
+        spdlog::error("Planning queries requires --type, --index, --wand and --scorer");
+        return 1;
+    }
+    query_planner planner;
+    if (not calibrate) {
+        std::ifstream is(*model_filename);
+        if (not is) {
+            spdlog::error("Cannot open cost model {}, create it with --calibrate or --train",
+                          *model_filename);
+            return 1;
+        }
+        planner = query_planner::read(is);
+        if (planner.empty()) {
+            spdlog::error("Cost model {} has no fitted plan", *model_filename);
+            return 1;
+        }
+    }
+
+    std::vector<Query> queries;
+    auto parse_query = resolve_query_parser(queries, terms_file, stopwords_filename, stemmer);
+    if (query_filename) {
+        std::ifstream is(*query_filename);
+        io::for_each_line(is, parse_query);
+    } else {
+        io::for_each_line(std::cin, parse_query);
+    }
+    auto multi_queries = generate_multi_queries(queries);
+
+    /**/
+    if (false) {
+#define LOOP_BODY(R, DATA, T)                                                             \
+    }                                                                                     \
+    else if (type == BOOST_PP_STRINGIZE(T))                                               \
+    {                                                                                     \
+        if (compressed) {                                                                 \
+            plan_queries<BOOST_PP_CAT(T, _index), wand_uniform_index>(index_filename,     \
+                                                                      wand_data_filename, \
+                                                                      multi_queries,      \
+                                                                      type,               \
+                                                                      scorer_name,        \
+                                                                      k,                  \
+                                                                      model_filename,     \
+                                                                      planner,            \
+                                                                      calibrate,          \
+                                                                      runs);              \
+        } else {                                                                          \
+            plan_queries<BOOST_PP_CAT(T, _index), wand_raw_index>(index_filename,         \
+                                                                  wand_data_filename,     \
+                                                                  multi_queries,          \
+                                                                  type,                   \
+                                                                  scorer_name,            \
+                                                                  k,                      \
+                                                                  model_filename,         \
+                                                                  planner,                \
+                                                                  calibrate,              \
+                                                                  runs);                  \
+        }                                                                                 \
+        /**/
+
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_INDEX_TYPES);
+#undef LOOP_BODY
+
+    } else {
+        spdlog::error("Unknown type {}", type);
+    }
+}
@@ -17,11 +17,15 @@
 
 #include "accumulator/lazy_accumulator.hpp"
 #include "cursor/block_max_scored_cursor.hpp"
+#include "cursor/block_scored_cursor.hpp"
 #include "cursor/cursor.hpp"
 #include "cursor/max_scored_cursor.hpp"
 #include "cursor/scored_cursor.hpp"
 #include "index_types.hpp"
+#include "query/multi_query_thresholds.hpp"
 #include "query/queries.hpp"
+#include "query/query_context.hpp"
+#include "query/throughput.hpp"
 #include "timer.hpp"
 #include "util/util.hpp"
 #include "wand_data_compressed.hpp"
@@ -113,7 +117,10 @@ void perftest(const std::string &index_filename,
               std::string const &query_type,
               uint64_t k,
               std::string const &scorer_name,
-              bool extract)
+              bool extract,
+              size_t threads,
+              bool static_scorer,
+              bool block_scoring)
 {
     IndexType index;
     spdlog::info("Loading index from {}", index_filename);
@@ -148,136 +155,213 @@ void perftest(const std::string &index_filename,
 
     std::vector<Threshold> thresholds(queries.size(), 0.0);
     if (thresholds_filename) {
-        std::string t;
-        std::ifstream tin(*thresholds_filename);
-        auto t_begin = std::istream_iterator<float>(tin);
-        auto t_end = std::istream_iterator<float>();
-        if(std::distance(t_begin, t_end) != queries.size()) {
-            throw std::invalid_argument("Invalid thresholds file.");
+        try {
+            thresholds = read_thresholds(*thresholds_filename, queries.size());
+        } catch (std::invalid_argument const &err) {
+            spdlog::error("{}", err.what());
+            std::exit(1);
         }
-        std::copy(t_begin , t_end, thresholds.begin());
     }
 
-    auto scorer = scorer::from_name(scorer_name, wdata);
-
     spdlog::info("Performing {} queries", type);
     spdlog::info("K: {}", k);
+    if (block_scoring
+        && not(block_scorable<IndexType>::value && block_term_scorer::supports(scorer_name))) {
+        spdlog::warn("No block scoring for {} with {}, scoring one posting at a time",
+                     type,
+                     scorer_name);
+        block_scoring = false;
+    }
 
-    for (auto &&t : query_types) {
-        spdlog::info("Query type: {}", t);
-        std::function<uint64_t(Query, Threshold)> query_fun;
-        if (t == "and") {
-            query_fun = [&](Query query, Threshold) {
-                and_query and_q;
-                return and_q(make_cursors(index, query), index.num_docs()).size();
-            };
-        } else if (t == "or") {
-            query_fun = [&](Query query, Threshold) {
-                or_query<false> or_q;
-                return or_q(make_cursors(index, query), index.num_docs());
-            };
-        } else if (t == "or_freq") {
-            query_fun = [&](Query query, Threshold) {
-                or_query<true> or_q;
-                return or_q(make_cursors(index, query), index.num_docs());
-            };
-        } else if (t == "wand" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                wand_query wand_q(topk);
-                wand_q(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.size();
-            };
-        } else if (t == "block_max_wand" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                block_max_wand_query block_max_wand_q(topk);
-                block_max_wand_q(make_block_max_scored_cursors(index, wdata, *scorer, query),
+    // `scorer` is either a type-erased runtime scorer or a `static_scorer`.
+    auto run_queries = [&](auto const &scorer) {
+        for (auto &&t : query_types) {
+            spdlog::info("Query type: {}", t);
+            std::function<uint64_t(Query, Threshold)> query_fun;
+            if (t == "and") {
+                query_fun = [&](Query query, Threshold) {
+                    and_query and_q;
+                    return and_q(make_cursors(index, query), index.num_docs()).size();
+                };
+            } else if (t == "or") {
+                query_fun = [&](Query query, Threshold) {
+                    or_query<false> or_q;
+                    return or_q(make_cursors(index, query), index.num_docs());
+                };
+            } else if (t == "or_freq") {
+                query_fun = [&](Query query, Threshold) {
+                    or_query<true> or_q;
+                    return or_q(make_cursors(index, query), index.num_docs());
+                };
+            } else if (t == "wand" && wand_data_filename) {
+                // Copies of the function (one per thread with --threads) own their context.
+                query_fun = [&, context = query_context()](Query const &query,
+                                                           Threshold t) mutable {
+                    auto &topk = context.topk(k);
+                    topk.set_threshold(t);
+                    wand_query wand_q(topk, &context);
+                    wand_q(make_max_scored_cursors(context, index, wdata, scorer, query),
+                           index.num_docs());
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "block_max_wand" && wand_data_filename) {
+                query_fun = [&, context = query_context()](Query const &query,
+                                                           Threshold t) mutable {
+                    auto &topk = context.topk(k);
+                    topk.set_threshold(t);
+                    block_max_wand_query block_max_wand_q(topk, &context);
+                    block_max_wand_q(
+                        make_block_max_scored_cursors(context, index, wdata, scorer, query),
+                        index.num_docs());
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "block_max_maxscore" && wand_data_filename) {
+                query_fun = [&, context = query_context()](Query const &query,
+                                                           Threshold t) mutable {
+                    auto &topk = context.topk(k);
+                    topk.set_threshold(t);
+                    block_max_maxscore_query block_max_maxscore_q(topk, &context);
+                    block_max_maxscore_q(
+                        make_block_max_scored_cursors(context, index, wdata, scorer, query),
+                        index.num_docs());
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "ranked_and" && wand_data_filename) {
+                query_fun = [&, context = query_context()](Query const &query,
+                                                           Threshold t) mutable {
+                    auto &topk = context.topk(k);
+                    topk.set_threshold(t);
+                    ranked_and_query ranked_and_q(topk);
+                    ranked_and_q(make_scored_cursors(context, index, scorer, query),
                                  index.num_docs());
-                topk.finalize();
-                return topk.size();
-            };
-        } else if (t == "block_max_maxscore" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                block_max_maxscore_query block_max_maxscore_q(topk);
-                block_max_maxscore_q(make_block_max_scored_cursors(index, wdata, *scorer, query),
-                                     index.num_docs());
-                topk.finalize();
-                return topk.size();
-            };
-        } else if (t == "ranked_and" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                ranked_and_query ranked_and_q(topk);
-                ranked_and_q(make_scored_cursors(index, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.size();
-            };
-        } else if (t == "block_max_ranked_and" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
-                topk_queue topk(k);
-                topk.set_threshold(t);
-                block_max_ranked_and_query block_max_ranked_and_q(topk);
-                block_max_ranked_and_q(make_block_max_scored_cursors(index, wdata, *scorer, query),
-                                       index.num_docs());
-                topk.finalize();
-                return topk.size();
-            };
-        } else if (t == "ranked_or" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "block_max_ranked_and" && wand_data_filename) {
+                query_fun = [&, context = query_context()](Query const &query,
+                                                           Threshold t) mutable {
+                    auto &topk = context.topk(k);
+                    topk.set_threshold(t);
+                    block_max_ranked_and_query block_max_ranked_and_q(topk);
+                    block_max_ranked_and_q(
+                        make_block_max_scored_cursors(context, index, wdata, scorer, query),
+                        index.num_docs());
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "ranked_or" && wand_data_filename) {
+                query_fun = [&, context = query_context()](Query const &query,
+                                                           Threshold t) mutable {
+                    auto &topk = context.topk(k);
+                    topk.set_threshold(t);
+                    ranked_or_query ranked_or_q(topk);
+                    with_block_scored_cursors(
+                        block_scoring,
+                        index,
+                        wdata,
+                        scorer_name,
+                        query,
+                        [&]() -> auto & {
+                            return make_scored_cursors(context, index, scorer, query);
+                        },
+                        [&](auto &&cursors) { ranked_or_q(cursors, index.num_docs()); });
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "maxscore" && wand_data_filename) {
+                query_fun = [&, context = query_context()](Query const &query,
+                                                           Threshold t) mutable {
+                    auto &topk = context.topk(k);
+                    topk.set_threshold(t);
+                    maxscore_query maxscore_q(topk, &context);
+                    with_block_scored_cursors(
+                        block_scoring,
+                        index,
+                        wdata,
+                        scorer_name,
+                        query,
+                        [&]() -> auto & {
+                            return make_max_scored_cursors(context, index, wdata, scorer, query);
+                        },
+                        [&](auto &&cursors) { maxscore_q(cursors, index.num_docs()); });
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "ranked_or_taat" && wand_data_filename) {
+                Simple_Accumulator accumulator(index.num_docs());
                 topk_queue topk(k);
-                topk.set_threshold(t);
-                ranked_or_query ranked_or_q(topk);
-                ranked_or_q(make_scored_cursors(index, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.size();
-            };
-        } else if (t == "maxscore" && wand_data_filename) {
-            query_fun = [&](Query query, Threshold t) {
+                // Copies of the function (one per thread with --threads) own their buffers.
+                query_fun = [&, topk, accumulator](Query query, Threshold t) mutable {
+                    topk.clear();
+                    topk.set_threshold(t);
+                    ranked_or_taat_query ranked_or_taat_q(topk);
+                    with_block_scored_cursors(
+                        block_scoring,
+                        index,
+                        wdata,
+                        scorer_name,
+                        query,
+                        [&] { return make_scored_cursors(index, scorer, query); },
+                        [&](auto &&cursors) {
+                            ranked_or_taat_q(cursors, index.num_docs(), accumulator);
+                        });
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "ranked_or_taat_lazy" && wand_data_filename) {
+                Lazy_Accumulator<4> accumulator(index.num_docs());
                 topk_queue topk(k);
-                topk.set_threshold(t);
-                maxscore_query maxscore_q(topk);
-                maxscore_q(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.size();
-            };
-        } else if (t == "ranked_or_taat" && wand_data_filename) {
-            Simple_Accumulator accumulator(index.num_docs());
-            topk_queue topk(k);
-            ranked_or_taat_query ranked_or_taat_q(topk);
-            query_fun = [&, ranked_or_taat_q, accumulator](Query query, Threshold t) mutable {
-                topk.set_threshold(t);
-                ranked_or_taat_q(
-                    make_scored_cursors(index, *scorer, query), index.num_docs(), accumulator);
-                topk.finalize();
-                return topk.size();
-            };
-        } else if (t == "ranked_or_taat_lazy" && wand_data_filename) {
-            Lazy_Accumulator<4> accumulator(index.num_docs());
-            topk_queue topk(k);
-            ranked_or_taat_query ranked_or_taat_q(topk);
-            query_fun = [&, ranked_or_taat_q, accumulator](Query query, Threshold t) mutable {
-                topk.set_threshold(t);
-                ranked_or_taat_q(
-                    make_scored_cursors(index, *scorer, query), index.num_docs(), accumulator);
-                topk.finalize();
-                return topk.size();
-            };
-        } else {
-            spdlog::error("Unsupported query type: {}", t);
-            break;
-        }
-        if (extract) {
-            extract_times(query_fun, queries, thresholds, type, t, 2, std::cout);
-        } else {
-            op_perftest(query_fun, queries, thresholds, type, t, 2);
+                query_fun = [&, topk, accumulator](Query query, Threshold t) mutable {
+                    topk.clear();
+                    topk.set_threshold(t);
+                    ranked_or_taat_query ranked_or_taat_q(topk);
+                    with_block_scored_cursors(
+                        block_scoring,
+                        index,
+                        wdata,
+                        scorer_name,
+                        query,
+                        [&] { return make_scored_cursors(index, scorer, query); },
+                        [&](auto &&cursors) {
+                            ranked_or_taat_q(cursors, index.num_docs(), accumulator);
+                        });
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else {
+                spdlog::error("Unsupported query type: {}", t);
+                break;
+            }
+            // Counted during the timed runs, as these call `query_fun` for every query.
+            short_topk_counter short_topk(k);
+            bool primed = thresholds_filename && t != "and" && t != "or" && t != "or_freq";
+            if (primed) {
+                query_fun = [&short_topk, fn = std::move(query_fun)](Query query, Threshold t) {
+                    auto results = fn(query, t);
+                    short_topk.record(t, results);
+                    return results;
+                };
+            }
+            if (extract) {
+                extract_times(query_fun, queries, thresholds, type, t, 2, std::cout);
+            } else if (threads > 0) {
+                op_throughput(query_fun, queries, thresholds, type, t, 2, threads);
+            } else {
+                op_perftest(query_fun, queries, thresholds, type, t, 2);
+            }
+            if (primed) {
+                short_topk.log();
+            }
         }
+    };
+
+    if (static_scorer) {
+        scorer::with_static_scorer(scorer_name, wdata, run_queries);
+    } else {
+        run_queries(*scorer::from_name(scorer_name, wdata));
     }
 }
 
@@ -300,6 +384,9 @@ int main(int argc, const char **argv)
     bool compressed = false;
     bool extract = false;
     bool silent = false;
+    size_t threads = 0;
+    bool static_scorer = false;
+    bool block_scoring = false;
 
     CLI::App app{"queries - a tool for performing queries on an index."};
     app.set_config("--config", "", "Configuration .ini file", false);
@@ -317,6 +404,16 @@ int main(int argc, const char **argv)
         ->needs(terms_opt);
     app.add_option("--stemmer", stemmer, "Stemmer type")->needs(terms_opt);
     app.add_flag("--extract", extract, "Extract individual query times");
+    app.add_option("--threads",
+                   threads,
+                   "Run queries concurrently on this many threads and report throughput");
+    app.add_flag("--static-scorer",
+                 static_scorer,
+                 "Dispatch the scorer at compile time so that operators can inline it");
+    app.add_flag("--block-scoring",
+                 block_scoring,
+                 "Score whole posting blocks with SIMD kernels in ranked_or, ranked_or_taat "
+                 "and maxscore (bm25 and qld only)");
     app.add_flag("--silent", silent, "Suppress logging");
     CLI11_PARSE(app, argc, argv);
 
@@ -353,7 +450,10 @@ int main(int argc, const char **argv)
                                                                   query_type,          \
                                                                   k,                   \
                                                                   scorer_name,         \
-                                                                  extract);            \
+                                                                  extract,             \
+                                                                  threads,             \
+                                                                  static_scorer,       \
+                                                                  block_scoring);      \
         } else {                                                                       \
             perftest<BOOST_PP_CAT(T, _index), wand_raw_index>(index_filename,          \
                                                               wand_data_filename,      \
@@ -363,7 +463,10 @@ int main(int argc, const char **argv)
                                                               query_type,              \
                                                               k,                       \
                                                               scorer_name,             \
-                                                              extract);                \
+                                                              extract,                 \
+                                                              threads,                 \
+                                                              static_scorer,           \
+                                                              block_scoring);          \
         }                                                                              \
         /**/
 
@@ -0,0 +1,472 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "mio/mmap.hpp"
+#include "spdlog/sinks/stdout_color_sinks.h"
+#include "spdlog/spdlog.h"
+
+#include "mappable/mapper.hpp"
+
+#include "buffered_topk_queue.hpp"
+#include "cursor/block_max_scored_cursor.hpp"
+#include "cursor/max_scored_cursor.hpp"
+#include "cursor/scored_cursor.hpp"
+#include "index_types.hpp"
+#include "io.hpp"
+#include "payload_vector.hpp"
+#include "query/fused_threshold.hpp"
+#include "query/fusion.hpp"
+#include "query/queries.hpp"
+#include "query/query_context.hpp"
+#include "query/result_cache.hpp"
+#include "query/server_protocol.hpp"
+#include "query/term_processor.hpp"
+#include "util/util.hpp"
+#include "util/work_stealing_executor.hpp"
+#include "wand_data_compressed.hpp"
+#include "wand_data_raw.hpp"
+
+#include "scorer/scorer.hpp"
+
+#include "CLI/CLI.hpp"
+
+using namespace pisa;
+
+using result_list = std::vector<std::pair<float, uint64_t>>;
+using request_handler = std::function<std::string(std::string const &)>;
+
+struct server_defaults {
+    std::string algorithm;
+    uint64_t k;
+    fusion_method fusion;
+    uint64_t fusion_k;
+    std::string run_id;
+    fusion_strategy fusion_algo;
+};
+
+// Writes a reply to a client socket. A client that disconnected before its reply makes the
+// write fail with `EPIPE`, without raising `SIGPIPE`, and its connection is then closed.
+static bool write_all(int fd, std::string const &data)
+{
+    std::size_t written = 0;
+    while (written < data.size()) {
+        auto n = ::send(fd, data.data() + written, data.size() - written, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        written += n;
+    }
+    return true;
+}
+
+static void serve_connection(int fd, request_handler const &handle)
+{
+    std::string buffer;
+    char chunk[4096];
+    for (;;) {
+        auto n = ::read(fd, chunk, sizeof(chunk));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return;
+        }
+        buffer.append(chunk, n);
+        std::size_t begin = 0;
+        for (auto end = buffer.find('\n'); end != std::string::npos;
+             end = buffer.find('\n', begin)) {
+            if (not write_all(fd, handle(buffer.substr(begin, end - begin)))) {
+                return;
+            }
+            begin = end + 1;
+        }
+        buffer.erase(0, begin);
+    }
+}
+
+static void serve_socket(std::string const &path, request_handler const &handle)
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        spdlog::error("Socket path too long: {}", path);
+        std::abort();
+    }
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    ::unlink(path.c_str());
+    if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0
+        || ::listen(fd, SOMAXCONN) < 0) {
+        spdlog::error("Cannot listen on {}: {}", path, std::strerror(errno));
+        std::abort();
+    }
+    spdlog::info("Listening on {}", path);
+    // The handler refers to the state of `serve()`, so connections, which are served by
+    // detached threads, must all be closed before returning.
+    std::mutex mutex;
+    std::condition_variable closed;
+    std::size_t connections = 0;
+    for (;;) {
+        int client = ::accept(fd, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            spdlog::error("Cannot accept connection: {}", std::strerror(errno));
+            break;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++connections;
+        }
+        std::thread([client, &handle, &mutex, &closed, &connections] {
+            serve_connection(client, handle);
+            ::close(client);
+            std::unique_lock<std::mutex> lock(mutex);
+            --connections;
+            // only notifies once the thread is done with `mutex`
+            std::notify_all_at_thread_exit(closed, std::move(lock));
+        }).detach();
+    }
+    ::close(fd);
+    std::unique_lock<std::mutex> lock(mutex);
+    closed.wait(lock, [&] { return connections == 0; });
+}
+
+template <typename IndexType, typename WandType>
+void serve(const std::string &index_filename,
+           const std::string &wand_data_filename,
+           std::string const &documents_filename,
+           std::optional<std::string> const &terms_file,
+           std::optional<std::string> const &stopwords_filename,
+           std::optional<std::string> const &stemmer,
+           std::string const &scorer_name,
+           server_defaults const &defaults,
+           bool warmup,
+           std::size_t cache_budget,
+           uint64_t max_k,
+           std::optional<std::string> const &socket_path)
+{
+    IndexType index;
+    spdlog::info("Loading index from {}", index_filename);
+    mio::mmap_source m(index_filename.c_str());
+    mapper::map(index, m);
+    if (warmup) {
+        spdlog::info("Warming up posting lists");
+        for (size_t term = 0; term < index.size(); ++term) {
+            index.warmup(term);
+        }
+    }
+
+    WandType wdata;
+    mio::mmap_source md;
+    std::error_code error;
+    md.map(wand_data_filename, error);
+    if (error) {
+        spdlog::error("error mapping file: {}, exiting...", error.message());
+        std::abort();
+    }
+    mapper::map(wdata, md, mapper::map_flags::warmup);
+    auto scorer = scorer::from_name(scorer_name, wdata);
+    // Fused thresholds only bound CombSUM scores from below with non-negative term scores.
+    bool const non_negative_scores = scorer::has_non_negative_scores(scorer_name);
+
+    auto source = std::make_shared<mio::mmap_source>(documents_filename.c_str());
+    auto docmap = Payload_Vector<>::from(*source);
+
+    std::optional<TermProcessor> term_processor;
+    if (terms_file) {
+        term_processor.emplace(terms_file, stopwords_filename, stemmer);
+    }
+
+    // Parses a variation, which unlike `parse_query_ids` must not exit on bad input. The
+    // variation is parsed on its own, as the query id may contain colons.
+    auto parse_variation = [&](std::string const &qid, std::string const &variation) {
+        Query query;
+        if (term_processor) {
+            query = parse_raw_query_terms(variation, *term_processor);
+        } else {
+            for (auto const &token : split_query_tokens(variation)) {
+                auto term = split_term_weight(token).first;
+                if (term.empty()
+                    || not std::all_of(
+                        term.begin(), term.end(), [](char c) { return std::isdigit(c); })
+                    || std::stoull(std::string(term)) >= index.size()) {
+                    throw std::invalid_argument(fmt::format("Invalid term id {}", term));
+                }
+            }
+            query = parse_raw_query_ids(variation);
+        }
+        query.id = qid;
+        return query;
+    };
+
+    auto query_fun = [&](std::string const &algorithm,
+                         Query const &query,
+                         uint64_t k,
+                         fused_threshold *shared,
+                         size_t variation) -> result_list {
+        // Runs on connection and executor threads, each with its own context.
+        auto &context = thread_query_context();
+        auto &topk = context.topk(k);
+        if (algorithm == "wand") {
+            shared_threshold_query<wand_query> wand_q(topk, shared, variation, &context);
+            wand_q(make_max_scored_cursors(context, index, wdata, *scorer, query),
+                   index.num_docs());
+        } else if (algorithm == "block_max_wand") {
+            shared_threshold_query<block_max_wand_query> block_max_wand_q(
+                topk, shared, variation, &context);
+            block_max_wand_q(
+                make_block_max_scored_cursors(context, index, wdata, *scorer, query),
+                index.num_docs());
+        } else if (algorithm == "block_max_maxscore") {
+            shared_threshold_query<block_max_maxscore_query> block_max_maxscore_q(
+                topk, shared, variation, &context);
+            block_max_maxscore_q(
+                make_block_max_scored_cursors(context, index, wdata, *scorer, query),
+                index.num_docs());
+        } else if (algorithm == "ranked_or") {
+            shared_threshold_query<ranked_or_query> ranked_or_q(topk, shared, variation);
+            ranked_or_q(make_scored_cursors(context, index, *scorer, query), index.num_docs());
+        } else if (algorithm == "maxscore") {
+            shared_threshold_query<maxscore_query> maxscore_q(topk, shared, variation, &context);
+            maxscore_q(make_max_scored_cursors(context, index, wdata, *scorer, query),
+                       index.num_docs());
+        }
+        topk.finalize();
+        return topk.topk();
+    };
+    auto shared_maxscore_fun = [&](multi_query const &m_query, uint64_t k) {
+        auto shared = multi_query_to_shared(m_query);
+        std::vector<buffered_topk_queue> topks(m_query.size(), buffered_topk_queue(k));
+        shared_maxscore_query shared_maxscore_q(topks);
+        shared_maxscore_q(make_max_scored_cursors(index, wdata, *scorer, shared.as_query()),
+                          shared.variations,
+                          index.num_docs());
+        std::vector<result_list> results;
+        for (auto &topk : topks) {
+            topk.finalize();
+            results.push_back(topk.topk());
+        }
+        return results;
+    };
+
+    // Variations are not pruned by a shared threshold with a cache, so that their lists can be
+    // reused by other multi-queries.
+    std::optional<multi_query_cache> cache;
+    if (cache_budget > 0) {
+        cache.emplace(cache_budget);
+    }
+
+    work_stealing_executor executor;
+    std::atomic<size_t> request_count{0};
+    request_handler handle = [&](std::string const &line) -> std::string {
+        try {
+            auto request = parse_server_request(line, max_k);
+            auto qid = request.id.value_or(std::to_string(request_count++));
+            auto algorithm = request.algorithm.value_or(defaults.algorithm);
+            auto k = request.k.value_or(defaults.k);
+            auto fusion_type = request.fusion.value_or(defaults.fusion);
+            auto fusion_k = request.fusion_k.value_or(defaults.fusion_k);
+            if (algorithm != "wand" && algorithm != "block_max_wand"
+                && algorithm != "block_max_maxscore" && algorithm != "ranked_or"
+                && algorithm != "maxscore" && algorithm != "shared_maxscore") {
+                throw std::invalid_argument(fmt::format("Unsupported query type: {}", algorithm));
+            }
+
+            multi_query m_query;
+            for (auto const &variation : request.variations) {
+                m_query.push_back(parse_variation(qid, variation));
+                remove_duplicate_terms(m_query.back());
+            }
+
+            auto docname = [&](uint64_t docid) { return docmap[docid]; };
+            if (cache && m_query.size() > 1) {
+                result_fusion fusion(fusion_type, fusion_k, defaults.fusion_algo);
+                auto fused = (*cache)(m_query, k, fusion, [&](auto const &missing, auto &results) {
+                    if (algorithm == "shared_maxscore") {
+                        multi_query uncached;
+                        for (auto idx : missing) {
+                            uncached.push_back(m_query[idx]);
+                        }
+                        auto uncached_results = shared_maxscore_fun(uncached, k);
+                        for (size_t pos = 0; pos < missing.size(); ++pos) {
+                            results[missing[pos]] = std::move(uncached_results[pos]);
+                        }
+                        return;
+                    }
+                    executor.parallel_for(missing.size(), [&](size_t pos) {
+                        results[missing[pos]] =
+                            query_fun(algorithm, m_query[missing[pos]], k, nullptr, 0);
+                    });
+                });
+                return server_response(fused, request.format, qid, docname, defaults.run_id);
+            }
+
+            std::vector<result_list> results(m_query.size());
+            if (algorithm == "shared_maxscore") {
+                results = shared_maxscore_fun(m_query, k);
+            } else if (m_query.size() == 1) {
+                results[0] = query_fun(algorithm, m_query[0], k, nullptr, 0);
+            } else {
+                std::optional<fused_threshold> shared;
+                if (non_negative_scores && fusion_type == fusion_method::combsum
+                    && k >= fusion_k) {
+                    std::vector<float> upper_bounds;
+                    for (auto const &query : m_query) {
+                        upper_bounds.push_back(
+                            variation_upper_bound(wdata, query_term_weights(query)));
+                    }
+                    shared.emplace(std::move(upper_bounds));
+                }
+                executor.parallel_for(m_query.size(), [&](size_t idx) {
+                    results[idx] = query_fun(
+                        algorithm, m_query[idx], k, shared ? &*shared : nullptr, idx);
+                });
+            }
+
+            if (results.size() == 1) {
+                return server_response(results[0], request.format, qid, docname, defaults.run_id);
+            }
+            result_fusion fusion(fusion_type, fusion_k, defaults.fusion_algo);
+            return server_response(
+                fusion(results), request.format, qid, docname, defaults.run_id);
+        } catch (std::exception const &err) {
+            return server_error_response(err.what());
+        }
+    };
+
+    spdlog::info("Ready, running variations on {} worker threads", executor.size());
+    if (socket_path) {
+        serve_socket(*socket_path, handle);
+    } else {
+        std::string line;
+        while (std::getline(std::cin, line)) {
+            std::cout << handle(line) << std::flush;
+        }
+    }
+    if (cache) {
+        cache->log_stats();
+    }
+}
+
+using wand_raw_index = wand_data<wand_data_raw>;
+using wand_uniform_index = wand_data<wand_data_compressed>;
+
+int main(int argc, const char **argv)
+{
+    spdlog::set_default_logger(spdlog::stderr_color_mt("default"));
+
+    std::string type;
+    std::string index_filename;
+    std::string wand_data_filename;
+    std::string documents_file;
+    std::string scorer_name;
+    std::optional<std::string> terms_file;
+    std::optional<std::string> stopwords_filename;
+    std::optional<std::string> stemmer = std::nullopt;
+    std::optional<std::string> socket_path;
+    std::string fusion_name = "combsum";
+    std::string fusion_strategy_name = "accumulator";
+    server_defaults defaults{"maxscore",
+                             configuration::get().k,
+                             fusion_method::combsum,
+                             100,
+                             "R0",
+                             fusion_strategy::accumulator};
+    bool compressed = false;
+    bool warmup = false;
+    std::size_t cache_budget = 0;
+    uint64_t max_k = default_max_request_k;
+
+    CLI::App app{"query_server - serves queries and multi-queries on a resident index."};
+    app.set_config("--config", "", "Configuration .ini file", false);
+    app.add_option("-t,--type", type, "Index type")->required();
+    app.add_option("-i,--index", index_filename, "Collection basename")->required();
+    app.add_option("-w,--wand", wand_data_filename, "Wand data filename")->required();
+    app.add_option("-s,--scorer", scorer_name, "Scorer function")->required();
+    app.add_option("--documents", documents_file, "Document lexicon")->required();
+    app.add_flag("--compressed-wand", compressed, "Compressed wand input file");
+    app.add_option("-a,--algorithm", defaults.algorithm, "Default query algorithm");
+    app.add_option("-k", defaults.k, "Default k value");
+    app.add_option("-z", defaults.fusion_k, "Default k value for final fused list");
+    app.add_option("--fusion", fusion_name, "Default fusion method");
+    app.add_option("--fusion-strategy",
+                   fusion_strategy_name,
+                   "Fusion strategy: accumulator or heap_merge");
+    app.add_option("-r,--run", defaults.run_id, "Run identifier");
+    auto *terms_opt = app.add_option("--terms", terms_file, "Term lexicon");
+    app.add_option("--stopwords", stopwords_filename, "File containing stopwords to ignore")
+        ->needs(terms_opt);
+    app.add_option("--stemmer", stemmer, "Stemmer type")->needs(terms_opt);
+    app.add_flag("--warmup", warmup, "Warm up all posting lists before serving");
+    app.add_option("--cache-budget",
+                   cache_budget,
+                   "Cache fused and per-variation results in this many bytes");
+    app.add_option("--max-k", max_k, "Reject requests for more than this many results");
+    app.add_option("--socket",
+                   socket_path,
+                   "Serve on this Unix domain socket instead of stdin/stdout");
+    CLI11_PARSE(app, argc, argv);
+
+    defaults.fusion = fusion_method_from_name(fusion_name);
+    defaults.fusion_algo = fusion_strategy_from_name(fusion_strategy_name);
+
+    /**/
+    if (false) { // NOLINT
+#define LOOP_BODY(R, DATA, T)                                                       \
+    }                                                                               \
+    else if (type == BOOST_PP_STRINGIZE(T))                                         \
+    {                                                                               \
+        if (compressed) {                                                           \
+            serve<BOOST_PP_CAT(T, _index), wand_uniform_index>(index_filename,      \
+                                                               wand_data_filename,  \
+                                                               documents_file,      \
+                                                               terms_file,          \
+                                                               stopwords_filename,  \
+                                                               stemmer,             \
+                                                               scorer_name,         \
+                                                               defaults,            \
+                                                               warmup,              \
+                                                               cache_budget,        \
+                                                               max_k,               \
+                                                               socket_path);        \
+        } else {                                                                    \
+            serve<BOOST_PP_CAT(T, _index), wand_raw_index>(index_filename,          \
+                                                           wand_data_filename,      \
+                                                           documents_file,          \
+                                                           terms_file,              \
+                                                           stopwords_filename,      \
+                                                           stemmer,                 \
+                                                           scorer_name,             \
+                                                           defaults,                \
+                                                           warmup,                  \
+                                                           cache_budget,            \
+                                                           max_k,                   \
+                                                           socket_path);            \
+        }                                                                           \
+        /**/
+
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, PISA_INDEX_TYPES);
+#undef LOOP_BODY
+    } else {
+        spdlog::error("Unknown type {}", type);
+    }
+}
@@ -1,5 +1,7 @@
 #include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <limits>
 #include <numeric>
 #include <optional>
 #include <string>
@@ -15,14 +17,22 @@
 #include "mappable/mapper.hpp"
 
 #include "accumulator/lazy_accumulator.hpp"
+#include "accumulator/simple_accumulator.hpp"
 #include "cursor/block_max_scored_cursor.hpp"
+#include "cursor/block_scored_cursor.hpp"
 #include "cursor/cursor.hpp"
 #include "cursor/max_scored_cursor.hpp"
 #include "cursor/scored_cursor.hpp"
+#include "impact_ordered_index.hpp"
 #include "index_types.hpp"
+#include "query/multi_query_thresholds.hpp"
 #include "query/queries.hpp"
+#include "query/query_context.hpp"
+#include "query/variation_pruning.hpp"
+#include "query/throughput.hpp"
 #include "timer.hpp"
 #include "util/util.hpp"
+#include "util/work_stealing_executor.hpp"
 #include "wand_data_compressed.hpp"
 #include "wand_data_raw.hpp"
 
@@ -32,9 +42,35 @@
 using namespace pisa;
 using ranges::views::enumerate;
 
+// Processes a query with `conjunctive_first_query<QueryAlg>`, and returns the number of results,
+// or the number of documents scored if `count_scored`.
+template <typename QueryAlg, typename Index, typename WandType, typename Scorer>
+auto conjunctive_first_fun(Index const &index,
+                           WandType const &wdata,
+                           Scorer const &scorer,
+                           uint64_t k,
+                           bool count_scored) -> std::function<uint64_t(Query const &, Threshold)>
+{
+    return [&index, &wdata, &scorer, k, count_scored](Query const &query,
+                                                      Threshold t) -> uint64_t {
+        topk_queue topk(k);
+        topk.set_threshold(t);
+        conjunctive_first_query<QueryAlg> conjunctive_q(topk);
+        conjunctive_q.multi_query(make_block_max_scored_cursors(index, wdata, scorer, query),
+                                  make_block_max_scored_cursors(index, wdata, scorer, query),
+                                  index.num_docs());
+        if (count_scored) {
+            return conjunctive_q.documents_scored();
+        }
+        topk.finalize();
+        return topk.topk().size();
+    };
+}
+
 template <typename Fn>
 void extract_times(Fn fn,
                    std::vector<Query> const &queries,
+                   std::vector<Threshold> const &thresholds,
                    std::string const &index_type,
                    std::string const &query_type,
                    size_t runs,
@@ -42,9 +78,10 @@ void extract_times(Fn fn,
 {
     std::vector<std::size_t> times(runs);
     for (auto &&[qid, query] : enumerate(queries)) {
-        do_not_optimize_away(fn(query));
-        std::generate(times.begin(), times.end(), [&fn, &q = query]() {
-            return run_with_timer<std::chrono::microseconds>([&]() { do_not_optimize_away(fn(q)); })
+        do_not_optimize_away(fn(query, thresholds[qid]));
+        std::generate(times.begin(), times.end(), [&fn, &q = query, &t = thresholds[qid]]() {
+            return run_with_timer<std::chrono::microseconds>(
+                       [&]() { do_not_optimize_away(fn(q, t)); })
                 .count();
         });
         auto mean =
@@ -56,6 +93,7 @@ void extract_times(Fn fn,
 template <typename Functor>
 void op_perftest(Functor query_func,
                  std::vector<Query> const &queries,
+                 std::vector<Threshold> const &thresholds,
                  std::string const &index_type,
                  std::string const &query_type,
                  size_t runs)
@@ -64,14 +102,16 @@ void op_perftest(Functor query_func,
     std::vector<double> query_times;
 
     for (size_t run = 0; run <= runs; ++run) {
+        size_t idx = 0;
         for (auto const &query : queries) {
             auto usecs = run_with_timer<std::chrono::microseconds>([&]() {
-                uint64_t result = query_func(query);
+                uint64_t result = query_func(query, thresholds[idx]);
                 do_not_optimize_away(result);
             });
             if (run != 0) { // first run is not timed
                 query_times.push_back(usecs.count());
             }
+            idx += 1;
         }
     }
 
@@ -98,6 +138,29 @@ void op_perftest(Functor query_func,
     }
 }
 
+// Reports how many of the documents matching each query `fn` scored, as returned by `fn`.
+template <typename Fn, typename Index>
+void report_documents_scored(Fn fn,
+                             Index const &index,
+                             std::vector<Query> const &queries,
+                             std::vector<Threshold> const &thresholds,
+                             std::string const &index_type,
+                             std::string const &query_type)
+{
+    uint64_t scored = 0;
+    uint64_t matching = 0;
+    for (size_t idx = 0; idx < queries.size(); ++idx) {
+        scored += fn(queries[idx], thresholds[idx]);
+        or_query<false> or_q;
+        matching += or_q(make_cursors(index, queries[idx]), index.num_docs());
+    }
+    double scored_avg = double(scored) / queries.size();
+    double matching_avg = double(matching) / queries.size();
+    spdlog::info("Scored {} of {} matching documents per query", scored_avg, matching_avg);
+    stats_line()("type", index_type)("query", query_type)("documents_scored", scored_avg)(
+        "documents_matching", matching_avg);
+}
+
 template <typename IndexType, typename WandType>
 void perftest(const std::string &index_filename,
               const std::optional<std::string> &wand_data_filename,
@@ -106,8 +169,14 @@ void perftest(const std::string &index_filename,
               std::string const &type,
               std::string const &query_type,
               uint64_t k,
+              size_t num_ranges,
+              saat_options const &saat,
               std::string const &scorer_name,
-              bool extract)
+              bool extract,
+              size_t threads,
+              bool static_scorer,
+              bool block_scoring,
+              bool documents_scored)
 {
     IndexType index;
     spdlog::info("Loading index from {}", index_filename);
@@ -140,78 +209,270 @@ void perftest(const std::string &index_filename,
         mapper::map(wdata, md, mapper::map_flags::warmup);
     }
 
-    std::vector<float> thresholds;
+    std::vector<Threshold> thresholds(queries.size(), 0.0);
     if (thresholds_filename) {
-        std::string t;
-        std::ifstream tin(*thresholds_filename);
-        while (std::getline(tin, t)) {
-            thresholds.push_back(std::stof(t));
+        try {
+            thresholds = read_thresholds(*thresholds_filename, queries.size());
+        } catch (std::invalid_argument const &err) {
+            spdlog::error("{}", err.what());
+            std::exit(1);
         }
     }
 
-    auto scorer = scorer::from_name(scorer_name, wdata);
-
     spdlog::info("Performing {} queries", type);
     spdlog::info("K: {}", k);
+    if (block_scoring
+        && not(block_scorable<IndexType>::value && block_term_scorer::supports(scorer_name))) {
+        spdlog::warn("No block scoring for {} with {}, scoring one posting at a time",
+                     type,
+                     scorer_name);
+        block_scoring = false;
+    }
 
-    for (auto &&t : query_types) {
-        spdlog::info("Query type: {}", t);
-        std::function<uint64_t(Query)> query_fun;
+    impact_ordered_index impact_index;
+    mio::mmap_source mi;
+    if (saat.index_filename) {
+        std::error_code error;
+        mi.map(*saat.index_filename, error);
+        if (error) {
+            spdlog::error("error mapping file: {}, exiting...", error.message());
+            std::abort();
+        }
+        mapper::map(impact_index, mi);
+        if (auto term = find_missing_term(impact_index, queries); term) {
+            spdlog::error("Term {} is not in the impact-ordered index", *term);
+            std::exit(1);
+        }
+    }
 
-        if (t == "wand" && wand_data_filename) {
-            query_fun = [&](Query query) {
-                topk_queue topk(k);
-                wand_query wand_q(topk);
-                wand_q.multi_query(make_max_scored_cursors(index, wdata, *scorer, query),
-                                   index.num_docs());
-                topk.finalize();
-                return topk.size();
-            };
-        } else if (t == "block_max_wand" && wand_data_filename) {
-            query_fun = [&](Query query) {
-                topk_queue topk(k);
-                block_max_wand_query block_max_wand_q(topk);
-                block_max_wand_q.multi_query(make_block_max_scored_cursors(index, wdata, *scorer, query),
-                                            index.num_docs());
-                topk.finalize();
-                return topk.size();
-            };
-        } else if (t == "block_max_maxscore" && wand_data_filename) {
-            query_fun = [&](Query query) {
+    std::unique_ptr<work_stealing_executor> executor;
+    if (num_ranges > 1) {
+        executor = std::make_unique<work_stealing_executor>();
+        spdlog::info("Splitting queries into {} ranges on {} worker threads",
+                     num_ranges,
+                     executor->size());
+    }
+
+    // `scorer` is either a type-erased runtime scorer or a `static_scorer`.
+    auto run_queries = [&](auto const &scorer) {
+        for (auto &&t : query_types) {
+            spdlog::info("Query type: {}", t);
+            std::function<uint64_t(Query const &, Threshold)> query_fun;
+            std::function<std::vector<std::pair<float, uint64_t>> const &(Query const &,
+                                                                          Threshold)>
+                range_fun;
+            // Returns the number of documents scored, for --documents-scored.
+            std::function<uint64_t(Query const &, Threshold)> scored_fun;
+
+            if (t == "wand" && wand_data_filename) {
+                // Copies of the function (one per thread with --threads) own their context.
+                query_fun = [&, context = query_context()](Query const &query,
+                                                           Threshold t) mutable {
+                    auto &topk = context.topk(k);
+                    topk.set_threshold(t);
+                    wand_query wand_q(topk, &context);
+                    wand_q.multi_query(
+                        make_max_scored_cursors(context, index, wdata, scorer, query),
+                        index.num_docs());
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+                range_fun = parallel_range_fun<wand_query>(
+                    index, wdata, scorer, executor.get(), k, num_ranges);
+            } else if (t == "block_max_wand" && wand_data_filename) {
+                query_fun = [&, context = query_context()](Query const &query,
+                                                           Threshold t) mutable {
+                    auto &topk = context.topk(k);
+                    topk.set_threshold(t);
+                    block_max_wand_query block_max_wand_q(topk, &context);
+                    block_max_wand_q.multi_query(
+                        make_block_max_scored_cursors(context, index, wdata, scorer, query),
+                        index.num_docs());
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+                range_fun = parallel_range_fun<block_max_wand_query>(
+                    index, wdata, scorer, executor.get(), k, num_ranges);
+                scored_fun = [&](Query const &query, Threshold t) {
+                    topk_queue topk(k);
+                    topk.set_threshold(t);
+                    block_max_wand_query block_max_wand_q(topk);
+                    block_max_wand_q.multi_query(
+                        make_block_max_scored_cursors(index, wdata, scorer, query),
+                        index.num_docs());
+                    return block_max_wand_q.documents_scored();
+                };
+            } else if (t == "block_max_maxscore" && wand_data_filename) {
+                query_fun = [&, context = query_context()](Query const &query,
+                                                           Threshold t) mutable {
+                    auto &topk = context.topk(k);
+                    topk.set_threshold(t);
+                    block_max_maxscore_query block_max_maxscore_q(topk, &context);
+                    block_max_maxscore_q.multi_query(
+                        make_block_max_scored_cursors(context, index, wdata, scorer, query),
+                        index.num_docs());
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+                range_fun = parallel_range_fun<block_max_maxscore_query>(
+                    index, wdata, scorer, executor.get(), k, num_ranges);
+                scored_fun = [&](Query const &query, Threshold t) {
+                    topk_queue topk(k);
+                    topk.set_threshold(t);
+                    block_max_maxscore_query block_max_maxscore_q(topk);
+                    block_max_maxscore_q.multi_query(
+                        make_block_max_scored_cursors(index, wdata, scorer, query),
+                        index.num_docs());
+                    return block_max_maxscore_q.documents_scored();
+                };
+            } else if (t == "conjunctive_block_max_wand" && wand_data_filename) {
+                query_fun = conjunctive_first_fun<block_max_wand_query>(
+                    index, wdata, scorer, k, false);
+                scored_fun = conjunctive_first_fun<block_max_wand_query>(
+                    index, wdata, scorer, k, true);
+            } else if (t == "conjunctive_block_max_maxscore" && wand_data_filename) {
+                query_fun = conjunctive_first_fun<block_max_maxscore_query>(
+                    index, wdata, scorer, k, false);
+                scored_fun = conjunctive_first_fun<block_max_maxscore_query>(
+                    index, wdata, scorer, k, true);
+            } else if (t == "ranked_or" && wand_data_filename) {
+                query_fun = [&, context = query_context()](Query const &query,
+                                                           Threshold t) mutable {
+                    auto &topk = context.topk(k);
+                    topk.set_threshold(t);
+                    ranked_or_query ranked_or_q(topk);
+                    with_block_scored_cursors(
+                        block_scoring,
+                        index,
+                        wdata,
+                        scorer_name,
+                        query,
+                        [&]() -> auto & {
+                            return make_scored_cursors(context, index, scorer, query);
+                        },
+                        [&](auto &&cursors) {
+                            ranked_or_q.multi_query(cursors, index.num_docs());
+                        });
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+                range_fun = parallel_range_fun<ranked_or_query>(
+                    index, wdata, scorer, executor.get(), k, num_ranges);
+            } else if (t == "maxscore" && wand_data_filename) {
+                query_fun = [&, context = query_context()](Query const &query,
+                                                           Threshold t) mutable {
+                    auto &topk = context.topk(k);
+                    topk.set_threshold(t);
+                    maxscore_query maxscore_q(topk, &context);
+                    with_block_scored_cursors(
+                        block_scoring,
+                        index,
+                        wdata,
+                        scorer_name,
+                        query,
+                        [&]() -> auto & {
+                            return make_max_scored_cursors(context, index, wdata, scorer, query);
+                        },
+                        [&](auto &&cursors) { maxscore_q.multi_query(cursors, index.num_docs()); });
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+                range_fun = parallel_range_fun<maxscore_query>(
+                    index, wdata, scorer, executor.get(), k, num_ranges);
+            } else if (t == "ranked_or_taat" && wand_data_filename) {
+                Simple_Accumulator accumulator(index.num_docs());
                 topk_queue topk(k);
-                block_max_maxscore_query block_max_maxscore_q(topk);
-                block_max_maxscore_q.multi_query(
-                    make_block_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.size();
-            };
-        } else if (t == "ranked_or" && wand_data_filename) {
-            query_fun = [&](Query query) {
+                // Copies of the function (one per thread with --threads) own their buffers.
+                query_fun = [&, topk, accumulator](Query const &query, Threshold t) mutable {
+                    topk.clear();
+                    topk.set_threshold(t);
+                    ranked_or_taat_query ranked_or_taat_q(topk);
+                    with_block_scored_cursors(
+                        block_scoring,
+                        index,
+                        wdata,
+                        scorer_name,
+                        query,
+                        [&] { return make_scored_cursors(index, scorer, query); },
+                        [&](auto &&cursors) {
+                            ranked_or_taat_q.multi_query(cursors, index.num_docs(), accumulator);
+                        });
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "ranked_or_taat_lazy" && wand_data_filename) {
+                Lazy_Accumulator<4> accumulator(index.num_docs());
                 topk_queue topk(k);
-                ranked_or_query ranked_or_q(topk);
-                ranked_or_q.multi_query(make_scored_cursors(index, *scorer, query), index.num_docs());
-                topk.finalize();
-                return topk.size();
-            };
-        } else if (t == "maxscore" && wand_data_filename) {
-            query_fun = [&](Query query) {
+                query_fun = [&, topk, accumulator](Query const &query, Threshold t) mutable {
+                    topk.clear();
+                    topk.set_threshold(t);
+                    ranked_or_taat_query ranked_or_taat_q(topk);
+                    with_block_scored_cursors(
+                        block_scoring,
+                        index,
+                        wdata,
+                        scorer_name,
+                        query,
+                        [&] { return make_scored_cursors(index, scorer, query); },
+                        [&](auto &&cursors) {
+                            ranked_or_taat_q.multi_query(cursors, index.num_docs(), accumulator);
+                        });
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else if (t == "saat" && saat.index_filename) {
+                Simple_Accumulator accumulator(impact_index.num_docs());
                 topk_queue topk(k);
-                maxscore_query maxscore_q(topk);
-                maxscore_q.multi_query(make_max_scored_cursors(index, wdata, *scorer, query),
-                                  index.num_docs());
-                topk.finalize();
-                return topk.size();
-            };
-        } else {
-            spdlog::error("Unsupported query type: {}", t);
-            break;
-        }
-        
-        if (extract) {
-            extract_times(query_fun, queries, type, t, 2, std::cout);
-        } else {
-            op_perftest(query_fun, queries, type, t, 2);
+                // Copies of the function (one per thread with --threads) own their buffers.
+                query_fun = [&, topk, accumulator](Query const &query, Threshold t) mutable {
+                    topk.clear();
+                    topk.set_threshold(t);
+                    saat_query saat_q(topk, saat.postings_budget, saat.time());
+                    saat_q(impact_index, query_term_weights(query), accumulator);
+                    topk.finalize();
+                    return topk.topk().size();
+                };
+            } else {
+                spdlog::error("Unsupported query type: {}", t);
+                break;
+            }
+            if (num_ranges > 1 && range_fun) {
+                query_fun = [range_fun](Query const &query, Threshold t) {
+                    return range_fun(query, t).size();
+                };
+            }
+            // Counted during the timed runs, as these call `query_fun` for every query.
+            short_topk_counter short_topk(k);
+            bool primed = thresholds_filename.has_value();
+            if (primed) {
+                query_fun = [&short_topk, fn = std::move(query_fun)](Query const &query,
+                                                                     Threshold t) {
+                    auto results = fn(query, t);
+                    short_topk.record(t, results);
+                    return results;
+                };
+            }
+            if (documents_scored && scored_fun) {
+                report_documents_scored(scored_fun, index, queries, thresholds, type, t);
+            }
+
+            if (extract) {
+                extract_times(query_fun, queries, thresholds, type, t, 2, std::cout);
+            } else if (threads > 0) {
+                op_throughput(query_fun, queries, thresholds, type, t, 2, threads);
+            } else {
+                op_perftest(query_fun, queries, thresholds, type, t, 2);
+            }
+            if (primed) {
+                short_topk.log();
+            }
         }
+    };
+
+    if (static_scorer) {
+        scorer::with_static_scorer(scorer_name, wdata, run_queries);
+    } else {
+        run_queries(*scorer::from_name(scorer_name, wdata));
     }
 }
 
@@ -231,9 +492,17 @@ int main(int argc, const char **argv)
     std::optional<std::string> stopwords_filename;
     std::optional<std::string> stemmer = std::nullopt;
     uint64_t k = configuration::get().k;
+    size_t num_ranges = 0;
+    saat_options saat;
     bool compressed = false;
     bool extract = false;
     bool silent = false;
+    size_t threads = 0;
+    bool static_scorer = false;
+    bool block_scoring = false;
+    bool documents_scored = false;
+    variation_pruning pruning;
+    std::optional<std::string> pruning_report;
 
     CLI::App app{"queries - a tool for performing queries on an index."};
     app.set_config("--config", "", "Configuration .ini file", false);
@@ -245,12 +514,42 @@ int main(int argc, const char **argv)
     app.add_option("-s,--scorer", scorer_name, "Scorer function")->required();
     app.add_flag("--compressed-wand", compressed, "Compressed wand input file");
     app.add_option("-k", k, "k value");
+    app.add_option(
+        "--ranges", num_ranges, "Split each query into docid ranges processed in parallel");
+    app.add_option("--impact-index", saat.index_filename, "Impact-ordered index for saat");
+    app.add_option("--postings-budget", saat.postings_budget, "Postings processed by saat");
+    app.add_option("--time-budget", saat.time_budget, "Time budget of saat in microseconds");
     app.add_option("-T,--thresholds", thresholds_filename, "k value");
     auto *terms_opt = app.add_option("--terms", terms_file, "Term lexicon");
     app.add_option("--stopwords", stopwords_filename, "File containing stopwords to ignore")
         ->needs(terms_opt);
     app.add_option("--stemmer", stemmer, "Stemmer type")->needs(terms_opt);
     app.add_flag("--extract", extract, "Extract individual query times");
+    app.add_option("--threads",
+                   threads,
+                   "Run queries concurrently on this many threads and report throughput");
+    app.add_flag("--static-scorer",
+                 static_scorer,
+                 "Dispatch the scorer at compile time so that operators can inline it");
+    app.add_flag("--block-scoring",
+                 block_scoring,
+                 "Score whole posting blocks with SIMD kernels in ranked_or, ranked_or_taat "
+                 "and maxscore (bm25 and qld only)");
+    app.add_flag("--documents-scored",
+                 documents_scored,
+                 "Report how many matching documents the block-max algorithms score");
+    app.add_flag("--group-variations",
+                 pruning.group,
+                 "Merge identical variations into one weighted by their number");
+    app.add_option("--min-contribution",
+                   pruning.min_contribution,
+                   "Drop variations bounded below this fraction of the best one of the topic");
+    app.add_option("--max-variations", pruning.max_variations, "Keep at most this many variations");
+    app.add_option("--max-postings",
+                   pruning.max_postings,
+                   "Keep as many variations as fit in this many postings per topic");
+    app.add_option(
+        "--pruning-report", pruning_report, "Write the variations pruned from each topic here");
     app.add_flag("--silent", silent, "Suppress logging");
     CLI11_PARSE(app, argc, argv);
 
@@ -259,6 +558,15 @@ int main(int argc, const char **argv)
     } else {
         spdlog::set_default_logger(spdlog::stderr_color_mt("stderr"));
     }
+    std::vector<std::string> query_types;
+    boost::algorithm::split(query_types, query_type, boost::is_any_of(":"));
+    for (auto const &t : query_types) {
+        if (t.rfind("conjunctive_", 0) == 0
+            && not conjunctive_first_query<block_max_wand_query>::supports(scorer_name)) {
+            spdlog::error("{} is not rank-safe with {}, which has negative scores", t, scorer_name);
+            return 1;
+        }
+    }
     if (extract) {
         std::cout << "qid\tusec\n";
     }
@@ -272,7 +580,23 @@ int main(int argc, const char **argv)
         io::for_each_line(std::cin, parse_query);
     }
     auto multi_queries = generate_multi_queries(queries);
-    auto spcs_queries = multi_query_to_spcs(multi_queries); 
+    if (pruning.enabled() && thresholds_filename) {
+        // Thresholds of the full queries may exceed the k-th score of the pruned ones, which
+        // would then silently lose results.
+        spdlog::error("Thresholds cannot be used with variation pruning");
+        return 1;
+    }
+    pruning.non_negative_scores = scorer::has_non_negative_scores(scorer_name);
+    if (pruning.enabled() && not wand_data_filename) {
+        spdlog::warn("Pruning variations requires wand data, keeping all of them");
+    } else if (pruning.enabled() && compressed) {
+        multi_queries = prune_with_wand_data<wand_uniform_index>(
+            *wand_data_filename, multi_queries, pruning, pruning_report);
+    } else if (pruning.enabled()) {
+        multi_queries = prune_with_wand_data<wand_raw_index>(
+            *wand_data_filename, multi_queries, pruning, pruning_report);
+    }
+    auto spcs_queries = multi_query_to_spcs(multi_queries);
 
     /**/
     if (false) {
@@ -288,8 +612,14 @@ int main(int argc, const char **argv)
                                                                   type,                \
                                                                   query_type,          \
                                                                   k,                   \
+                                                                  num_ranges,          \
+                                                                  saat,                \
                                                                   scorer_name,         \
-                                                                  extract);            \
+                                                                  extract,             \
+                                                                  threads,             \
+                                                                  static_scorer,       \
+                                                                  block_scoring,       \
+                                                                  documents_scored);   \
         } else {                                                                       \
             perftest<BOOST_PP_CAT(T, _index), wand_raw_index>(index_filename,          \
                                                               wand_data_filename,      \
@@ -298,8 +628,14 @@ int main(int argc, const char **argv)
                                                               type,                    \
                                                               query_type,              \
                                                               k,                       \
+                                                              num_ranges,              \
+                                                              saat,                    \
                                                               scorer_name,             \
-                                                              extract);                \
+                                                              extract,                 \
+                                                              threads,                 \
+                                                              static_scorer,           \
+                                                              block_scoring,           \
+                                                              documents_scored);       \
         }                                                                              \
         /**/
 
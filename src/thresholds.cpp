@@ -1,4 +1,6 @@
+#include <iomanip>
 #include <iostream>
+#include <limits>
 #include <optional>
 
 #include "boost/algorithm/string/classification.hpp"
@@ -12,11 +14,13 @@
 
 #include "index_types.hpp"
 #include "io.hpp"
+#include "query/multi_query_thresholds.hpp"
 #include "query/queries.hpp"
 #include "util/util.hpp"
 #include "wand_data_compressed.hpp"
 #include "wand_data_raw.hpp"
 #include "cursor/max_scored_cursor.hpp"
+#include "cursor/scored_cursor.hpp"
 
 #include "scorer/scorer.hpp"
 
@@ -31,7 +35,9 @@ void thresholds(const std::string &index_filename,
                 const std::optional<std::string> &thresholds_filename,
                 std::string const &type,
                 std::string const &scorer_name,
-                uint64_t k)
+                uint64_t k,
+                bool multi,
+                threshold_estimator estimator)
 {
     IndexType index;
     mio::mmap_source m(index_filename.c_str());
@@ -54,6 +60,42 @@ void thresholds(const std::string &index_filename,
     }
     topk_queue topk(k);
     wand_query wand_q(topk);
+    if (multi) {
+        // Thresholds of the SP-CS queries, in the order used by the single-pass tools.
+        auto multi_queries = generate_multi_queries(queries);
+        auto spcs_queries = multi_query_to_spcs(multi_queries);
+        std::cout << std::setprecision(std::numeric_limits<float>::max_digits10);
+        auto kth_score = [&]() {
+            topk.finalize();
+            float threshold = topk.topk().size() == k ? topk.topk().back().first : 0.0;
+            topk.clear();
+            return threshold;
+        };
+        for (size_t idx = 0; idx < spcs_queries.size(); ++idx) {
+            float threshold = 0.0;
+            if (estimator == threshold_estimator::exact) {
+                wand_q.multi_query(
+                    make_max_scored_cursors(index, wdata, *scorer, spcs_queries[idx]),
+                    index.num_docs());
+                threshold = kth_score();
+            } else if (estimator == threshold_estimator::term) {
+                threshold = kth_term_threshold(
+                    make_scored_cursors(index, *scorer, spcs_queries[idx]), k, index.num_docs());
+            } else {
+                std::vector<std::vector<std::pair<float, uint64_t>>> results;
+                for (auto const &variation : multi_queries[idx]) {
+                    wand_q.multi_query(make_max_scored_cursors(index, wdata, *scorer, variation),
+                                       index.num_docs());
+                    topk.finalize();
+                    results.push_back(topk.topk());
+                    topk.clear();
+                }
+                threshold = fused_lower_bound(results, k);
+            }
+            std::cout << threshold << '\n';
+        }
+        return;
+    }
     for (auto const &query : queries) {
         wand_q(make_max_scored_cursors(index, wdata, *scorer, query), index.num_docs());
         topk.finalize();
@@ -86,6 +128,8 @@ int main(int argc, const char **argv)
 
     uint64_t k = configuration::get().k;
     bool compressed = false;
+    bool multi = false;
+    std::string estimator_name = "exact";
 
     CLI::App app{"queries - a tool for performing queries on an index."};
     app.set_config("--config", "", "Configuration .ini file", false);
@@ -96,6 +140,10 @@ int main(int argc, const char **argv)
     app.add_option("-s,--scorer", scorer_name, "Scorer function")->required();
     app.add_flag("--compressed-wand", compressed, "Compressed wand input file");
     app.add_option("-k", k, "k value");
+    app.add_flag("--multi", multi, "Compute thresholds of single-pass CombSUM multi-queries");
+    app.add_option("--estimator",
+                   estimator_name,
+                   "Multi-query threshold estimator: exact, term or variations");
     auto *terms_opt =
         app.add_option("--terms", terms_file, "Text file with terms in separate lines");
     app.add_option("--stemmer", stemmer, "Stemmer type")->needs(terms_opt);
@@ -110,6 +158,15 @@ int main(int argc, const char **argv)
         io::for_each_line(std::cin, parse_query);
     }
 
+    auto estimator = threshold_estimator_from_name(estimator_name);
+    if (multi && estimator != threshold_estimator::exact
+        && not scorer::has_non_negative_scores(scorer_name)) {
+        spdlog::error("The {} estimator is not a lower bound with {}, which has negative scores",
+                      estimator_name,
+                      scorer_name);
+        return 1;
+    }
+
     /**/
     if (false) {
 #define LOOP_BODY(R, DATA, T)                                                            \
@@ -122,7 +179,9 @@ int main(int argc, const char **argv)
                                                                     thresholds_filename, \
                                                                     type,                \
                                                                     scorer_name,         \
-                                                                    k);                  \
+                                                                    k,                   \
+                                                                    multi,               \
+                                                                    estimator);          \
         } else {                                                                         \
             thresholds<BOOST_PP_CAT(T, _index), wand_raw_index>(index_filename,          \
                                                                 wand_data_filename,      \
@@ -130,7 +189,9 @@ int main(int argc, const char **argv)
                                                                 thresholds_filename,     \
                                                                 type,                    \
                                                                 scorer_name,             \
-                                                                k);                      \
+                                                                k,                       \
+                                                                multi,                   \
+                                                                estimator);              \
         }                                                                                \
         /**/
 
@@ -13,6 +13,7 @@
 #include "codec/simdbp.hpp"
 
 #include "block_posting_list.hpp"
+#include "util/simd_search.hpp"
 
 #include <vector>
 #include <cstdlib>
@@ -42,6 +43,15 @@ void test_block_posting_list_ops(uint8_t const* data, uint64_t n, uint64_t unive
             MY_REQUIRE_EQUAL(freqs[i], e.freq(),
                              "i = " << i << " size = " << n);
         }
+        // skips of increasing length from the current position
+        for (size_t stride : {1, 7, 130, 1000, 5000}) {
+            e.reset();
+            for (size_t i = 0; i < n; i += stride) {
+                e.next_geq(docs[i]);
+                MY_REQUIRE_EQUAL(docs[i], e.docid(),
+                                 "i = " << i << " stride = " << stride);
+            }
+        }
         e.reset(); e.next_geq(docs.back() + 1);
         REQUIRE(universe == e.docid());
         e.reset(); e.next_geq(universe);
@@ -121,3 +131,26 @@ TEST_CASE("block_posting_list_reordering")
 {
     test_block_posting_list_reordering<pisa::optpfor_block>();
 }
+
+TEST_CASE("find_geq")
+{
+    std::mt19937 rng(1729);
+    for (size_t size : {1, 2, 9, 17, 100, 70000}) {
+        std::vector<uint32_t> values(size);
+        for (auto &value : values) {
+            value = rng() % (4 * size);
+        }
+        std::sort(values.begin(), values.end());
+        values.back() = uint32_t(-1);
+        for (size_t t = 0; t < 1000; ++t) {
+            size_t begin = rng() % size;
+            uint32_t target =
+                t % 2 == 0 ? values[begin + rng() % (size - begin)] : rng() % (4 * size);
+            size_t expected =
+                std::lower_bound(values.begin() + begin, values.end(), target) - values.begin();
+            MY_REQUIRE_EQUAL(expected,
+                             pisa::find_geq(values.data(), begin, size, target),
+                             "size = " << size << " begin = " << begin << " target = " << target);
+        }
+    }
+}
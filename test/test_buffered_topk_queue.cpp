@@ -0,0 +1,70 @@
+#define CATCH_CONFIG_MAIN
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "buffered_topk_queue.hpp"
+#include "topk_queue.hpp"
+
+using namespace pisa;
+
+TEST_CASE("Buffered top-k matches the heap", "[topk_queue]")
+{
+    // Distinct scores, so that ties do not depend on the heap order.
+    std::vector<float> scores(20000);
+    std::iota(scores.begin(), scores.end(), 1.0F);
+    std::shuffle(scores.begin(), scores.end(), std::mt19937(1729));
+    for (uint64_t k : {1, 10, 100, 1000}) {
+        for (uint64_t buffer_size : {0, 1, 7, 5000}) {
+            CAPTURE(k, buffer_size);
+            topk_queue heap(k);
+            buffered_topk_queue buffered(k, buffer_size);
+            for (uint64_t docid = 0; docid < scores.size(); ++docid) {
+                float score = scores[docid];
+                heap.insert(score, docid);
+                buffered.insert(score, docid);
+                REQUIRE(buffered.threshold() <= heap.threshold());
+            }
+            heap.finalize();
+            buffered.finalize();
+            CHECK(buffered.topk() == heap.topk());
+        }
+    }
+}
+
+TEST_CASE("Buffered top-k thresholds", "[topk_queue]")
+{
+    buffered_topk_queue topk(2, 1);
+    topk.set_threshold(1.0F);
+    CHECK_FALSE(topk.insert(1.0F, 0));
+    CHECK(topk.insert(2.0F, 1));
+    CHECK_FALSE(topk.full());
+    CHECK(topk.insert(3.0F, 2));
+    CHECK(topk.full());
+    CHECK(topk.threshold() == 1.0F);
+    CHECK(topk.insert(4.0F, 3));
+    CHECK(topk.threshold() == 3.0F);
+    CHECK_FALSE(topk.would_enter(3.0F));
+
+    topk.reset(3);
+    CHECK(topk.size() == 3);
+    CHECK(topk.threshold() == 0.0F);
+    CHECK_FALSE(topk.insert(0.0F, 4));
+    topk.insert(1.0F, 5);
+    topk.finalize();
+    CHECK(topk.topk() == std::vector<topk_queue::entry_type>{{1.0F, 5}});
+}
+
+TEST_CASE("Buffered top-k keeps the first ties", "[topk_queue]")
+{
+    buffered_topk_queue topk(3, 1);
+    for (uint64_t docid = 0; docid < 10; ++docid) {
+        topk.insert(docid == 5 ? 2.0F : 1.0F, docid);
+    }
+    topk.finalize();
+    CHECK(topk.topk() == std::vector<topk_queue::entry_type>{{2.0F, 5}, {1.0F, 0}, {1.0F, 1}});
+}
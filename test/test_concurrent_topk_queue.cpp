@@ -0,0 +1,75 @@
+#define CATCH_CONFIG_MAIN
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "concurrent_topk_queue.hpp"
+#include "topk_queue.hpp"
+
+using namespace pisa;
+
+TEST_CASE("Concurrent top-k matches the heap", "[topk_queue]")
+{
+    // Distinct scores, so that ties do not depend on the order of insertion.
+    std::vector<float> scores(100000);
+    std::iota(scores.begin(), scores.end(), 1.0F);
+    std::shuffle(scores.begin(), scores.end(), std::mt19937(1729));
+    for (uint64_t k : {1, 10, 1000}) {
+        for (std::size_t num_threads : {1, 4}) {
+            CAPTURE(k, num_threads);
+            topk_queue heap(k);
+            for (uint64_t docid = 0; docid < scores.size(); ++docid) {
+                heap.insert(scores[docid], docid);
+            }
+            heap.finalize();
+
+            concurrent_topk_queue topk(k);
+            std::vector<std::thread> threads;
+            for (std::size_t thread = 0; thread < num_threads; ++thread) {
+                threads.emplace_back([&, thread] {
+                    concurrent_topk_queue::local_queue local(topk);
+                    for (uint64_t docid = thread; docid < scores.size(); docid += num_threads) {
+                        local.insert(scores[docid], docid);
+                    }
+                    local.finalize();
+                });
+            }
+            for (auto &thread : threads) {
+                thread.join();
+            }
+            topk.finalize();
+            CHECK(topk.topk() == heap.topk());
+            CHECK(topk.threshold() <= heap.topk().back().first);
+        }
+    }
+}
+
+TEST_CASE("Concurrent top-k shares the threshold", "[topk_queue]")
+{
+    concurrent_topk_queue topk(2, 1.0F);
+    concurrent_topk_queue::local_queue first(topk);
+    concurrent_topk_queue::local_queue second(topk);
+    CHECK_FALSE(first.insert(1.0F, 0));
+    CHECK(first.insert(3.0F, 1));
+    CHECK(first.threshold() == 1.0F);
+    CHECK(first.insert(4.0F, 2));
+    CHECK(first.full());
+    CHECK(topk.threshold() == 3.0F);
+    CHECK(second.threshold() == 3.0F);
+    CHECK_FALSE(second.would_enter(3.0F));
+    CHECK_FALSE(second.insert(2.0F, 3));
+    CHECK(second.insert(5.0F, 4));
+
+    second.set_threshold(2.0F);
+    CHECK(topk.threshold() == 3.0F);
+
+    first.finalize();
+    second.finalize();
+    topk.finalize();
+    CHECK(topk.topk() == std::vector<topk_queue::entry_type>{{5.0F, 4}, {4.0F, 2}});
+}
@@ -0,0 +1,39 @@
+#define CATCH_CONFIG_MAIN
+
+#include <thread>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "query/fused_threshold.hpp"
+
+using namespace pisa;
+
+TEST_CASE("Fused threshold subtracts the bounds of other variations", "[fusion][threshold]")
+{
+    fused_threshold shared({1.0F, 2.0F, 4.0F});
+    REQUIRE(shared.lower_bound() == 0.0F);
+    shared.publish(10.0F);
+    REQUIRE(shared.threshold(0) == Approx(4.0F));
+    REQUIRE(shared.threshold(1) == Approx(5.0F));
+    REQUIRE(shared.threshold(2) == Approx(7.0F));
+}
+
+TEST_CASE("Fused threshold only increases", "[fusion][threshold]")
+{
+    fused_threshold shared({1.0F});
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&shared, t] {
+            for (int i = 0; i < 1000; ++i) {
+                shared.publish(static_cast<float>((i * 7 + t) % 1000));
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    REQUIRE(shared.lower_bound() == 999.0F);
+    shared.publish(5.0F);
+    REQUIRE(shared.lower_bound() == 999.0F);
+}
@@ -0,0 +1,105 @@
+#define CATCH_CONFIG_MAIN
+
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "query/fusion.hpp"
+
+using namespace pisa;
+
+namespace {
+
+using result_list = result_fusion::result_list;
+
+std::vector<result_list> const lists = {
+    {{3.0, 10}, {2.0, 20}, {1.0, 30}},
+    {{4.0, 20}, {0.5, 40}},
+    {},
+};
+
+} // namespace
+
+TEST_CASE("CombSUM sums scores", "[fusion]")
+{
+    result_fusion fusion(fusion_method::combsum, 10);
+    auto fused = fusion(lists);
+    REQUIRE(fused == result_list{{6.0, 20}, {3.0, 10}, {1.0, 30}, {0.5, 40}});
+}
+
+TEST_CASE("CombMNZ multiplies by the number of matching lists", "[fusion]")
+{
+    result_fusion fusion(fusion_method::combmnz, 2);
+    auto fused = fusion(lists);
+    REQUIRE(fused == result_list{{12.0, 20}, {3.0, 10}});
+}
+
+TEST_CASE("RRF uses reciprocal ranks", "[fusion]")
+{
+    result_fusion fusion(fusion_method::rrf, 10, 60.0F);
+    auto fused = fusion(lists);
+    REQUIRE(fused.size() == 4);
+    REQUIRE(fused[0].second == 20);
+    REQUIRE(fused[0].first == Approx(1.0 / 62 + 1.0 / 61));
+    REQUIRE(fused[1].second == 10);
+    REQUIRE(fused[1].first == Approx(1.0 / 61));
+    REQUIRE(fused[2].second == 40);
+    REQUIRE(fused[3].second == 30);
+}
+
+TEST_CASE("Borda awards points by rank", "[fusion]")
+{
+    result_fusion fusion(fusion_method::borda, 10);
+    auto fused = fusion(lists);
+    REQUIRE(fused.size() == 4);
+    REQUIRE(fused[0] == std::make_pair(4.0F, uint64_t{20}));
+    REQUIRE(fused[1] == std::make_pair(3.0F, uint64_t{10}));
+    REQUIRE(fused[2].first == 1.0);
+    REQUIRE(fused[3].first == 1.0);
+}
+
+TEST_CASE("Fusion can be reused across topics", "[fusion]")
+{
+    result_fusion fusion(fusion_method::combsum, 10);
+    fusion(lists);
+    auto fused = fusion(std::vector<result_list>{{{1.0, 5}}});
+    REQUIRE(fused == result_list{{1.0, 5}});
+}
+
+TEST_CASE("Heap merge fuses like the accumulator", "[fusion]")
+{
+    for (auto method : {fusion_method::combsum,
+                        fusion_method::combmnz,
+                        fusion_method::rrf,
+                        fusion_method::borda}) {
+        result_fusion accumulated(method, 10);
+        result_fusion merged(method, 10, fusion_strategy::heap_merge);
+        REQUIRE(merged.strategy() == fusion_strategy::heap_merge);
+        auto expected = accumulated(lists);
+        auto fused = merged(lists);
+        REQUIRE(fused.size() == expected.size());
+        for (size_t rank = 0; rank < fused.size(); ++rank) {
+            REQUIRE(fused[rank].first == Approx(expected[rank].first));
+        }
+        REQUIRE(fused.front() == expected.front());
+    }
+}
+
+TEST_CASE("Fusion accumulator starts empty after reset", "[fusion][accumulator]")
+{
+    fusion_accumulator accumulator;
+    topk_queue topk(10);
+    for (std::size_t entries : {1, 100, 3}) {
+        accumulator.reset(entries);
+        for (uint64_t docid = 0; docid < entries; ++docid) {
+            accumulator.accumulate(docid * 1000, 1.0F);
+            accumulator.accumulate(docid * 1000, 2.0F);
+        }
+        REQUIRE(accumulator.size() == entries);
+        topk.clear();
+        accumulator.aggregate(topk, true);
+        topk.finalize();
+        REQUIRE(topk.topk().size() == std::min<std::size_t>(entries, 10));
+        REQUIRE(topk.topk().front().first == 6.0F);
+    }
+}
@@ -0,0 +1,169 @@
+#define CATCH_CONFIG_MAIN
+
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "accumulator/simple_accumulator.hpp"
+#include "impact_ordered_index.hpp"
+#include "query/algorithm/saat_query.hpp"
+
+using namespace pisa;
+
+namespace {
+
+struct term_postings {
+    std::vector<uint32_t> docs;
+    std::vector<uint32_t> freqs;
+};
+
+constexpr uint64_t num_docs = 1000;
+constexpr float max_score = 10.0F;
+
+auto score(uint32_t doc, uint32_t freq) -> float
+{
+    return static_cast<float>((doc * 7 + freq * 13) % 100) / 10.0F;
+}
+
+auto random_postings(std::mt19937 &rng, size_t num_terms) -> std::vector<term_postings>
+{
+    std::bernoulli_distribution keep(0.2);
+    std::uniform_int_distribution<uint32_t> freq(1, 20);
+    std::vector<term_postings> terms(num_terms);
+    for (auto &term : terms) {
+        for (uint32_t doc = 0; doc < num_docs; ++doc) {
+            if (keep(rng)) {
+                term.docs.push_back(doc);
+                term.freqs.push_back(freq(rng));
+            }
+        }
+    }
+    return terms;
+}
+
+void build_index(impact_ordered_index &index,
+                 std::vector<term_postings> const &terms,
+                 uint32_t levels)
+{
+    impact_ordered_index::builder builder(num_docs, max_score, levels);
+    for (auto const &term : terms) {
+        builder.add_posting_list(term.docs.size(), term.docs.begin(), term.freqs.begin(), score);
+    }
+    builder.build(index);
+}
+
+} // namespace
+
+TEST_CASE("Impact-ordered index segments", "[saat]")
+{
+    std::mt19937 rng(42);
+    auto terms = random_postings(rng, 10);
+    impact_ordered_index index;
+    build_index(index, terms, 64);
+    REQUIRE(index.size() == terms.size());
+    REQUIRE(index.num_docs() == num_docs);
+    float scale = index.quantization_scale();
+
+    for (uint64_t term = 0; term < terms.size(); ++term) {
+        std::unordered_map<uint32_t, uint32_t> impacts;
+        for (uint64_t i = 0; i < index.num_segments(term); ++i) {
+            auto segment = index.get_segment(term, i);
+            REQUIRE(segment.size() > 0);
+            if (i > 0) {
+                REQUIRE(segment.impact < index.get_segment(term, i - 1).impact);
+            }
+            REQUIRE(std::is_sorted(segment.begin, segment.end));
+            for (auto doc = segment.begin; doc != segment.end; ++doc) {
+                impacts[*doc] = segment.impact;
+            }
+        }
+        for (size_t i = 0; i < terms[term].docs.size(); ++i) {
+            auto doc = terms[term].docs[i];
+            auto s = score(doc, terms[term].freqs[i]);
+            if (s > 0) {
+                REQUIRE(impacts.count(doc) == 1);
+                REQUIRE(impacts[doc] * scale >= Approx(s));
+                REQUIRE((impacts[doc] - 1) * scale < s + 1e-4F);
+            } else {
+                REQUIRE(impacts.count(doc) == 0);
+            }
+        }
+    }
+}
+
+TEST_CASE("Impact-ordered index levels and terms", "[saat]")
+{
+    REQUIRE_THROWS_AS(impact_ordered_index::builder(num_docs, max_score, 0),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(impact_ordered_index::builder(
+                          num_docs, max_score, impact_ordered_index::max_impact_levels + 1),
+                      std::invalid_argument);
+
+    std::mt19937 rng(42);
+    impact_ordered_index index;
+    build_index(index, random_postings(rng, 3), 1);
+    struct query {
+        std::vector<uint32_t> terms;
+    };
+    REQUIRE(not find_missing_term(index, std::vector<query>{{{0, 2}}}));
+    REQUIRE(find_missing_term(index, std::vector<query>{{{0}}, {{1, 3}}}) == 3U);
+}
+
+TEST_CASE("Score-at-a-time query", "[saat]")
+{
+    std::mt19937 rng(7);
+    auto terms = random_postings(rng, 5);
+    impact_ordered_index index;
+    build_index(index, terms, 255);
+    std::vector<std::pair<uint32_t, float>> query{{0, 1.0F}, {2, 2.0F}, {4, 0.5F}};
+    uint64_t k = 10;
+
+    std::vector<float> expected_scores(num_docs, 0.0F);
+    uint64_t total_postings = 0;
+    for (auto const &[term, weight] : query) {
+        for (uint64_t i = 0; i < index.num_segments(term); ++i) {
+            auto segment = index.get_segment(term, i);
+            for (auto doc = segment.begin; doc != segment.end; ++doc) {
+                expected_scores[*doc] += weight * segment.impact * index.quantization_scale();
+            }
+            total_postings += segment.size();
+        }
+    }
+    topk_queue expected(k);
+    for (uint64_t doc = 0; doc < num_docs; ++doc) {
+        expected.insert(expected_scores[doc], doc);
+    }
+    expected.finalize();
+
+    Simple_Accumulator accumulator(num_docs);
+
+    SECTION("Exhaustive")
+    {
+        topk_queue topk(k);
+        saat_query saat_q(topk);
+        saat_q(index, query, accumulator);
+        topk.finalize();
+        REQUIRE(not saat_q.terminated_early());
+        REQUIRE(saat_q.postings() == total_postings);
+        REQUIRE(topk.topk().size() == expected.topk().size());
+        for (size_t i = 0; i < topk.topk().size(); ++i) {
+            REQUIRE(topk.topk()[i].first == Approx(expected.topk()[i].first));
+        }
+    }
+
+    SECTION("Postings budget")
+    {
+        topk_queue topk(k);
+        saat_query saat_q(topk, total_postings / 2);
+        saat_q(index, query, accumulator);
+        topk.finalize();
+        REQUIRE(saat_q.terminated_early());
+        REQUIRE(saat_q.postings() >= total_postings / 2);
+        REQUIRE(saat_q.postings() < total_postings);
+        for (size_t i = 0; i < topk.topk().size(); ++i) {
+            REQUIRE(topk.topk()[i].first <= Approx(expected_scores[topk.topk()[i].second]));
+        }
+    }
+}
@@ -0,0 +1,49 @@
+#define CATCH_CONFIG_MAIN
+
+#include <catch2/catch.hpp>
+
+#include "linear_quantizer.hpp"
+#include "scorer/quantized.hpp"
+
+using namespace pisa;
+
+TEST_CASE("Linear quantizer", "[quantization]")
+{
+    linear_quantizer quantizer(10.0F, 8);
+    REQUIRE(quantizer.max_impact() == 255);
+
+    SECTION("Bounds")
+    {
+        REQUIRE(quantizer(0.0F) == 1);
+        REQUIRE(quantizer(-1.0F) == 1);
+        REQUIRE(quantizer(10.0F) == 255);
+        REQUIRE(quantizer(20.0F) == 255);
+    }
+
+    SECTION("Monotonic")
+    {
+        uint32_t previous = quantizer(0.0F);
+        for (float score = 0.0F; score <= 10.0F; score += 0.01F) {
+            auto impact = quantizer(score);
+            REQUIRE(impact >= previous);
+            previous = impact;
+        }
+    }
+
+    SECTION("Invalid bits")
+    {
+        REQUIRE_THROWS_AS(linear_quantizer(10.0F, 1), std::invalid_argument);
+        REQUIRE_THROWS_AS(linear_quantizer(10.0F, 17), std::invalid_argument);
+        REQUIRE(linear_quantizer(10.0F, 16).max_impact() == 65535);
+    }
+}
+
+TEST_CASE("Quantized scorer returns stored impacts", "[quantization][scorer]")
+{
+    struct no_wand_data {
+    } wdata;
+    quantized<no_wand_data> scorer(wdata);
+    auto score = scorer.term_scorer(0);
+    REQUIRE(score(10, 1) == 1.0F);
+    REQUIRE(score(3, 255) == 255.0F);
+}
@@ -126,3 +126,44 @@ TEST_CASE("Check if term is stopword")
     REQUIRE(!tprocessor.is_stopword(4));
     REQUIRE(!tprocessor.is_stopword(5));
 }
+
+TEST_CASE("Parse weighted query term ids") {
+    auto q = parse_query_ids("1: 1:0.5\t2 3:2");
+    REQUIRE(q.id == "1");
+    REQUIRE(q.terms == std::vector<std::uint32_t>{1, 2, 3});
+    REQUIRE(q.term_weights == std::vector<float>{0.5, 1.0, 2.0});
+}
+
+TEST_CASE("Split only finite, positive term weights") {
+    REQUIRE(split_term_weight("12:0.5")
+            == std::make_pair(std::string_view("12"), std::optional<float>(0.5)));
+    for (auto token : {"12:nan", "12:inf", "12:-1", "12:0", "12:", "12:x", "12"}) {
+        REQUIRE(split_term_weight(token)
+                == std::make_pair(std::string_view(token), std::optional<float>{}));
+    }
+}
+
+TEST_CASE("Sum term weights") {
+    Query q{std::nullopt, {3, 1, 3}, {}};
+    REQUIRE(query_term_weights(q) == std::vector<std::pair<term_id_type, float>>{{1, 1}, {3, 2}});
+    q.term_weights = {0.5, 1.0, 0.25};
+    REQUIRE(query_term_weights(q)
+            == std::vector<std::pair<term_id_type, float>>{{1, 1}, {3, 0.75}});
+    remove_duplicate_terms(q);
+    REQUIRE(q.terms == std::vector<term_id_type>{1, 3});
+    REQUIRE(q.term_weights == std::vector<float>{1.0, 0.75});
+}
+
+TEST_CASE("Convert weighted multi-queries") {
+    auto multi_queries = generate_multi_queries({parse_query_ids("1: 1:0.5 2:0.5"),
+                                                 parse_query_ids("1: 2:0.25 3"),
+                                                 parse_query_ids("1: 2")});
+    REQUIRE(multi_queries.size() == 1);
+    auto spcs = multi_query_to_spcs(multi_queries);
+    REQUIRE(spcs.size() == 1);
+    REQUIRE(query_term_weights(spcs[0])
+            == std::vector<std::pair<term_id_type, float>>{{1, 0.5}, {2, 1.75}, {3, 1}});
+    auto shared = multi_query_to_shared(multi_queries[0]);
+    REQUIRE(shared.terms == std::vector<term_id_type>{1, 2, 3});
+    REQUIRE(shared.variations[1] == std::vector<std::pair<uint32_t, float>>{{1, 0.25}, {2, 1}});
+}
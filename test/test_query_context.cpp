@@ -0,0 +1,86 @@
+#define CATCH_CONFIG_MAIN
+
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "query/queries.hpp"
+#include "query/query_context.hpp"
+
+using namespace pisa;
+
+TEST_CASE("Buffers are reused", "[query_context]")
+{
+    query_context context;
+    auto &first = context.buffer<int>();
+    first.assign(100, 1);
+    auto *data = first.data();
+
+    auto &second = context.buffer<int>();
+    CHECK(&second == &first);
+    CHECK(second.empty());
+    CHECK(second.capacity() >= 100);
+    second.assign(50, 2);
+    CHECK(second.data() == data);
+
+    auto &other_slot = context.buffer<int>(1);
+    CHECK(&other_slot != &first);
+    other_slot.push_back(3);
+    CHECK(&context.buffer<int>(1) == &other_slot);
+    CHECK(first.size() == 50);
+
+    auto &other_type = context.buffer<float>();
+    other_type.push_back(1.0F);
+    CHECK(first.size() == 50);
+
+    query_context copy(context);
+    CHECK(&copy.buffer<int>() != &first);
+    CHECK(copy.buffer<int>().capacity() == 0);
+}
+
+TEST_CASE("Top-k queue is reset", "[query_context]")
+{
+    query_context context;
+    auto &topk = context.topk(2);
+    topk.set_threshold(1.0F);
+    topk.insert(3.0F, 1);
+    topk.insert(2.0F, 2);
+    topk.insert(4.0F, 3);
+    CHECK(topk.full());
+
+    auto &reset = context.topk(3);
+    CHECK(&reset == &topk);
+    CHECK(reset.size() == 3);
+    CHECK(reset.threshold() == 0.0F);
+    CHECK_FALSE(reset.full());
+    reset.insert(1.0F, 4);
+    reset.finalize();
+    CHECK(reset.topk() == std::vector<std::pair<float, uint64_t>>{{1.0F, 4}});
+}
+
+TEST_CASE("Scratch buffers", "[query_context]")
+{
+    std::vector<int> fallback{1, 2};
+    CHECK(&scratch_buffer<int>(nullptr, fallback) == &fallback);
+    CHECK(fallback.empty());
+
+    query_context context;
+    fallback.push_back(1);
+    CHECK(&scratch_buffer(&context, fallback) == &context.buffer<int>());
+    CHECK(fallback.size() == 1);
+}
+
+TEST_CASE("Term weights into reused storage", "[query_context]")
+{
+    query_context context;
+    auto &term_weights = context.buffer<std::pair<term_id_type, float>>();
+    for (auto const &query : {Query{"1", {3, 1, 3, 2}, {}},
+                              Query{"2", {4, 4}, {0.5F, 2.0F}},
+                              Query{"3", {}, {}}}) {
+        query_term_weights(query, term_weights);
+        CHECK(term_weights == query_term_weights(query));
+    }
+    query_term_weights(Query{"1", {3, 1, 3, 2}, {}}, term_weights);
+    CHECK(term_weights
+          == std::vector<std::pair<term_id_type, float>>{{1, 1.0F}, {2, 1.0F}, {3, 2.0F}});
+}
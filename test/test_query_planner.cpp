@@ -0,0 +1,113 @@
+#define CATCH_CONFIG_MAIN
+
+#include <array>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "query/query_planner.hpp"
+
+using namespace pisa;
+
+namespace {
+
+struct posting_counts {
+    std::vector<size_t> counts;
+    [[nodiscard]] auto term_posting_count(uint64_t term_id) const -> size_t
+    {
+        return counts[term_id];
+    }
+};
+
+[[nodiscard]] auto features_of(double variations, double postings) -> plan_features
+{
+    plan_features f;
+    f[plan_feature::variations] = variations;
+    f[plan_feature::postings] = postings;
+    f[plan_feature::variation_postings] = variations * postings;
+    return f;
+}
+
+// Parallel runs cost per variation, SP-CS only per posting.
+[[nodiscard]] auto training_samples() -> std::vector<plan_sample>
+{
+    std::vector<plan_sample> samples;
+    for (double variations : {1, 2, 4, 8, 16}) {
+        for (double postings : {1000, 10000, 100000}) {
+            auto f = features_of(variations, postings);
+            samples.push_back({query_plan::spcs_maxscore, f, 50 + 0.01 * postings});
+            samples.push_back(
+                {query_plan::parallel_maxscore, f, 20 * variations + 0.002 * postings});
+        }
+    }
+    return samples;
+}
+
+} // namespace
+
+TEST_CASE("Plan features", "[query_planner]")
+{
+    posting_counts wdata{{10, 20, 30, 40}};
+    multi_query m_query = {Query{"1", {0, 1}, {}}, Query{"1", {1, 2, 2}, {}}, Query{"1", {1}, {}}};
+    auto f = plan_features::from_query(m_query, wdata, 10);
+    CHECK(f[plan_feature::variations] == 3);
+    CHECK(f[plan_feature::distinct_terms] == 3);
+    CHECK(f[plan_feature::term_occurrences] == 5);
+    CHECK(f[plan_feature::overlap] == Approx(5.0 / 3));
+    CHECK(f[plan_feature::postings] == 60);
+    CHECK(f[plan_feature::variation_postings] == 100);
+    CHECK(f[plan_feature::max_postings] == 30);
+    CHECK(f[plan_feature::k] == 10);
+}
+
+TEST_CASE("Fit and choose plans", "[query_planner]")
+{
+    auto planner = query_planner::fit(training_samples());
+    REQUIRE(planner.has(query_plan::spcs_maxscore));
+    REQUIRE(planner.has(query_plan::parallel_maxscore));
+    CHECK_FALSE(planner.has(query_plan::taat));
+
+    auto many_short = features_of(16, 1000);
+    auto few_long = features_of(2, 100000);
+    CHECK(planner.predict(query_plan::spcs_maxscore, many_short) == Approx(60).epsilon(0.01));
+    CHECK(planner.predict(query_plan::parallel_maxscore, few_long) == Approx(240).epsilon(0.01));
+    CHECK_FALSE(planner.empty());
+    CHECK(planner.choose(many_short) == query_plan::spcs_maxscore);
+    CHECK(planner.choose(few_long) == query_plan::parallel_maxscore);
+
+    std::stringstream model;
+    planner.write(model);
+    auto loaded = query_planner::read(model);
+    CHECK_FALSE(loaded.has(query_plan::taat));
+    for (auto f : {many_short, few_long}) {
+        for (auto plan : {query_plan::spcs_maxscore, query_plan::parallel_maxscore}) {
+            CHECK(loaded.predict(plan, f) == Approx(planner.predict(plan, f)).epsilon(1e-4));
+        }
+    }
+    CHECK(query_planner{}.empty());
+    CHECK_THROWS(query_planner{}.choose(many_short));
+}
+
+TEST_CASE("Plan log", "[query_planner]")
+{
+    auto samples = training_samples();
+    std::stringstream log;
+    write_plan_log_header(log);
+    // Query IDs may be missing or contain spaces, which must not shift the other columns.
+    std::array<std::string, 3> qids{"q", "", "query 1"};
+    for (size_t i = 0; i < samples.size(); ++i) {
+        auto const &sample = samples[i];
+        write_plan_log_line(log, qids[i % 3], sample.plan, 0, sample.usecs, sample.features);
+    }
+    auto read = read_plan_log(log);
+    REQUIRE(read.size() == samples.size());
+    for (size_t i = 0; i < samples.size(); ++i) {
+        CHECK(read[i].plan == samples[i].plan);
+        CHECK(read[i].usecs == Approx(samples[i].usecs));
+        for (size_t f = 0; f < num_plan_features; ++f) {
+            CHECK(read[i].features[f] == Approx(samples[i].features[f]));
+        }
+    }
+}
@@ -2,17 +2,24 @@
 
 #include <catch2/catch.hpp>
 #include <functional>
+#include <limits>
 
 #include <tbb/task_scheduler_init.h>
 
 #include "test_common.hpp"
 
 #include "accumulator/lazy_accumulator.hpp"
+#include "buffered_topk_queue.hpp"
 #include "cursor/block_max_scored_cursor.hpp"
+#include "cursor/block_scored_cursor.hpp"
+#include "cursor/cursor.hpp"
 #include "cursor/max_scored_cursor.hpp"
 #include "cursor/scored_cursor.hpp"
 #include "index_types.hpp"
 #include "pisa_config.hpp"
+#include "query/fused_threshold.hpp"
+#include "query/fusion.hpp"
+#include "query/multi_query_thresholds.hpp"
 #include "query/queries.hpp"
 
 using namespace pisa;
@@ -97,6 +104,30 @@ class range_query_128 : public range_query<T> {
     }
 };
 
+using result_list = std::vector<std::pair<float, uint64_t>>;
+
+// Top 10 of `query`, weighted by `q_weight`, by exhaustive ranked_or.
+template <typename Index, typename Scorer>
+auto ranked_or_topk(Index const &index, Scorer const &scorer, Query const &query) -> result_list
+{
+    topk_queue topk(10);
+    ranked_or_query or_q(topk);
+    or_q.multi_query(make_scored_cursors(index, scorer, query), index.num_docs());
+    topk.finalize();
+    return topk.topk();
+}
+
+// Requires `actual` to have the scores of `expected`, within `epsilon` relative to each score.
+void require_same_scores(result_list const &expected,
+                         result_list const &actual,
+                         double epsilon = std::numeric_limits<float>::epsilon() * 100)
+{
+    REQUIRE(actual.size() == expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        REQUIRE(actual[i].first == Approx(expected[i].first).epsilon(epsilon));
+    }
+}
+
 TEMPLATE_TEST_CASE("Ranked query test",
                    "[query][ranked][integration]",
                    ranked_or_taat_query_acc<Simple_Accumulator>,
@@ -169,6 +200,161 @@ TEMPLATE_TEST_CASE("Ranked AND query test",
     }
 }
 
+TEMPLATE_TEST_CASE("Static scorer query test",
+                   "[query][ranked][integration]",
+                   wand_query,
+                   maxscore_query,
+                   block_max_wand_query,
+                   block_max_maxscore_query)
+{
+    for (auto &&s_name : {"bm25", "qld"}) {
+        std::unordered_set<size_t> dropped_term_ids;
+        auto data = IndexData<single_index>::get(s_name, dropped_term_ids);
+        topk_queue topk_1(10);
+        TestType op_q(topk_1);
+        topk_queue topk_2(10);
+        TestType static_q(topk_2);
+
+        auto scorer = scorer::from_name(s_name, data->wdata);
+        scorer::with_static_scorer(s_name, data->wdata, [&](auto const &static_scorer) {
+            for (auto const &q : data->queries) {
+                op_q(make_block_max_scored_cursors(data->index, data->wdata, *scorer, q),
+                     data->index.num_docs());
+                static_q(make_block_max_scored_cursors(data->index, data->wdata, static_scorer, q),
+                         data->index.num_docs());
+                topk_1.finalize();
+                topk_2.finalize();
+                // Inlining may contract floating-point operations differently.
+                require_same_scores(topk_1.topk(), topk_2.topk());
+                topk_1.clear();
+                topk_2.clear();
+            }
+        });
+    }
+}
+
+TEMPLATE_TEST_CASE("Block scoring query test",
+                   "[query][ranked][integration]",
+                   ranked_or_query,
+                   maxscore_query,
+                   ranked_or_taat_query_acc<Simple_Accumulator>,
+                   range_query_128<ranked_or_taat_query_acc<Simple_Accumulator>>)
+{
+    for (auto &&s_name : {"bm25", "qld"}) {
+        std::unordered_set<size_t> dropped_term_ids;
+        auto data = IndexData<block_simdbp_index>::get(s_name, dropped_term_ids);
+        topk_queue topk_1(10);
+        TestType op_q(topk_1);
+        topk_queue topk_2(10);
+        TestType block_q(topk_2);
+
+        auto scorer = scorer::from_name(s_name, data->wdata);
+        for (auto const &q : data->queries) {
+            op_q(make_max_scored_cursors(data->index, data->wdata, *scorer, q),
+                 data->index.num_docs());
+            block_q(make_block_scored_cursors(data->index, data->wdata, s_name, q),
+                    data->index.num_docs());
+            topk_1.finalize();
+            topk_2.finalize();
+            // Vector kernels may contract floating-point operations differently.
+            require_same_scores(topk_1.topk(), topk_2.topk());
+            topk_1.clear();
+            topk_2.clear();
+        }
+    }
+}
+
+TEMPLATE_TEST_CASE("Multi-query TAAT test",
+                   "[query][ranked][integration]",
+                   Simple_Accumulator,
+                   Lazy_Accumulator<4>)
+{
+    for (auto &&s_name : {"bm25", "qld"}) {
+        std::unordered_set<size_t> dropped_term_ids;
+        auto data = IndexData<single_index>::get(s_name, dropped_term_ids);
+        auto scorer = scorer::from_name(s_name, data->wdata);
+        TestType accumulator(data->index.num_docs());
+
+        // Fuse consecutive queries, so that shared terms get summed weights.
+        for (size_t first = 0; first < data->queries.size(); first += 3) {
+            Query fused;
+            for (size_t q = first; q < std::min(first + 3, data->queries.size()); ++q) {
+                auto const &terms = data->queries[q].terms;
+                fused.terms.insert(fused.terms.end(), terms.begin(), terms.end());
+            }
+            topk_queue topk_1(10);
+            ranked_or_taat_query taat_q(topk_1);
+            taat_q.multi_query(make_scored_cursors(data->index, *scorer, fused),
+                               data->index.num_docs(),
+                               accumulator);
+            topk_1.finalize();
+            require_same_scores(ranked_or_topk(data->index, *scorer, fused), topk_1.topk());
+        }
+    }
+}
+
+TEMPLATE_TEST_CASE("Documents scored",
+                   "[query][ranked][integration]",
+                   block_max_wand_query,
+                   block_max_maxscore_query)
+{
+    for (auto &&s_name : {"bm25", "qld"}) {
+        std::unordered_set<size_t> dropped_term_ids;
+        auto data = IndexData<single_index>::get(s_name, dropped_term_ids);
+        auto scorer = scorer::from_name(s_name, data->wdata);
+        for (auto const &q : data->queries) {
+            topk_queue topk(10);
+            TestType op_q(topk);
+            op_q.multi_query(make_block_max_scored_cursors(data->index, data->wdata, *scorer, q),
+                             data->index.num_docs());
+            topk.finalize();
+            or_query<false> or_q;
+            auto matching = or_q(make_cursors(data->index, q), data->index.num_docs());
+            REQUIRE(op_q.documents_scored() >= topk.topk().size());
+            REQUIRE(op_q.documents_scored() <= matching);
+        }
+    }
+}
+
+TEMPLATE_TEST_CASE("Conjunctive-first query test",
+                   "[query][ranked][integration]",
+                   block_max_wand_query,
+                   block_max_maxscore_query)
+{
+    // The conjunctive pass bounds fused scores from below only with non-negative term scores.
+    std::unordered_set<size_t> dropped_term_ids;
+    auto data = IndexData<single_index>::get("bm25", dropped_term_ids);
+    auto scorer = scorer::from_name("bm25", data->wdata);
+
+    // Fuse consecutive queries, so that shared terms get summed weights.
+    for (size_t first = 0; first < data->queries.size(); first += 3) {
+        Query fused;
+        for (size_t q = first; q < std::min(first + 3, data->queries.size()); ++q) {
+            auto const &terms = data->queries[q].terms;
+            fused.terms.insert(fused.terms.end(), terms.begin(), terms.end());
+        }
+        topk_queue topk_1(10);
+        conjunctive_first_query<TestType> op_q(topk_1, 2);
+        op_q.multi_query(make_block_max_scored_cursors(data->index, data->wdata, *scorer, fused),
+                         make_block_max_scored_cursors(data->index, data->wdata, *scorer, fused),
+                         data->index.num_docs());
+        topk_1.finalize();
+        require_same_scores(ranked_or_topk(data->index, *scorer, fused), topk_1.topk());
+    }
+}
+
+TEMPLATE_TEST_CASE("Conjunctive-first query rejects signed scorers",
+                   "[query][ranked][unit]",
+                   block_max_wand_query,
+                   block_max_maxscore_query)
+{
+    CHECK(conjunctive_first_query<TestType>::supports("bm25"));
+    CHECK(conjunctive_first_query<TestType>::supports("quantized"));
+    CHECK_FALSE(conjunctive_first_query<TestType>::supports("qld"));
+    CHECK_FALSE(conjunctive_first_query<TestType>::supports("pl2"));
+    CHECK_FALSE(conjunctive_first_query<TestType>::supports("dph"));
+}
+
 TEST_CASE("Top k")
 {
     for (auto &&s_name : {"bm25", "qld"}) {
@@ -196,3 +382,213 @@ TEST_CASE("Top k")
         }
     }
 }
+
+TEST_CASE("Shared MaxScore query test", "[query][ranked][integration]")
+{
+    for (auto &&s_name : {"bm25", "qld"}) {
+        std::unordered_set<size_t> dropped_term_ids;
+        auto data = IndexData<single_index>::get(s_name, dropped_term_ids);
+        auto scorer = scorer::from_name(s_name, data->wdata);
+
+        // Treat consecutive queries as the variations of a single multi-query.
+        for (size_t first = 0; first < data->queries.size(); first += 3) {
+            multi_query m_query(data->queries.begin() + first,
+                                data->queries.begin()
+                                    + std::min(first + 3, data->queries.size()));
+            for (auto &q : m_query) {
+                remove_duplicate_terms(q.terms);
+            }
+            auto shared = multi_query_to_shared(m_query);
+            std::vector<topk_queue> topks(m_query.size(), topk_queue(10));
+            shared_maxscore_query shared_q(topks);
+            shared_q(make_max_scored_cursors(data->index, data->wdata, *scorer, shared.as_query()),
+                     shared.variations,
+                     data->index.num_docs());
+            std::vector<buffered_topk_queue> buffered(m_query.size(), buffered_topk_queue(10));
+            shared_maxscore_query buffered_q(buffered);
+            buffered_q(
+                make_max_scored_cursors(data->index, data->wdata, *scorer, shared.as_query()),
+                shared.variations,
+                data->index.num_docs());
+
+            for (size_t v = 0; v < m_query.size(); ++v) {
+                auto expected = ranked_or_topk(data->index, *scorer, m_query[v]);
+                topks[v].finalize();
+                buffered[v].finalize();
+                require_same_scores(expected, topks[v].topk(), 0.1);
+                require_same_scores(expected, buffered[v].topk(), 0.1);
+            }
+        }
+    }
+}
+
+TEMPLATE_TEST_CASE("Parallel range query test",
+                   "[query][ranked][integration]",
+                   wand_query,
+                   maxscore_query,
+                   block_max_wand_query,
+                   block_max_maxscore_query,
+                   ranked_or_query)
+{
+    work_stealing_executor executor(2, false);
+    for (auto &&s_name : {"bm25", "qld"}) {
+        std::unordered_set<size_t> dropped_term_ids;
+        auto data = IndexData<single_index>::get(s_name, dropped_term_ids);
+        topk_queue topk_1(10);
+        parallel_range_query<TestType> op_q(topk_1, executor, 7);
+
+        auto scorer = scorer::from_name(s_name, data->wdata);
+        for (auto const &q : data->queries) {
+            op_q(make_block_max_scored_cursors(data->index, data->wdata, *scorer, q),
+                 data->index.num_docs());
+            topk_1.finalize();
+            require_same_scores(ranked_or_topk(data->index, *scorer, q), topk_1.topk(), 0.1);
+            topk_1.clear();
+        }
+        op_q(make_block_max_scored_cursors(data->index, data->wdata, *scorer, data->queries[0]),
+             0);
+        topk_1.finalize();
+        REQUIRE(topk_1.topk().empty());
+    }
+}
+
+TEMPLATE_TEST_CASE("Interleaved query test",
+                   "[query][ranked][integration]",
+                   wand_query,
+                   maxscore_query,
+                   block_max_wand_query,
+                   block_max_maxscore_query,
+                   ranked_or_query)
+{
+    for (auto &&s_name : {"bm25", "qld"}) {
+        std::unordered_set<size_t> dropped_term_ids;
+        auto data = IndexData<single_index>::get(s_name, dropped_term_ids);
+        auto scorer = scorer::from_name(s_name, data->wdata);
+
+        // Treat consecutive queries as the variations of a single multi-query.
+        for (size_t first = 0; first < data->queries.size(); first += 3) {
+            multi_query m_query(data->queries.begin() + first,
+                                data->queries.begin()
+                                    + std::min(first + 3, data->queries.size()));
+            using Cursors = decltype(make_block_max_scored_cursors(
+                data->index, data->wdata, *scorer, m_query.front()));
+            std::vector<Cursors> cursors;
+            for (auto const &query : m_query) {
+                cursors.push_back(
+                    make_block_max_scored_cursors(data->index, data->wdata, *scorer, query));
+            }
+            std::vector<topk_queue> topks(m_query.size(), topk_queue(10));
+            query_context context;
+            interleaved_query<TestType> interleaved_q(topks, nullptr, &context, 1000);
+            interleaved_q(cursors, data->index.num_docs());
+
+            for (size_t v = 0; v < m_query.size(); ++v) {
+                topks[v].finalize();
+                require_same_scores(
+                    ranked_or_topk(data->index, *scorer, m_query[v]), topks[v].topk(), 0.1);
+            }
+        }
+    }
+}
+
+TEMPLATE_TEST_CASE("Shared threshold query test",
+                   "[query][ranked][integration]",
+                   wand_query,
+                   maxscore_query,
+                   block_max_wand_query,
+                   block_max_maxscore_query,
+                   ranked_or_query)
+{
+    // The shared threshold bounds fused scores only with non-negative term scores.
+    std::unordered_set<size_t> dropped_term_ids;
+    auto data = IndexData<single_index>::get("bm25", dropped_term_ids);
+    auto scorer = scorer::from_name("bm25", data->wdata);
+    uint64_t k = 10;
+
+    // Treat consecutive queries as the variations of a single multi-query.
+    for (size_t first = 0; first < data->queries.size(); first += 3) {
+        multi_query m_query(data->queries.begin() + first,
+                            data->queries.begin() + std::min(first + 3, data->queries.size()));
+        std::vector<float> upper_bounds;
+        for (auto const &query : m_query) {
+            upper_bounds.push_back(variation_upper_bound(data->wdata, query_term_weights(query)));
+        }
+        fused_threshold shared(upper_bounds);
+
+        auto run = [&](fused_threshold *threshold) {
+            std::vector<result_list> results;
+            query_context context;
+            for (size_t v = 0; v < m_query.size(); ++v) {
+                topk_queue topk(k);
+                shared_threshold_query<TestType> op_q(topk, threshold, v, &context, 1000);
+                op_q(make_block_max_scored_cursors(data->index, data->wdata, *scorer, m_query[v]),
+                     data->index.num_docs());
+                topk.finalize();
+                results.push_back(topk.topk());
+            }
+            result_fusion fusion(fusion_method::combsum, k);
+            return fusion(results);
+        };
+        auto expected = run(nullptr);
+        require_same_scores(expected, run(&shared), 0.001);
+    }
+}
+
+TEST_CASE("Multi-query threshold estimates", "[query][ranked][integration]")
+{
+    for (auto &&s_name : {"bm25", "qld"}) {
+        std::unordered_set<size_t> dropped_term_ids;
+        auto data = IndexData<single_index>::get(s_name, dropped_term_ids);
+        auto scorer = scorer::from_name(s_name, data->wdata);
+        uint64_t k = 10;
+
+        // Treat consecutive queries as the variations of a single multi-query.
+        for (size_t first = 0; first < data->queries.size(); first += 3) {
+            multi_query m_query(data->queries.begin() + first,
+                                data->queries.begin()
+                                    + std::min(first + 3, data->queries.size()));
+            for (auto &q : m_query) {
+                q.id = "q";
+                remove_duplicate_terms(q);
+            }
+            auto spcs_query = multi_query_to_spcs({m_query}).front();
+
+            topk_queue topk(k);
+            ranked_or_query or_q(topk);
+            or_q.multi_query(make_scored_cursors(data->index, *scorer, spcs_query),
+                             data->index.num_docs());
+            topk.finalize();
+            float exact = topk.topk().size() == k ? topk.topk().back().first : 0.0F;
+
+            // Primed as by `read_thresholds`, the query keeps the document scoring `exact`.
+            topk_queue primed(k);
+            primed.set_threshold(exact > 0.0F ? std::nextafter(exact, 0.0F) : exact);
+            ranked_or_query primed_q(primed);
+            primed_q.multi_query(make_scored_cursors(data->index, *scorer, spcs_query),
+                                 data->index.num_docs());
+            primed.finalize();
+            REQUIRE(primed.topk().size() == topk.topk().size());
+
+            if (not scorer::has_non_negative_scores(s_name)) {
+                continue;
+            }
+            std::vector<std::vector<std::pair<float, uint64_t>>> results;
+            for (auto const &variation : m_query) {
+                topk_queue variation_topk(k);
+                ranked_or_query variation_q(variation_topk);
+                variation_q(make_scored_cursors(data->index, *scorer, variation),
+                            data->index.num_docs());
+                variation_topk.finalize();
+                results.push_back(variation_topk.topk());
+            }
+            auto term = kth_term_threshold(
+                make_scored_cursors(data->index, *scorer, spcs_query), k, data->index.num_docs());
+            auto variations = fused_lower_bound(results, k);
+            REQUIRE(term <= exact * 1.0001);
+            REQUIRE(variations <= exact * 1.0001);
+            if (m_query.size() == 1) {
+                REQUIRE(variations == Approx(exact));
+            }
+        }
+    }
+}
@@ -0,0 +1,107 @@
+#define CATCH_CONFIG_MAIN
+
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "query/result_cache.hpp"
+
+using namespace pisa;
+
+namespace {
+
+using result_list = result_fusion::result_list;
+
+// Top-k of a variation whose documents are its terms, each scoring 1.
+[[nodiscard]] auto term_results(Query const &query) -> result_list
+{
+    result_list results;
+    for (auto term : query.terms) {
+        results.emplace_back(1.0F, term);
+    }
+    return results;
+}
+
+} // namespace
+
+TEST_CASE("Cache keys", "[result_cache]")
+{
+    Query q1{"1", {3, 1, 2}, {}};
+    Query q2{"1", {1, 2, 3}, {}};
+    Query q3{"1", {4}, {}};
+    CHECK(variation_cache_key(q1, 10) == variation_cache_key(q2, 10));
+    CHECK(variation_cache_key(q1, 10) != variation_cache_key(q2, 20));
+    CHECK(variation_cache_key(q1, 10) != variation_cache_key(q3, 10));
+    CHECK(variation_cache_key(q2, 10) != variation_cache_key(Query{"1", {1, 2, 3}, {1, 2, 1}}, 10));
+
+    auto key = [](multi_query const &m_query) {
+        return fused_cache_key(m_query, fusion_method::combsum, 10, 5);
+    };
+    CHECK(key({q1, q3}) == key({q3, q2}));
+    CHECK(key({q1, q3}) != key({q1, q1, q3}));
+    CHECK(key({q1, q1, q3}) == key({q2, q3, q1}));
+    CHECK(key({q1, q3}) != fused_cache_key({q1, q3}, fusion_method::rrf, 10, 5));
+    CHECK(key({q1, q3}) != fused_cache_key({q1, q3}, fusion_method::combsum, 10, 6));
+}
+
+TEST_CASE("LRU eviction", "[result_cache]")
+{
+    auto entry_size =
+        lru_result_cache::entry_overhead + 2 * sizeof(uint64_t) + sizeof(result_fusion::entry_type);
+    lru_result_cache cache(2 * entry_size);
+    result_list results{{1.0F, 1}};
+    cache.insert({0, 1}, results);
+    cache.insert({0, 2}, results);
+    CHECK(cache.find({0, 1}));
+    cache.insert({0, 3}, results);
+    CHECK(cache.find({0, 1}));
+    CHECK_FALSE(cache.find({0, 2}));
+    CHECK(cache.find({0, 3}));
+
+    auto stats = cache.stats();
+    CHECK(stats.hits == 3);
+    CHECK(stats.misses == 1);
+    CHECK(stats.evictions == 1);
+    CHECK(stats.entries == 2);
+    CHECK(stats.bytes == 2 * entry_size);
+
+    cache.insert({0, 4}, result_list(1000, {1.0F, 1}));
+    CHECK_FALSE(cache.find({0, 4}));
+    CHECK(cache.stats().entries == 2);
+}
+
+TEST_CASE("Multi-query cache evaluates uncached variations", "[result_cache]")
+{
+    multi_query_cache cache(1 << 20);
+    result_fusion fusion(fusion_method::combsum, 10);
+    std::vector<Query> evaluated;
+    multi_query first{{"1", {1, 2}, {}}, {"1", {2, 3}, {}}};
+    multi_query second{{"2", {3, 2}, {}}, {"2", {4}, {}}};
+    auto run = [&](multi_query const &m_query) {
+        return cache(m_query, 10, fusion, [&](auto const &missing, auto &results) {
+            for (auto idx : missing) {
+                evaluated.push_back(m_query[idx]);
+                results[idx] = term_results(m_query[idx]);
+            }
+        });
+    };
+
+    auto fused = run(first);
+    REQUIRE(evaluated.size() == 2);
+    REQUIRE(fused.size() == 3);
+    CHECK(fused[0] == std::pair{2.0F, uint64_t(2)});
+
+    evaluated.clear();
+    CHECK(run(first) == fused);
+    CHECK(evaluated.empty());
+
+    auto partial = run(second);
+    REQUIRE(evaluated.size() == 1);
+    CHECK(evaluated[0].terms == std::vector<term_id_type>{4});
+    CHECK(partial.size() == 3);
+
+    CHECK(cache.fused_stats().hits == 1);
+    CHECK(cache.fused_stats().misses == 2);
+    CHECK(cache.variation_stats().hits == 1);
+    CHECK(cache.variation_stats().misses == 3);
+}
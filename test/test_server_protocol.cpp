@@ -0,0 +1,76 @@
+#define CATCH_CONFIG_MAIN
+
+#include <cstring>
+#include <string>
+
+#include <catch2/catch.hpp>
+
+#include "query/server_protocol.hpp"
+
+using namespace pisa;
+
+TEST_CASE("Parse server requests", "[server]")
+{
+    SECTION("Plain query")
+    {
+        auto request = parse_server_request("1 2 3");
+        REQUIRE(request.variations == std::vector<std::string>{"1 2 3"});
+        REQUIRE(not request.id);
+        REQUIRE(not request.algorithm);
+        REQUIRE(request.format == result_format::trec);
+    }
+    SECTION("Variations containing '='")
+    {
+        auto request = parse_server_request("--k=10\tk=10 a\tb=c");
+        REQUIRE(request.k == 10);
+        REQUIRE(request.variations == std::vector<std::string>{"k=10 a", "b=c"});
+    }
+    SECTION("Multi-query with options")
+    {
+        auto request = parse_server_request(
+            "--id=51\t--algorithm=wand\t--k=1000\t--fusion=rrf\t--z=10\t--format=binary\ta b\t"
+            "c:0.5 d\t");
+        REQUIRE(request.id == "51");
+        REQUIRE(request.algorithm == "wand");
+        REQUIRE(request.k == 1000);
+        REQUIRE(request.fusion == fusion_method::rrf);
+        REQUIRE(request.fusion_k == 10);
+        REQUIRE(request.format == result_format::binary);
+        REQUIRE(request.variations == std::vector<std::string>{"a b", "c:0.5 d"});
+    }
+    SECTION("Malformed requests")
+    {
+        REQUIRE_THROWS_AS(parse_server_request(""), std::invalid_argument);
+        REQUIRE_THROWS_AS(parse_server_request("--k=10"), std::invalid_argument);
+        REQUIRE_THROWS_AS(parse_server_request("--k=ten\ta"), std::invalid_argument);
+        REQUIRE_THROWS_AS(parse_server_request("--k=0\ta"), std::invalid_argument);
+        REQUIRE_THROWS_AS(parse_server_request("--k=1001\ta", 1000), std::invalid_argument);
+        REQUIRE_THROWS_AS(parse_server_request("--z=1001\ta", 1000), std::invalid_argument);
+        REQUIRE(parse_server_request("--k=1000\ta", 1000).k == 1000);
+        REQUIRE_THROWS_AS(parse_server_request("--fusion=max\ta"), std::invalid_argument);
+        REQUIRE_THROWS_AS(parse_server_request("--format=json\ta"), std::invalid_argument);
+        REQUIRE_THROWS_AS(parse_server_request("--depth=3\ta"), std::invalid_argument);
+        REQUIRE_THROWS_AS(parse_server_request("--k\ta"), std::invalid_argument);
+    }
+}
+
+TEST_CASE("Format server responses", "[server]")
+{
+    std::vector<std::pair<float, uint64_t>> results{{2.5, 7}, {1.0, 3}};
+    auto docname = [](uint64_t docid) { return "D" + std::to_string(docid); };
+
+    REQUIRE(server_response(results, result_format::trec, "51", docname, "R0")
+            == "OK 2\n51\tQ0\tD7\t0\t2.5\tR0\n51\tQ0\tD3\t1\t1\tR0\n");
+
+    auto binary = server_response(results, result_format::binary, "51", docname, "R0");
+    REQUIRE(binary.substr(0, 5) == "OK 2\n");
+    REQUIRE(binary.size() == 5 + 2 * 12);
+    uint64_t docid = 0;
+    float score = 0;
+    std::memcpy(&docid, binary.data() + 5 + 12, sizeof(docid));
+    std::memcpy(&score, binary.data() + 5 + 12 + 8, sizeof(score));
+    REQUIRE(docid == 3);
+    REQUIRE(score == 1.0F);
+
+    REQUIRE(server_error_response("bad\nrequest") == "ERR bad request\n");
+}
@@ -0,0 +1,95 @@
+#define CATCH_CONFIG_MAIN
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "accumulator/simd_aggregate.hpp"
+#include "topk_queue.hpp"
+
+using namespace pisa;
+
+namespace {
+
+/// Scores drawn from a few values, so that thresholds often equal some of them.
+auto random_scores(std::size_t n, std::mt19937 &rng) -> std::vector<float>
+{
+    std::uniform_int_distribution<int> dist(0, 7);
+    std::vector<float> scores(n);
+    std::generate(scores.begin(), scores.end(), [&] { return dist(rng) * 0.5F; });
+    return scores;
+}
+
+} // namespace
+
+TEST_CASE("Lanes above a threshold", "[simd_aggregate]")
+{
+    std::mt19937 rng(1729);
+    // Sizes that are not multiples of 8 or 16 leave a tail to the scalar loop.
+    for (std::size_t n : {0, 1, 7, 8, 9, 15, 16, 17, 31, 33, 63, 64}) {
+        auto scores = random_scores(n, rng);
+        // Thresholds equal to a score must not select its lanes.
+        for (float threshold : {-1.0F, 0.0F, 1.5F, 3.5F, 4.0F}) {
+            CAPTURE(n, threshold);
+            uint64_t expected = 0;
+            for (std::size_t i = 0; i < n; ++i) {
+                expected |= uint64_t(scores[i] > threshold) << i;
+            }
+            REQUIRE(lanes_above(scores.data(), n, threshold) == expected);
+            REQUIRE(any_above(scores.data(), n, threshold) == (expected != 0));
+        }
+    }
+}
+
+TEST_CASE("Any lane above a threshold", "[simd_aggregate]")
+{
+    for (std::size_t n : {1, 7, 8, 9, 16, 17, 64}) {
+        for (std::size_t lane = 0; lane < n; ++lane) {
+            CAPTURE(n, lane);
+            std::vector<float> scores(n, 1.0F);
+            REQUIRE_FALSE(any_above(scores.data(), n, 1.0F));
+            scores[lane] = 2.0F;
+            REQUIRE(any_above(scores.data(), n, 1.0F));
+            REQUIRE_FALSE(any_above(scores.data(), n, 2.0F));
+            REQUIRE(lanes_above(scores.data(), n, 1.0F) == uint64_t(1) << lane);
+        }
+    }
+}
+
+TEST_CASE("Aggregate dense scores", "[simd_aggregate]")
+{
+    std::mt19937 rng(1729);
+    // Sizes that end with a partial chunk, or a partial vector within it.
+    for (std::size_t n : {1, 9, 63, 64, 65, 100, 1000}) {
+        for (uint64_t k : {1, 5, 10, 2000}) {
+            CAPTURE(n, k);
+            auto scores = random_scores(n, rng);
+            topk_queue expected(k);
+            for (std::size_t docid = 0; docid < n; ++docid) {
+                expected.insert(scores[docid], docid + 42);
+            }
+            expected.finalize();
+            topk_queue actual(k);
+            aggregate_scores(scores.data(), n, actual, 42);
+            actual.finalize();
+            REQUIRE(actual.topk().size() == expected.topk().size());
+            for (std::size_t pos = 0; pos < expected.topk().size(); ++pos) {
+                REQUIRE(actual.topk()[pos].first == expected.topk()[pos].first);
+            }
+        }
+    }
+}
+
+TEST_CASE("Aggregate dense scores above an initial threshold", "[simd_aggregate]")
+{
+    std::vector<float> scores(70, 1.0F);
+    scores[3] = 2.0F;
+    scores[66] = 3.0F;
+    topk_queue topk(10);
+    topk.set_threshold(2.0F);
+    aggregate_scores(scores.data(), scores.size(), topk);
+    topk.finalize();
+    REQUIRE(topk.topk() == std::vector<topk_queue::entry_type>{{3.0F, 66}});
+}
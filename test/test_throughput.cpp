@@ -0,0 +1,49 @@
+#define CATCH_CONFIG_MAIN
+
+#include <atomic>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "query/throughput.hpp"
+
+using namespace pisa;
+
+TEST_CASE("Throughput runs every query once per run", "[throughput]")
+{
+    for (size_t threads : {1, 3}) {
+        std::vector<std::atomic<size_t>> calls(10);
+        auto result =
+            measure_throughput([&](size_t idx) { return calls[idx]++; }, calls.size(), threads, 2);
+        for (auto const &c : calls) {
+            REQUIRE(c == 3); // warm-up and two timed runs
+        }
+        REQUIRE(result.thread_times.size() == threads);
+        REQUIRE(result.queries() == 20);
+        REQUIRE(result.seconds > 0.0);
+    }
+}
+
+TEST_CASE("Throughput gives every thread its own copy of the query function", "[throughput]")
+{
+    std::atomic<size_t> total{0};
+    auto fn = [&total, count = size_t{0}](size_t) mutable {
+        total += 1;
+        return ++count;
+    };
+    auto result = measure_throughput(fn, 5, 2, 4);
+    REQUIRE(total == 25);
+    REQUIRE(result.queries() == 20);
+}
+
+TEST_CASE("Latency summary", "[throughput]")
+{
+    std::vector<double> times{5, 1, 4, 2, 3};
+    auto summary = latency_summary::from(times);
+    REQUIRE(summary.count == 5);
+    REQUIRE(summary.mean == Approx(3.0));
+    REQUIRE(summary.q50 == 3.0);
+    REQUIRE(summary.q95 == 5.0);
+    std::vector<double> empty;
+    REQUIRE(latency_summary::from(empty).count == 0);
+}
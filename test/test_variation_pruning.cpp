@@ -0,0 +1,107 @@
+#define CATCH_CONFIG_MAIN
+
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "query/variation_pruning.hpp"
+
+using namespace pisa;
+
+namespace {
+
+// Term `t` has `counts[t]` postings with scores up to `max_weights[t]`.
+struct term_stats {
+    std::vector<std::size_t> counts;
+    std::vector<float> max_weights;
+    [[nodiscard]] auto term_posting_count(uint64_t term) const -> std::size_t
+    {
+        return counts[term];
+    }
+    [[nodiscard]] auto max_term_weight(uint64_t term) const -> float { return max_weights[term]; }
+};
+
+term_stats const wdata{{100, 200, 300, 400, 500}, {1.0F, 2.0F, 3.0F, 0.0F, 0.5F}};
+
+} // namespace
+
+TEST_CASE("Group identical variations", "[variation_pruning]")
+{
+    multi_query m_query{{"1", {0, 1}, {}}, {"1", {1, 0}, {}}, {"1", {2}, {}}, {"1", {0, 1}, {}}};
+    variation_pruning options;
+    options.group = true;
+    auto [pruned, stats] = prune_variations(m_query, wdata, options);
+    REQUIRE(pruned.size() == 2);
+    CHECK(pruned[0].terms == std::vector<term_id_type>{0, 1});
+    CHECK(pruned[0].term_weights == std::vector<float>{3.0F, 3.0F});
+    CHECK(pruned[1].terms == std::vector<term_id_type>{2});
+    CHECK(pruned[1].term_weights == std::vector<float>{1.0F});
+    CHECK(stats.variations == 4);
+    CHECK(stats.grouped == 2);
+    CHECK(stats.dropped == 0);
+    CHECK(stats.postings == 3 * 300 + 300);
+    CHECK(stats.postings_saved == 2 * 300);
+    CHECK(stats.distinct_postings_saved == 0);
+
+    // The fused query is the same.
+    auto fused = query_term_weights(fuse_variations(m_query));
+    CHECK(query_term_weights(fuse_variations(pruned)) == fused);
+}
+
+TEST_CASE("Drop variations", "[variation_pruning]")
+{
+    multi_query m_query{{"1", {3}, {}}, {"1", {0, 4}, {}}, {"1", {2}, {}}, {"1", {1}, {}}};
+
+    SECTION("Zero upper bound")
+    {
+        auto [pruned, stats] = prune_variations(m_query, wdata, variation_pruning{});
+        REQUIRE(pruned.size() == 3);
+        CHECK(pruned[0].terms == std::vector<term_id_type>{0, 4});
+        CHECK(stats.dropped == 1);
+        CHECK(stats.postings_saved == 400);
+        CHECK(stats.distinct_postings_saved == 400);
+    }
+    SECTION("Zero upper bound with signed scores")
+    {
+        variation_pruning options;
+        options.non_negative_scores = false;
+        auto [pruned, stats] = prune_variations(m_query, wdata, options);
+        REQUIRE(pruned.size() == 4);
+        CHECK(stats.dropped == 0);
+    }
+    SECTION("Minimum contribution")
+    {
+        variation_pruning options;
+        options.min_contribution = 0.6F;
+        auto [pruned, stats] = prune_variations(m_query, wdata, options);
+        REQUIRE(pruned.size() == 2);
+        CHECK(pruned[0].terms == std::vector<term_id_type>{2});
+        CHECK(pruned[1].terms == std::vector<term_id_type>{1});
+        CHECK(stats.dropped == 2);
+    }
+    SECTION("Variation budget")
+    {
+        variation_pruning options;
+        options.max_variations = 1;
+        auto [pruned, stats] = prune_variations(m_query, wdata, options);
+        REQUIRE(pruned.size() == 1);
+        CHECK(pruned[0].terms == std::vector<term_id_type>{2});
+    }
+    SECTION("Postings budget")
+    {
+        variation_pruning options;
+        options.max_postings = 550;
+        auto [pruned, stats] = prune_variations(m_query, wdata, options);
+        REQUIRE(pruned.size() == 2);
+        CHECK(pruned[0].terms == std::vector<term_id_type>{2});
+        CHECK(pruned[1].terms == std::vector<term_id_type>{1});
+        CHECK(stats.distinct_postings_saved == 100 + 400 + 500);
+    }
+    SECTION("Nothing left")
+    {
+        auto [pruned, stats] = prune_variations({{"1", {3}, {}}}, wdata, variation_pruning{});
+        REQUIRE(pruned.size() == 1);
+        CHECK(pruned[0].id == "1");
+        CHECK(pruned[0].terms.empty());
+    }
+}
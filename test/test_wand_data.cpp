@@ -122,3 +122,43 @@ TEST_CASE("wand_data_range")
         }
     }
 }
+
+TEST_CASE("Quantized wand data")
+{
+    using WandType = wand_data<wand_data_raw>;
+
+    auto scorer_name = "bm25";
+    uint32_t bits = 8;
+
+    binary_freq_collection const collection(PISA_SOURCE_DIR "/test/test_data/test_collection");
+    binary_collection document_sizes(PISA_SOURCE_DIR "/test/test_data/test_collection.sizes");
+    std::unordered_set<size_t> dropped_term_ids;
+    WandType wdata(document_sizes.begin()->begin(),
+                   collection.num_docs(),
+                   collection,
+                   scorer_name,
+                   BlockSize(FixedBlock()),
+                   dropped_term_ids,
+                   bits);
+
+    auto scorer = scorer::from_name(scorer_name, wdata);
+    linear_quantizer quantizer(max_posting_score(collection, *scorer), bits);
+
+    size_t term_id = 0;
+    for (auto const &seq : collection) {
+        if (seq.docs.size() > configuration::get().threshold_wand_list) {
+            auto max = wdata.max_term_weight(term_id);
+            REQUIRE(max == std::floor(max));
+            REQUIRE(max <= quantizer.max_impact());
+            auto w = wdata.getenum(term_id);
+            auto s = scorer->term_scorer(term_id);
+            for (auto &&[docid, freq] : ranges::views::zip(seq.docs, seq.freqs)) {
+                auto impact = quantizer(s(docid, freq));
+                w.next_geq(docid);
+                REQUIRE(w.score() >= impact);
+                REQUIRE(w.score() <= max);
+            }
+        }
+        term_id += 1;
+    }
+}
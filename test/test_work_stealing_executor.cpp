@@ -0,0 +1,86 @@
+#define CATCH_CONFIG_MAIN
+
+#include <atomic>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "util/work_stealing_executor.hpp"
+
+using namespace pisa;
+
+TEST_CASE("Executor runs every task exactly once", "[executor]")
+{
+    for (size_t workers : {1, 2, 4}) {
+        work_stealing_executor executor(workers, false);
+        for (size_t n : {0, 1, 7, 100}) {
+            std::vector<int> runs(n, 0);
+            executor.parallel_for(n, [&](size_t i) { runs[i] += 1; });
+            REQUIRE(std::all_of(runs.begin(), runs.end(), [](int r) { return r == 1; }));
+        }
+    }
+}
+
+TEST_CASE("Executor supports nested parallel_for", "[executor]")
+{
+    work_stealing_executor executor(2, false);
+    std::atomic<size_t> sum{0};
+    executor.parallel_for(8, [&](size_t i) {
+        executor.parallel_for(8, [&](size_t j) { sum += i * 8 + j; });
+    });
+    REQUIRE(sum == 64 * 63 / 2);
+}
+
+TEST_CASE("Executor rethrows the exceptions of tasks", "[executor]")
+{
+    work_stealing_executor executor(2, false);
+    std::atomic<size_t> runs{0};
+    REQUIRE_THROWS_AS(executor.parallel_for(10,
+                                            [&](size_t i) {
+                                                ++runs;
+                                                if (i % 3 == 0) {
+                                                    throw std::runtime_error("task failed");
+                                                }
+                                            }),
+                      std::runtime_error);
+    REQUIRE(runs == 10);
+    executor.parallel_for(4, [&](size_t) { ++runs; });
+    REQUIRE(runs == 14);
+}
+
+TEST_CASE("Executor reports statistics", "[executor]")
+{
+    work_stealing_executor executor(2, false);
+    executor.parallel_for(10, [](size_t) {});
+    auto stats = executor.stats();
+    REQUIRE(stats.workers == 2);
+    REQUIRE(stats.tasks == 10);
+    REQUIRE(stats.utilization >= 0.0);
+    REQUIRE(stats.utilization <= 1.0);
+    executor.reset_stats();
+    REQUIRE(executor.stats().tasks == 0);
+}
+
+#if defined(__linux__)
+TEST_CASE("Executor pins workers within the inherited affinity mask", "[executor]")
+{
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    REQUIRE(sched_getaffinity(0, sizeof(cpu_set_t), &allowed) == 0);
+    work_stealing_executor executor(4, true);
+    std::atomic<bool> outside{false};
+    executor.parallel_for(64, [&](size_t) {
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        sched_getaffinity(0, sizeof(cpu_set_t), &mask);
+        cpu_set_t common;
+        CPU_AND(&common, &mask, &allowed);
+        if (not CPU_EQUAL(&common, &mask)) {
+            outside = true;
+        }
+    });
+    REQUIRE_FALSE(outside);
+}
+#endif